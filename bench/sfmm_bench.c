@@ -0,0 +1,339 @@
+/*
+ * Trace driven benchmark
+ *
+ *   bin/sfmm_bench [-g] [-t] [-r repeats] trace...
+ *
+ * Replays each trace (see trace.h) through sf_malloc, sf_realloc, sf_free
+ * and sf_memalign, and with -g through the malloc of the C library as
+ * well. Every replay runs in a child process of its own, so each starts
+ * from an empty heap. -t selects the TLSF free list engine, -r replays each
+ * trace several times in a row, freeing what is left in between.
+ *
+ * Reported per trace and allocator:
+ * - operations per second and nanoseconds per operation at the 50th, 90th
+ *   and 99th percentile and the maximum, each call timed on its own.
+ * - the peak heap size: the span of the heap of arena 0 for sfmm (what
+ *   sf_mem_end() - sf_mem_start() is with the default provider), the
+ *   arena and mmapped bytes of mallinfo2() for the C library.
+ * - utilization: the peak of the bytes requested by live objects divided
+ *   by the peak heap size.
+ *
+ * The heap is backed by the mmap provider so that traces are not limited
+ * by the region of sfutil.o, and huge mappings are turned off so that every
+ * block is counted in the heap. Binary traces of several threads are
+ * replayed in order by one thread.
+ */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "huge.h"
+#include "page_provider.h"
+#include "sfmm.h"
+#include "tlsf.h"
+#include "trace.h"
+
+typedef struct {
+  const char *name;
+  void *(*malloc)(size_t size);
+  void *(*realloc)(void *pp, size_t size);
+  void (*free)(void *pp);
+  void *(*memalign)(size_t size, size_t align);
+  size_t (*heap_size)();
+} bench_allocator;
+
+typedef struct {
+  sf_trace_event *events;
+  size_t count;
+  uint32_t ids;  // largest id + 1
+} bench_trace;
+
+static void *glibc_memalign(size_t size, size_t align) {
+  void *pp = NULL;
+  return (posix_memalign(&pp, align, size) == 0) ? pp : NULL;
+}
+
+static size_t glibc_heap_size() {
+  struct mallinfo2 info = mallinfo2();
+  return info.arena + info.hblkhd;
+}
+
+static size_t sfmm_heap_size() {
+  sf_arena *arena = get_arena(0);
+  return (char *)arena_heap_end(arena) - (char *)arena_heap_start(arena);
+}
+
+static const bench_allocator sfmm_allocator = {
+    "sfmm", sf_malloc, sf_realloc, sf_free, sf_memalign, sfmm_heap_size};
+static const bench_allocator glibc_allocator = {
+    "glibc", malloc, realloc, free, glibc_memalign, glibc_heap_size};
+
+/*
+ * Append an event to a trace, growing its array as needed.
+ */
+static void trace_append(bench_trace *trace, sf_trace_event *event,
+                         size_t *capacity) {
+  if (trace->count == *capacity) {
+    *capacity = (*capacity == 0) ? 1024 : *capacity * 2;
+    trace->events = realloc(trace->events, *capacity * sizeof(*event));
+    if (trace->events == NULL) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+  }
+  trace->events[trace->count++] = *event;
+  if (event->id >= trace->ids) {
+    trace->ids = event->id + 1;
+  }
+}
+
+/*
+ * Read a text trace.
+ * Returns 0 if successful, -1 with a message printed otherwise.
+ */
+static int read_text_trace(FILE *file, const char *path, bench_trace *trace) {
+  char line[256];
+  size_t capacity = 0;
+  for (int number = 1; fgets(line, sizeof(line), file) != NULL; number++) {
+    char op;
+    unsigned long id = 0;
+    unsigned long long size = 0, align = 0;
+    if (sscanf(line, " %c", &op) != 1 || op == '#' ||
+        (op >= '0' && op <= '9')) {
+      continue;
+    }
+    int fields = sscanf(line, " %c %lu %llu %llu", &op, &id, &size, &align);
+    int expected = (op == SF_TRACE_FREE) ? 2 : (op == SF_TRACE_MEMALIGN) ? 4 : 3;
+    if ((op != SF_TRACE_MALLOC && op != SF_TRACE_REALLOC &&
+         op != SF_TRACE_FREE && op != SF_TRACE_MEMALIGN) ||
+        fields < expected || id >= UINT32_MAX ||
+        (op == SF_TRACE_MEMALIGN && (align == 0 || (align & (align - 1))))) {
+      fprintf(stderr, "%s:%d: bad operation\n", path, number);
+      return -1;
+    }
+    sf_trace_event event = {.size = size, .id = id, .op = op};
+    if (op == SF_TRACE_MEMALIGN) {
+      event.align_shift = __builtin_ctzll(align);
+    }
+    trace_append(trace, &event, &capacity);
+  }
+  return 0;
+}
+
+/*
+ * Read a trace in either format.
+ * Returns 0 if successful, -1 with a message printed otherwise.
+ */
+static int read_trace(const char *path, bench_trace *trace) {
+  memset(trace, 0, sizeof(*trace));
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return -1;
+  }
+  sf_trace_header header;
+  int result = 0;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      header.magic == SF_TRACE_MAGIC) {
+    if (header.version != SF_TRACE_VERSION) {
+      fprintf(stderr, "%s: unknown trace version %u\n", path, header.version);
+      result = -1;
+    }
+    sf_trace_event event;
+    size_t capacity = 0;
+    while (result == 0 && fread(&event, sizeof(event), 1, file) == 1) {
+      trace_append(trace, &event, &capacity);
+    }
+  } else {
+    rewind(file);
+    result = read_text_trace(file, path, trace);
+  }
+  fclose(file);
+  return result;
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Replay a trace repeats times and print one line of results.
+ * Returns 0 if successful, -1 if an allocation failed.
+ */
+static int replay(const bench_trace *trace, const bench_allocator *alloc,
+                  const char *path, int repeats) {
+  void **objects = calloc(trace->ids, sizeof(void *));
+  size_t *sizes = calloc(trace->ids, sizeof(size_t));
+  uint64_t *latencies = malloc(trace->count * repeats * sizeof(uint64_t));
+  if ((trace->ids && (objects == NULL || sizes == NULL)) ||
+      (trace->count && latencies == NULL)) {
+    perror("malloc");
+    return -1;
+  }
+  size_t ops = 0;
+  size_t live = 0, peak_live = 0, peak_heap = 0;
+  uint64_t total = 0;
+  for (int r = 0; r < repeats; r++) {
+    for (size_t i = 0; i < trace->count; i++) {
+      sf_trace_event *event = &trace->events[i];
+      void **object = &objects[event->id];
+      uint64_t start = now_ns();
+      void *pp = NULL;
+      switch (event->op) {
+        case SF_TRACE_MALLOC:
+          pp = alloc->malloc(event->size);
+          break;
+        case SF_TRACE_MEMALIGN:
+          // both allocators align to at least a pointer
+          pp = alloc->memalign(event->size,
+                               (size_t)1 << (event->align_shift < 3
+                                                 ? 3
+                                                 : event->align_shift));
+          break;
+        case SF_TRACE_REALLOC:
+          pp = (*object != NULL) ? alloc->realloc(*object, event->size)
+                                 : alloc->malloc(event->size);
+          break;
+        case SF_TRACE_FREE:
+          if (*object != NULL) {
+            alloc->free(*object);
+          }
+          break;
+      }
+      uint64_t elapsed = now_ns() - start;
+      latencies[ops++] = elapsed;
+      total += elapsed;
+      if (event->op != SF_TRACE_FREE && pp == NULL && event->size != 0) {
+        fprintf(stderr, "%s: %s ran out of memory at operation %zu\n", path,
+                alloc->name, i);
+        return -1;
+      }
+      live -= sizes[event->id];
+      *object = (event->op == SF_TRACE_FREE) ? NULL : pp;
+      sizes[event->id] = (pp != NULL) ? event->size : 0;
+      live += sizes[event->id];
+      if (live > peak_live) {
+        peak_live = live;
+      }
+      size_t heap = alloc->heap_size();
+      if (heap > peak_heap) {
+        peak_heap = heap;
+      }
+    }
+    // objects the trace left allocated
+    for (uint32_t id = 0; id < trace->ids; id++) {
+      if (objects[id] != NULL) {
+        alloc->free(objects[id]);
+        objects[id] = NULL;
+      }
+      sizes[id] = 0;
+    }
+    live = 0;
+  }
+  qsort(latencies, ops, sizeof(uint64_t), compare_latencies);
+  double seconds = total / 1e9;
+  printf("%-24s %-6s %10zu %12.0f %6lu %6lu %6lu %9lu %12zu %6.1f%%\n", path,
+         alloc->name, ops, (seconds > 0) ? ops / seconds : 0.0,
+         ops ? latencies[ops / 2] : 0, ops ? latencies[ops * 9 / 10] : 0,
+         ops ? latencies[ops * 99 / 100] : 0, ops ? latencies[ops - 1] : 0,
+         peak_heap, peak_heap ? 100.0 * peak_live / peak_heap : 0.0);
+  fflush(stdout);
+  free(objects);
+  free(sizes);
+  free(latencies);
+  return 0;
+}
+
+/*
+ * Replay a trace in a child process, starting from an empty heap.
+ * Returns 0 if successful, -1 otherwise.
+ */
+static int replay_child(const bench_trace *trace, const bench_allocator *alloc,
+                        const char *path, int repeats, int tlsf) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+  if (pid == 0) {
+    if (alloc == &sfmm_allocator) {
+      sf_use_mmap_provider(0);
+      sf_set_huge_threshold(0);
+      if (tlsf) {
+        sf_set_free_list_engine(SF_TLSF);
+      }
+    }
+    _exit(replay(trace, alloc, path, repeats) == 0 ? 0 : 1);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-g] [-t] [-r repeats] trace...\n", name);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  int glibc = 0, tlsf = 0, repeats = 1, opt;
+  while ((opt = getopt(argc, argv, "gtr:")) != -1) {
+    switch (opt) {
+      case 'g':
+        glibc = 1;
+        break;
+      case 't':
+        tlsf = 1;
+        break;
+      case 'r':
+        repeats = atoi(optarg);
+        if (repeats < 1) usage(argv[0]);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (optind == argc) {
+    usage(argv[0]);
+  }
+  printf("%-24s %-6s %10s %12s %6s %6s %6s %9s %12s %7s\n", "trace",
+         "alloc", "ops", "ops/sec", "p50ns", "p90ns", "p99ns", "max ns",
+         "peak heap", "util");
+  int failed = 0;
+  for (int i = optind; i < argc; i++) {
+    bench_trace trace;
+    if (read_trace(argv[i], &trace) != 0) {
+      failed = 1;
+      continue;
+    }
+    if (replay_child(&trace, &sfmm_allocator, argv[i], repeats, tlsf) != 0) {
+      failed = 1;
+    }
+    if (glibc &&
+        replay_child(&trace, &glibc_allocator, argv[i], repeats, tlsf) != 0) {
+      failed = 1;
+    }
+    free(trace.events);
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/*
+ * Arenas
+ *
+ * The heap is split into up to SF_MAX_ARENAS independent arenas, each with
+ * its own pages, free lists, quick lists, wilderness block and lock. The
+ * initial thread allocates from arena 0, which is backed by the configured
+ * page provider and keeps its lists in the globals of sfmm.h. Every other
+ * thread is assigned an arena round-robin the first time it allocates.
+ *
+ * Arenas 1 and up take their pages from consecutive SF_ARENA_SPAN byte
+ * slices of one reserved range of address space, so the arena that owns a
+ * block follows from the block's address alone, and a free always goes back
+ * to the arena the block came from:
+ *
+ *  arena_space
+ *  +-------------------+-------------------+-----+
+ *  | arena 1           | arena 2           | ... |
+ *  +-------------------+-------------------+-----+
+ *  <-- SF_ARENA_SPAN -->
+ *
+ * Any other address belongs to arena 0.
+ *
+ * The heap code always works on sf_arena_cur, which the public entry points
+ * point at an arena while they hold its lock. The names of the per-heap
+ * globals are redirected below to the fields of the current arena, so the
+ * heap code reads the same with one arena or many.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <pthread.h>
+
+#include "sfmm.h"
+#include "counters.h"
+#include "free_tree.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "purge.h"
+#include "slab.h"
+#include "stats.h"
+#include "tlsf.h"
+#include "zero.h"
+
+#define SF_MAX_ARENAS 64
+#define SF_ARENA_SPAN ((size_t)1 << 32)
+
+typedef __typeof__(sf_quick_lists[0]) sf_quick_list;
+
+typedef struct sf_arena {
+  pthread_mutex_t lock;
+  int index;
+  sf_block *free_list_heads;  // the free lists, sf_free_list_heads for arena 0
+  sf_quick_list *quick_lists;  // the quick lists, sf_quick_lists for arena 0
+  sf_quick_list_ctl quick_list_ctls[NUM_QUICK_LISTS];
+  sf_tree_node *free_tree_roots[NUM_FREE_LISTS];
+  sf_tlsf_state tlsf;
+  sf_page_provider *provider;
+  sf_purge_stats purge_counters;
+  sf_heap_stats heap_counters;
+  uint64_t last_purge_pass;
+  uint64_t remote_frees;  // tagged top of the remote free stack
+  sf_slab *slabs[SLAB_CLASS_COUNT];  // partially used slabs per size class
+  sf_slab *spare_slab;               // an empty slab kept for reuse
+  char *zero_from;             // fresh memory starts here, see zero.h
+  sf_zero_range zero_fresh;    // fresh part of the last block allocated
+  sf_zero_range zero_purged;   // purged pages of the last block reused
+#ifdef SF_COMPACT_HEADERS
+  char *link_base;  // free list links are offsets from here
+#endif
+#ifdef SF_COUNTERS
+  sf_event_counters event_counters;  // see counters.h
+#endif
+  // storage of the arenas other than arena 0
+  sf_block own_free_list_heads[NUM_FREE_LISTS];
+  sf_quick_list own_quick_lists[NUM_QUICK_LISTS];
+  sf_page_provider own_provider;
+  sf_region own_region;
+} sf_arena;
+
+extern __thread sf_arena *sf_arena_cur;
+
+#define sf_free_list_heads (sf_arena_cur->free_list_heads)
+#define sf_quick_lists (sf_arena_cur->quick_lists)
+#define sf_quick_list_ctls (sf_arena_cur->quick_list_ctls)
+#define sf_free_tree_roots (sf_arena_cur->free_tree_roots)
+#define sf_tlsf_fl_bitmap (sf_arena_cur->tlsf.fl_bitmap)
+#define sf_tlsf_sl_bitmap (sf_arena_cur->tlsf.sl_bitmap)
+#define sf_tlsf_heads (sf_arena_cur->tlsf.heads)
+#define sf_provider (sf_arena_cur->provider)
+#define sf_purge_counters (sf_arena_cur->purge_counters)
+#define sf_heap_counters (sf_arena_cur->heap_counters)
+
+extern int sf_set_arena_count(int count);
+extern int sf_arena_count();
+extern sf_arena *get_arena(int index);
+extern sf_arena *thread_arena();
+extern sf_arena *arena_of(void *pp);
+extern sf_arena *arena_enter(sf_arena *arena);
+extern void arena_leave(sf_arena *prev);
+extern void *arena_heap_start(sf_arena *arena);
+extern void *arena_heap_end(sf_arena *arena);
+extern int is_pointer_plausible(sf_arena *arena, void *pp);
+
+#endif /* ARENA_H */
@@ -0,0 +1,34 @@
+/*
+ * Batch allocation
+ *
+ * sf_malloc_batch() and sf_free_batch() serve bursts of same sized objects
+ * that are allocated and freed together, taking the arena lock once per
+ * call instead of once per object.
+ *
+ * sf_malloc_batch() first empties the quick list of the size class, then
+ * takes a single free block (or grows the heap once) for all the remaining
+ * blocks and carves them from it in one pass, back to back:
+ *
+ *  +--------+----------+-----+----------+-----------+
+ *  | out[k] | out[k+1] | ... | out[n-1] | remainder | -> free lists
+ *  +--------+----------+-----+----------+-----------+
+ *
+ * Slab sized requests take whole bitmap words of free slots at once.
+ *
+ * sf_free_batch() sorts the pointers by address, so blocks allocated by one
+ * sf_malloc_batch() call are merged back into a single free block that is
+ * coalesced and inserted into the free lists once. Pointers of slabs, huge
+ * blocks and other arenas are freed one by one as sf_free() would.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "sfmm.h"
+
+/* Blocks merged into runs per pass of sf_free_batch(). */
+#define SF_BATCH_RUN_MAX 128
+
+extern size_t sf_malloc_batch(size_t size, size_t n, void **out);
+extern void sf_free_batch(void **ptrs, size_t n);
+
+#endif /* BATCH_H */
@@ -0,0 +1,108 @@
+/*
+ * Block layout
+ *
+ * By default headers, footers and free list links are 64 bits wide, as
+ * drawn in sfmm.h. Building with -DSF_COMPACT_HEADERS selects a compact
+ * layout for heaps under 4 GiB, with 32-bit headers and footers and free
+ * list links stored as 32-bit offsets:
+ *
+ *  default                          compact
+ *  +------------------+ <- block    +------------------+ <- block (4 mod 8)
+ *  | header     (8)   |             | header     (4)   |
+ *  +------------------+ <- payload  +------------------+ <- payload (aligned)
+ *  | next       (8)   |             | next       (4)   |
+ *  | prev       (8)   |             | prev       (4)   |
+ *  | footer     (8)   |             | footer     (4)   |
+ *  +------------------+             +------------------+
+ *   MIN_BLOCK_SIZE 32                MIN_BLOCK_SIZE 16
+ *
+ * Compact blocks start 4 bytes past an 8-byte boundary so that payloads
+ * stay aligned, the heap starts with HEAP_PAD unused bytes to get there.
+ * A link of 0 is NULL, a link below SF_LINK_HEAD_LIMIT is one of the dummy
+ * list heads of the current arena, which live outside the heap, and any
+ * other link is an offset from SF_LINK_HEAD_LIMIT bytes before the start
+ * of the arena's heap.
+ *
+ * Headers and links are only ever accessed through the macros and
+ * functions below, which are picked when building, so neither layout pays
+ * for a runtime test of the other.
+ */
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include "sfmm.h"
+
+#ifdef SF_COMPACT_HEADERS
+
+typedef uint32_t sf_word;
+typedef uint32_t sf_link;
+
+#define HEAP_PAD 4
+#define SF_FIELD_ALIGN __attribute__((aligned(4)))
+#define SF_LINK_HEAD_LIMIT ((size_t)PAGE_SZ)
+/* Largest heap whose blocks can all be linked with 32-bit offsets. */
+#define SF_HEAP_MAX (((size_t)1 << 32) - 2 * PAGE_SZ)
+
+#else
+
+typedef sf_header sf_word;
+typedef struct sf_block *sf_link;
+
+#define HEAP_PAD 0
+#define SF_FIELD_ALIGN
+
+#endif /* SF_COMPACT_HEADERS */
+
+#define HEADER_SIZE sizeof(sf_word)
+#define FOOTER_SIZE sizeof(sf_word)
+
+/* The start of a free block. */
+typedef struct {
+  sf_word header;
+  sf_link next;
+  sf_link prev;
+} sf_block_links;
+
+#define BLOCK_HEADER(block) (((sf_block_links *)(block))->header)
+
+/*
+ * An 8-byte field of a struct laid over a free block after its links. In
+ * the compact layout it is only 4-byte aligned within the struct, which
+ * puts it on an 8-byte boundary within the block.
+ */
+typedef size_t sf_block_field SF_FIELD_ALIGN;
+
+#ifdef SF_COMPACT_HEADERS
+
+extern sf_link link_encode(sf_block *block);
+extern sf_block *link_decode(sf_link link);
+
+#define block_next(block) link_decode(((sf_block_links *)(block))->next)
+#define block_prev(block) link_decode(((sf_block_links *)(block))->prev)
+#define set_block_next(block, to) \
+  (((sf_block_links *)(block))->next = link_encode(to))
+#define set_block_prev(block, to) \
+  (((sf_block_links *)(block))->prev = link_encode(to))
+
+#else
+
+#define block_next(block) (((sf_block_links *)(block))->next)
+#define block_prev(block) (((sf_block_links *)(block))->prev)
+#define set_block_next(block, to) (((sf_block_links *)(block))->next = (to))
+#define set_block_prev(block, to) (((sf_block_links *)(block))->prev = (to))
+
+#endif /* SF_COMPACT_HEADERS */
+
+/*
+ * A block held by a thread cache or a remote free stack stays allocated,
+ * its payload links it to the next block with a full pointer and holds a
+ * 32-bit key of its owner for double free detection.
+ */
+typedef struct {
+  sf_block *next;
+  uint32_t key;
+} sf_held_block;
+
+#define HELD_BLOCK(block) ((sf_held_block *)((char *)(block) + HEADER_SIZE))
+
+#endif /* BLOCK_LAYOUT_H */
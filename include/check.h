@@ -0,0 +1,103 @@
+/*
+ * Pointer checks
+ *
+ * sf_free() and sf_realloc() check the pointers they are given at one of
+ * four levels, and abort (sf_free) or fail with EINVAL (sf_realloc) if a
+ * check fails:
+ *
+ *  level              checks
+ *  SF_CHECK_OFF       none
+ *  SF_CHECK_FAST      the header: size, allocated and quick list bits
+ *  SF_CHECK_FULL      is_pointer_invalid(): the header, the block lies in
+ *                     the heap, and the footer of a free previous block
+ *  SF_CHECK_PARANOID  also the neighbours: their headers agree with their
+ *                     footers and the prev_alloc bits, and free neighbours
+ *                     are linked into the free lists
+ *
+ * Building with -DSF_CHECK_LEVEL=<level> (make CHECK=fast, ...) fixes the
+ * level, and the disabled checks are compiled out. Otherwise the level is
+ * read from the SFMM_CHECK environment variable (off, fast, full or
+ * paranoid) on the first check, and can be changed with
+ * sf_set_check_level(). The default is SF_CHECK_FULL, SF_CHECK_PARANOID in
+ * debug builds.
+ *
+ * Below SF_CHECK_FULL nothing makes sure the header is mapped, so a stray
+ * pointer outside the heap may fault instead of aborting.
+ *
+ * The lock-free paths (thread caches and remote frees) stop at the checks
+ * that do not read the neighbours. Slab slots are always checked against
+ * their slab's bitmap, which is where freeing them writes.
+ */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "arena.h"
+#include "mem_library.h"
+#include "sfmm.h"
+
+typedef enum {
+  SF_CHECK_OFF,
+  SF_CHECK_FAST,
+  SF_CHECK_FULL,
+  SF_CHECK_PARANOID
+} sf_check_level;
+
+#ifdef DEBUG
+#define SF_CHECK_DEFAULT SF_CHECK_PARANOID
+#else
+#define SF_CHECK_DEFAULT SF_CHECK_FULL
+#endif
+
+extern int sf_check_cur;  // -1 until the level is first read
+extern int sf_set_check_level(sf_check_level level);
+extern int check_level_init();
+extern int check_header(sf_block *block);
+extern int check_neighbours(sf_block *block);
+
+/*
+ * @return The current check level.
+ */
+static inline int check_level() {
+#ifdef SF_CHECK_LEVEL
+  return SF_CHECK_LEVEL;
+#else
+  int level = __atomic_load_n(&sf_check_cur, __ATOMIC_RELAXED);
+  return (level >= 0) ? level : check_level_init();
+#endif
+}
+
+/*
+ * Check a pointer to be freed or reallocated with the lock of the current
+ * arena held.
+ * Returns 0 if the pointer passed, -1 otherwise.
+ */
+static inline int check_pointer(void *pp) {
+  int level = check_level();
+  if (level == SF_CHECK_OFF) {
+    return 0;
+  }
+  if (level == SF_CHECK_FAST) {
+    return check_header(get_sf_block(pp));
+  }
+  if (is_pointer_invalid(pp)) {
+    return -1;
+  }
+  return (level == SF_CHECK_PARANOID) ? check_neighbours(get_sf_block(pp)) : 0;
+}
+
+/*
+ * Check a pointer to be freed to an arena without holding its lock.
+ * Returns 0 if the pointer passed, -1 otherwise.
+ */
+static inline int check_pointer_unlocked(sf_arena *arena, void *pp) {
+  int level = check_level();
+  if (level == SF_CHECK_OFF) {
+    return 0;
+  }
+  if (level == SF_CHECK_FAST) {
+    return check_header(get_sf_block(pp));
+  }
+  return is_pointer_plausible(arena, pp) ? 0 : -1;
+}
+
+#endif /* CHECK_H */
@@ -0,0 +1,78 @@
+/*
+ * Hot path event counters
+ *
+ * Building with -DSF_COUNTERS (make COUNTERS=1, after make clean) counts
+ * what the heap did for every request, per free list size class of the
+ * block size involved, to show where a workload spends its time:
+ *
+ *  event             counted when
+ *  SF_EV_QUICK_HIT   remove_quicklist() pops a block
+ *  SF_EV_QUICK_MISS  remove_quicklist() finds the quick list empty
+ *  SF_EV_EXACT_FIT   remove_free_list() takes a block of exactly the size
+ *  SF_EV_SPLIT       remove_free_list() splits a larger block
+ *  SF_EV_LAST_DITCH  remove_free_list() takes a block too small to split
+ *  SF_EV_MISS        remove_free_list() finds no block
+ *  SF_EV_WALK        remove_free_list() looks at a list block
+ *  SF_EV_GROW        grow_heap() has to grow the heap
+ *  SF_EV_COALESCE    coallesce() merges a block with a free neighbour,
+ *                    in the class of the merged block
+ *  SF_EV_FLUSH       a quick list is flushed to the free lists
+ *  SF_EV_FLUSHED     a block is flushed with it
+ *
+ * Dividing SF_EV_WALK by the free list searches (exact fits, splits, last
+ * ditch passes and misses) gives the average walk length of a class. The
+ * free trees and the TLSF lists are not walked, except for the TLSF
+ * fallback scan of the list the size maps to, which counts as a walk.
+ * Allocations served from a thread cache or a slab never reach the heap and
+ * are not counted.
+ *
+ * The counters live in the arena and are updated under its lock, so they
+ * cost a plain increment. sf_get_counters() adds up the arenas and
+ * sf_dump_counters() writes them out as a table. Without SF_COUNTERS the
+ * SF_COUNT macros compile to nothing and both fail with ENOTSUP. The
+ * macros need arena.h.
+ */
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+
+#include "sfmm.h"
+
+typedef enum {
+  SF_EV_QUICK_HIT,
+  SF_EV_QUICK_MISS,
+  SF_EV_EXACT_FIT,
+  SF_EV_SPLIT,
+  SF_EV_LAST_DITCH,
+  SF_EV_MISS,
+  SF_EV_WALK,
+  SF_EV_GROW,
+  SF_EV_COALESCE,
+  SF_EV_FLUSH,
+  SF_EV_FLUSHED,
+  SF_EV_COUNT
+} sf_event;
+
+typedef struct {
+  uint64_t counts[SF_EV_COUNT][NUM_FREE_LISTS];  // by event and class
+} sf_event_counters;
+
+#ifdef SF_COUNTERS
+#define SF_COUNT_N(event, size, n) \
+  (sf_arena_cur->event_counters.counts[event][get_free_list_index(size)] += (n))
+#else
+#define SF_COUNT_N(event, size, n) ((void)0)
+#endif
+#define SF_COUNT(event, size) SF_COUNT_N(event, size, 1)
+// a free block of block_size bytes taken for size bytes
+#define SF_COUNT_FIT(block_size, size)                         \
+  SF_COUNT((block_size) == (size) ? SF_EV_EXACT_FIT            \
+           : (block_size) >= (size) + MIN_BLOCK_SIZE ? SF_EV_SPLIT \
+                                                     : SF_EV_LAST_DITCH, \
+           size)
+
+extern int sf_get_counters(sf_event_counters *counters);
+extern int sf_dump_counters(int fd);
+
+#endif /* COUNTERS_H */
@@ -0,0 +1,50 @@
+/*
+ * Free trees for the large size classes
+ *
+ * Free blocks in the size classes starting at FREE_TREE_MIN_INDEX are kept
+ * in a red-black tree per class in addition to their free list, keyed by
+ * block size and then by address. The tree nodes live inside the free blocks
+ * themselves, right after the free list links, which is always room enough
+ * since these blocks are larger than 128M.
+ *
+ * The free list of such a class stays sorted by size because every block is
+ * linked in front of its in-order successor, so insertion, removal and
+ * best-fit search are all O(log n) while the lists remain walkable.
+ *
+ *  +--------------------------------+
+ *  | header                         |
+ *  | next / prev (free list links)  |
+ *  | left / right / parent          |
+ *  | color                          |
+ *  | ...                            |
+ *  | footer                         |
+ *  +--------------------------------+
+ */
+#ifndef FREE_TREE_H
+#define FREE_TREE_H
+
+#include "block_layout.h"
+#include "sfmm.h"
+
+#define FREE_TREE_MIN_INDEX (NUM_FREE_LISTS - 2)
+
+typedef struct sf_tree_node *sf_tree_link SF_FIELD_ALIGN;
+
+typedef struct sf_tree_node {
+  sf_word header;
+  sf_link next;
+  sf_link prev;
+  sf_tree_link left;
+  sf_tree_link right;
+  sf_tree_link parent;
+  sf_block_field red;
+} sf_tree_node;
+
+extern int init_free_trees();
+extern int free_tree_insert(int index, sf_block *block);
+extern int free_tree_remove(int index, sf_block *block);
+extern sf_block *free_tree_next(sf_block *block);
+extern sf_block *free_tree_lower_bound(int index, size_t size);
+extern sf_block *free_tree_best_fit(size_t size);
+
+#endif /* FREE_TREE_H */
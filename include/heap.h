@@ -0,0 +1,29 @@
+/*
+ * Heap growth
+ *
+ * When no free block fits a request, the heap is grown once by as many pages
+ * as the request needs beyond the wilderness block (the free block right
+ * before the epilogue, if any), and the block is carved straight from the
+ * new space.
+ *
+ * The growth policy decides how many pages are requested from the page
+ * provider in that one step:
+ * - SF_GROW_EXACT      only the pages the request needs (default)
+ * - SF_GROW_GEOMETRIC  at least as many pages as the heap already has
+ * - SF_GROW_CHUNK      at least sf_growth_chunk bytes worth of pages
+ */
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "sfmm.h"
+
+typedef enum { SF_GROW_EXACT, SF_GROW_GEOMETRIC, SF_GROW_CHUNK } sf_growth_policy;
+
+extern sf_growth_policy sf_growth;
+extern size_t sf_growth_chunk;
+
+extern int sf_set_growth_policy(sf_growth_policy policy, size_t chunk_size);
+extern size_t calc_growth_pages(size_t needed);
+extern sf_block *grow_heap(size_t size);
+
+#endif /* HEAP_H */
@@ -0,0 +1,54 @@
+/*
+ * Huge allocations
+ *
+ * Requests of at least sf_huge_threshold bytes bypass the heap and get a
+ * mapping of their own, which is unmapped as soon as the block is freed.
+ *
+ *  +--------------------------------+ <- mapping base (page aligned)
+ *  | unused                         |
+ *  +--------------------------------+
+ *  | huge prefix: base, size, align |
+ *  +--------------------------------+
+ *  | header: block size | marker    |
+ *  +--------------------------------+ <- payload (aligned)
+ *  | payload                        |
+ *  +--------------------------------+ <- mapping end
+ *
+ * The block size in the header runs from the header to the end of the
+ * mapping. An allocated block that claims to be in a quick list is never
+ * handed out by the heap, so that combination of header bits marks a huge
+ * block. Pointers outside the heaps of the arenas and the address space
+ * reserved for them are looked up in a table of live huge blocks before
+ * their header is read, so freeing a stray pointer still aborts instead of
+ * faulting. Only those lookups take the lock of the table.
+ *
+ * A huge block that stays huge when reallocated is resized with mremap, so
+ * growing it moves page table entries instead of copying the payload.
+ */
+#ifndef HUGE_H
+#define HUGE_H
+
+#include "sfmm.h"
+
+#define HUGE_BLOCK_MARKER (THIS_BLOCK_ALLOCATED | IN_QUICK_LIST)
+#define SF_HUGE_THRESHOLD_DEFAULT ((size_t)1 << 20)
+#define HUGE_TABLE_MIN_SLOTS 64
+
+typedef struct {
+  void *base;       // start of the mapping
+  size_t map_size;  // length of the mapping
+  size_t align;     // alignment of the payload
+} sf_huge_prefix;
+
+extern size_t sf_huge_threshold;
+
+extern int sf_set_huge_threshold(size_t threshold);
+extern int is_huge_request(size_t size);
+extern int is_huge_pointer(void *pp);
+extern void *huge_malloc(size_t size, size_t align);
+extern void huge_free(void *pp);
+extern void *huge_realloc(void *pp, size_t rsize);
+extern size_t huge_usable_size(void *pp);
+extern void huge_stats(size_t *blocks, size_t *bytes);
+
+#endif /* HUGE_H */
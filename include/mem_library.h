@@ -1,3 +1,6 @@
+#ifndef MEM_LIBRARY_H
+#define MEM_LIBRARY_H
+
 /*
  * MIN_PAYLOAD_SIZE
  * Each free block will have a footer, which occupies the last memory row of the
@@ -18,16 +21,42 @@ will be allocated as padding
  * - 8 prev pointer
  * - 8 footer
  *************************
+ *
+ * With SF_COMPACT_HEADERS each of these is 4 bytes wide, see block_layout.h.
  */
+#ifdef SF_COMPACT_HEADERS
+#define MIN_PAYLOAD_SIZE 12
+#define MIN_BLOCK_SIZE 16
+#else
 #define MIN_PAYLOAD_SIZE 24
 #define MIN_BLOCK_SIZE 32
+#endif
+
+/*
+ * QUICK LIST DEPTH
+ * Each quick list starts out flushing at QUICK_LIST_MAX blocks. Whenever a
+ * list overflows its depth is adapted to how often it was hit since the last
+ * overflow: hot size classes get deeper lists, cold ones shallower lists.
+ */
+#define QUICK_LIST_MIN_DEPTH 2
+#define QUICK_LIST_MAX_DEPTH 64
 #include "sfmm.h"
+#include "block_layout.h"
+#include "sf_thread.h"
 
+typedef struct {
+  int depth;  // flush threshold, 0 until the list first adapts
+  int hits;   // blocks handed out since the last overflow
+} sf_quick_list_ctl;
+
+extern size_t sf_min_align;
+
+extern int sf_set_min_alignment(size_t align);
 extern size_t calc_malloc_block_size(size_t size);
 extern int append_quicklist(sf_block *block);
 extern sf_block *write_block_header(sf_block *block, size_t size, int quicklist,
                                     int prev_alloc, int alloc);
-extern sf_footer *write_block_footer(sf_block *block);
+extern sf_word *write_block_footer(sf_block *block);
 extern sf_block *write_free_block(sf_block *block, size_t size, int quicklist,
                                   int prev_alloc, int alloc, sf_block *next,
                                   sf_block *prev);
@@ -35,18 +64,25 @@ extern sf_block *convert_to_free(sf_block *block);
 extern int init_free_lists();
 extern sf_block *get_free_list_head(size_t size);
 extern sf_block *split_block(sf_block *block, size_t size);
+extern sf_block *split_free_block(sf_block *block, size_t size);
 extern sf_block *get_block_end(sf_block *block);
 extern sf_block *alloc_block(sf_block *block, size_t size, int prev_alloc);
 extern sf_block *append_free_list(sf_block *block);
+extern sf_block *insert_free_list(sf_block *block);
 extern sf_block *remove_free_list(size_t size);
+extern sf_block *remove_free_tree(size_t size);
+extern sf_block *remove_exact_block_free_list(sf_block *block);
 extern sf_block *remove_quicklist(size_t size);
 extern sf_block *coallesce_prev(sf_block *block);
 extern sf_block *coallesce_next(sf_block *block);
 extern sf_block *coallesce(sf_block *block);
 extern sf_block *get_prev_block(sf_block *block);
+extern sf_block *realloc_in_place(void *pp, size_t rsize);
 extern sf_block *realloc_more_mem(void *pp, size_t rsize);
 extern sf_block *realloc_less_mem(void *pp, size_t rsize);
-extern void *memalign_malloc(void *pp, size_t alignment, size_t size);
+extern size_t aligned_offset(sf_block *block, size_t align);
+extern sf_block *remove_aligned_fit(size_t size, size_t align);
+extern void *alloc_aligned(sf_block *block, size_t size, size_t align);
 
 // helpers
 extern int set_prev_alloc_bit(sf_block *block, int prev_alloc);
@@ -59,8 +95,20 @@ extern int get_alloc_bit(sf_block *block);
 extern int get_quick_list_bit(sf_block *block);
 extern int remove_footer(sf_block *block);
 extern int get_free_list_index(size_t size);
+extern int get_quick_list_head(size_t size);
 extern int is_pointer_invalid(void *pp);
+extern int is_block_of_size(sf_block *block, size_t size);
+extern void sf_free_sized(void *pp, size_t size);
 extern int flush_quicklist(int quick_index);
+extern int flush_quicklist_batch(int quick_index, int count);
+extern int free_block_runs(sf_block **batch, int n, int purge);
 extern sf_block *remove_specific_quicklist(int quick_index);
+extern int get_quick_list_depth(int quick_index);
+extern int adapt_quick_list_depth(int quick_index);
 extern int is_exact_block_in_freelist(sf_block *block);
-extern sf_block *get_sf_block(void *pp);
\ No newline at end of file
+extern sf_block *get_sf_block(void *pp);
+
+// the lists above are those of the current arena
+#include "arena.h"
+
+#endif /* MEM_LIBRARY_H */
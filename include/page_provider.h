@@ -0,0 +1,66 @@
+/*
+ * Page providers
+ *
+ * The heap obtains its memory from a page provider, which hands out a single
+ * contiguous region that grows a page at a time at its end. The allocator
+ * only ever talks to the active provider through heap_start(), heap_end()
+ * and heap_grow().
+ *
+ * - sfutil   sf_mem_grow() and friends from sfutil.o, a fixed private
+ *            region of 21 pages that can not shrink (default)
+ * - mmap     a reserved range of virtual addresses, whose pages are only
+ *            committed as the heap grows into them
+ * - static   a buffer supplied by the caller
+ *
+ * Only the mmap provider promises that new pages read as zero, which lets
+ * sf_calloc() skip clearing them (see zero.h).
+ *
+ * The provider can only be changed before the heap is initialized.
+ */
+#ifndef PAGE_PROVIDER_H
+#define PAGE_PROVIDER_H
+
+#include "sfmm.h"
+
+/* Address space reserved by the mmap provider if no size is given. */
+#define SF_MMAP_DEFAULT_RESERVE ((size_t)1 << 36)
+
+typedef struct sf_page_provider {
+  const char *name;
+  void *(*start)(void *ctx);
+  void *(*end)(void *ctx);
+  /* Grow the region by up to pages pages, returns the number grown. */
+  size_t (*grow)(void *ctx, size_t pages);
+  /* Release up to pages pages at the end, returns the number released. */
+  size_t (*shrink)(void *ctx, size_t pages);  // NULL if unsupported
+  void *ctx;
+  int zeroed;  // grown pages read as zero until they are first written
+} sf_page_provider;
+
+/*
+ * State of a provider that hands out pages from one range of addresses.
+ * For the mmap provider the range is only reserved until pages are grown.
+ */
+typedef struct {
+  char *base;    // start of the range, NULL if not reserved yet
+  char *brk;     // end of the pages handed out so far
+  char *limit;   // end of the range
+  size_t size;   // size of the range
+} sf_region;
+
+extern sf_page_provider sf_sfutil_provider;
+
+extern int sf_set_page_provider(sf_page_provider *provider);
+extern int sf_use_sfutil_provider();
+extern int sf_use_mmap_provider(size_t reserve_size);
+extern int sf_use_static_provider(void *buffer, size_t size);
+extern sf_page_provider *init_region_provider(sf_page_provider *provider,
+                                              sf_region *region, void *base,
+                                              size_t size);
+
+extern void *heap_start();
+extern void *heap_end();
+extern size_t heap_grow(size_t pages);
+extern size_t heap_shrink(size_t pages);
+
+#endif /* PAGE_PROVIDER_H */
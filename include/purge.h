@@ -0,0 +1,69 @@
+/*
+ * Purging and trimming
+ *
+ * Whole pages inside large free blocks are handed back to the OS with
+ * madvise(), and a large wilderness block is trimmed by shrinking the heap
+ * when the page provider supports it.
+ *
+ * Every free block of at least PURGE_MIN_BLOCK_SIZE bytes records when it
+ * was freed and how many of its pages have been purged, right after its
+ * free tree node. Only the pages after that metadata and before the footer
+ * are purged:
+ *
+ *  +--------------------------------+
+ *  | tree node                      |
+ *  | freed at / purged pages        |
+ *  +--------------------------------+ <- first page boundary
+ *  | purged pages                   |
+ *  +--------------------------------+ <- last page boundary
+ *  | footer                         |
+ *  +--------------------------------+
+ *
+ * Blocks that have been free for longer than the decay time are purged
+ * automatically. Among free blocks of the same size, dirty ones are handed
+ * out before purged ones, so purged pages are reused last. Pages purged with
+ * SF_PURGE_DONTNEED are known to be zero when the block is reused.
+ */
+#ifndef PURGE_H
+#define PURGE_H
+
+#include "free_tree.h"
+#include "sfmm.h"
+
+#define PURGE_MIN_BLOCK_SIZE (2 * PAGE_SZ)
+#define SF_PURGE_DECAY_DEFAULT 10000
+#define SF_TRIM_THRESHOLD_DEFAULT (128 * 1024)
+
+typedef enum {
+  SF_PURGE_DONTNEED,  // pages read back as zero
+  SF_PURGE_FREE       // pages are reclaimed lazily, contents undefined
+} sf_purge_mode;
+
+typedef struct sf_purge_block {
+  sf_tree_node node;    // free tree node, unused by the TLSF engine
+  sf_block_field freed_at;      // time the block was freed, in milliseconds
+  sf_block_field purged_pages;  // pages purged since the block was freed
+  sf_block_field zeroed;        // purged pages read back as zero
+} sf_purge_block;
+
+typedef struct {
+  size_t dirty_bytes;    // bytes of large free blocks not purged
+  size_t purged_bytes;   // bytes of large free blocks purged
+  size_t trimmed_bytes;  // bytes the heap shrank by
+  size_t purges;         // madvise calls
+  size_t trims;          // times the heap shrank
+} sf_purge_stats;
+
+extern int sf_set_purge_decay(long decay_ms);
+extern int sf_set_purge_mode(sf_purge_mode mode);
+extern int sf_set_trim_threshold(size_t threshold);
+extern int sf_trim(size_t pad);
+extern void purge_note_insert(sf_block *block);
+extern void purge_note_remove(sf_block *block);
+extern int is_block_purged(sf_block *block);
+extern size_t purge_block(sf_block *block);
+extern size_t purge_free_blocks(uint64_t freed_before);
+extern size_t trim_wilderness(size_t pad);
+extern void purge_after_free(sf_block *block);
+
+#endif /* PURGE_H */
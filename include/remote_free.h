@@ -0,0 +1,39 @@
+/*
+ * Remote frees
+ *
+ * A block freed by a thread that does not allocate from the block's arena
+ * is pushed onto a lock-free stack of that arena instead of taking its
+ * lock. Any number of threads push, and whoever holds the arena lock next
+ * takes the whole stack at once and frees its blocks, which the owning
+ * threads do on their next miss.
+ *
+ * The top of the stack is a tagged pointer: the block address in the low
+ * REMOTE_TAG_SHIFT bits and a counter, bumped by every update, above it.
+ * A compare-and-swap therefore never succeeds against a top that was
+ * taken and pushed again in between (the ABA problem).
+ *
+ *  63            48 47                                  0
+ *  +---------------+-------------------------------------+
+ *  | tag           | top block                           |
+ *  +---------------+-------------------------------------+
+ *
+ * Like a cached block, a queued block stays marked allocated, and its
+ * payload links it to the next block and holds a key made from the arena. A
+ * block that already carries the key may be a double free, so it is freed
+ * under the lock after the stack is drained, which lets the heap catch it.
+ */
+#ifndef REMOTE_FREE_H
+#define REMOTE_FREE_H
+
+#include "arena.h"
+#include "sfmm.h"
+
+#define REMOTE_TAG_SHIFT 48
+#define REMOTE_PTR_MASK (((uint64_t)1 << REMOTE_TAG_SHIFT) - 1)
+#define REMOTE_KEY(arena) ((uint32_t)(uintptr_t)(arena) | 1)
+
+extern int remote_free(sf_arena *arena, void *pp);
+extern int remote_free_block(sf_arena *arena, sf_block *block);
+extern size_t remote_drain();
+
+#endif /* REMOTE_FREE_H */
@@ -0,0 +1,33 @@
+/*
+ * Threads
+ *
+ * Every public entry point locks an arena (see arena.h) around the unlocked
+ * heap_* functions that do the work on the current arena. Functions called
+ * with the lock held never call the public entry points themselves.
+ *
+ * sf_errno is redirected to a per-thread copy. The initial thread keeps
+ * using the global sf_errno from sfmm.h, so single threaded programs that
+ * read it directly see every error:
+ *
+ *   initial thread   -> sf_errno (global)
+ *   other threads    -> thread local copy
+ *
+ * This header must be included after sfmm.h.
+ */
+#ifndef SF_THREAD_H
+#define SF_THREAD_H
+
+#include "sfmm.h"
+
+extern int *sf_errno_location();
+#define sf_errno (*sf_errno_location())
+
+extern int is_initial_thread();
+extern void *heap_malloc(size_t size);
+extern void heap_free(void *pp);
+extern void heap_free_block(sf_block *block);
+extern void *heap_realloc(void *pp, size_t rsize);
+extern void *heap_memalign(size_t size, size_t align);
+extern void *heap_calloc(size_t nmemb, size_t size);
+
+#endif /* SF_THREAD_H */
@@ -0,0 +1,57 @@
+/*
+ * Slabs
+ *
+ * Requests of at most the slab limit (off by default, see sf_set_slab_max)
+ * are served from slabs: page sized, page aligned runs of equally sized
+ * slots with no header per object. Each slab starts with a small header
+ * and an allocation bitmap with one bit per slot:
+ *
+ *  +--------------------------------+ <- page boundary
+ *  | links, owner, slot size, count |
+ *  | bitmap (1 = slot in use)       |
+ *  +--------------------------------+ <- first slot (16 byte aligned)
+ *  | slot | slot | slot | ...       |
+ *  +--------------------------------+ <- page boundary
+ *
+ * Slab pages come from one reserved range of address space used for
+ * nothing else, so a pointer in that range is a slab pointer, and its slab
+ * header is found by masking off the offset within the page.
+ *
+ * Every arena keeps a list of its partially used slabs per size class and
+ * one spare empty slab. The pages of other empty slabs are purged and kept
+ * for new slabs of any class and arena.
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "sfmm.h"
+
+#define SLAB_MAX_SIZE 64
+#define SLAB_CLASS_COUNT 6
+#define SLAB_BITMAP_WORDS (PAGE_SZ / 8 / 64)
+#define SLAB_SPACE ((size_t)1 << 36)
+
+struct sf_arena;
+
+typedef struct sf_slab {
+  struct sf_slab *next;    // next partially used slab of the class
+  struct sf_slab *prev;    // previous partially used slab of the class
+  struct sf_arena *arena;  // arena the slab belongs to
+  uint32_t slot_size;      // 0 if the page is not in use
+  uint32_t slots;          // number of slots
+  uint32_t used;           // number of slots in use
+  uint32_t first_slot;     // offset of the first slot from the slab
+  uint64_t bitmap[SLAB_BITMAP_WORDS];
+} sf_slab;
+
+extern int sf_set_slab_max(size_t max_size);
+extern int is_slab_request(size_t size);
+extern int is_slab_pointer(void *pp);
+extern sf_slab *get_slab(void *pp);
+extern void *slab_malloc(size_t size);
+extern size_t slab_malloc_batch(size_t size, size_t n, void **out);
+extern void slab_free(void *pp);
+extern void *slab_realloc(void *pp, size_t rsize);
+extern size_t slab_usable_size(void *pp);
+
+#endif /* SLAB_H */
@@ -0,0 +1,85 @@
+/*
+ * Heap statistics
+ *
+ * sf_get_stats() reports the state of every arena without walking its
+ * heap, so that it can be polled while the program runs. Each arena keeps
+ * counters that the paths changing its heap update under the arena lock:
+ *
+ *  counter                   updated by
+ *  free blocks and bytes     stats_note_insert/remove, wherever a block
+ *  per free list class       enters or leaves the free lists
+ *  live blocks               the heap_* entry points, batches and thread
+ *                            cache refills (stats_note_alloc/free)
+ *  requested and allocated   stats_note_alloc
+ *  bytes
+ *  grows                     heap_grow()
+ *  slab slots                slab_malloc() and slab_free()
+ *
+ * Huge blocks belong to no arena; huge.c counts them with atomics.
+ *
+ * The rest is derived when the statistics are taken:
+ * - quick list occupancy from the lengths the quick lists keep anyway.
+ * - live bytes from the heap size, less the free and quick list bytes and
+ *   the prologue and epilogue, so blocks that grow or shrink in place need
+ *   no bookkeeping.
+ * - the largest free block from the last non-empty class: the segregated
+ *   lists are sorted by size, so it is the tail of that list. With the TLSF
+ *   engine only the last non-empty TLSF list is searched.
+ * - trims from the purge counters of purge.h.
+ *
+ * Blocks held by thread caches or waiting on a remote free stack are
+ * allocated as far as the heap knows, and count as live. Allocations served
+ * from a thread cache do not reach the heap and are not counted in
+ * requested_bytes. The size a block was requested for is not kept, so
+ * internal fragmentation is measured over all allocations made since the
+ * start, not over the live blocks.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include "sfmm.h"
+
+/* Counters of one arena. */
+typedef struct {
+  size_t live_blocks;      // allocated heap blocks
+  size_t requested_bytes;  // bytes requested by heap allocations so far
+  size_t allocated_bytes;  // block bytes handed out for them
+  size_t free_blocks[NUM_FREE_LISTS];
+  size_t free_bytes[NUM_FREE_LISTS];
+  size_t grows;        // times the heap grew
+  size_t grown_bytes;  // bytes the heap grew by
+  size_t slab_slots;   // slab slots in use
+  size_t slab_bytes;   // their bytes
+} sf_heap_stats;
+
+typedef struct {
+  size_t heap_size;        // bytes of all arena heaps
+  size_t live_blocks;      // allocated heap blocks
+  size_t live_bytes;       // their size, headers included
+  size_t requested_bytes;  // bytes requested by heap allocations so far
+  size_t allocated_bytes;  // block bytes handed out for them
+  double internal_fragmentation;  // 1 - requested / allocated bytes
+  size_t free_blocks[NUM_FREE_LISTS];  // per sf_free_list_heads class
+  size_t free_bytes[NUM_FREE_LISTS];
+  size_t free_total;                    // bytes in the free lists
+  size_t quick_blocks[NUM_QUICK_LISTS];
+  size_t quick_bytes;                   // bytes in the quick lists
+  size_t largest_free;                  // largest free list block
+  double external_fragmentation;        // 1 - largest_free / free_total
+  size_t grows;          // times a heap grew
+  size_t grown_bytes;    // bytes the heaps grew by
+  size_t trims;          // times a heap shrank
+  size_t trimmed_bytes;  // bytes the heaps shrank by
+  size_t huge_blocks;    // blocks with a mapping of their own
+  size_t huge_bytes;     // bytes of their mappings
+  size_t slab_slots;     // slab slots in use
+  size_t slab_bytes;     // their bytes
+} sf_stats;
+
+extern sf_stats sf_get_stats();
+extern void stats_note_insert(sf_block *block);
+extern void stats_note_remove(sf_block *block);
+extern void stats_note_alloc(sf_block *block, size_t requested);
+extern void stats_note_free(sf_block *block);
+
+#endif /* STATS_H */
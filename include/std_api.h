@@ -0,0 +1,40 @@
+/*
+ * C library allocation semantics
+ *
+ * The std_* functions give the sf_* entry points the behaviour the C
+ * library documents for malloc() and friends, and malloc_api.c exports them
+ * under the standard names in libsfmm.so and libsfmm.a. They live apart from
+ * malloc_api.c so that the tests can call them without replacing the malloc
+ * of the test binary.
+ *
+ * - A request for 0 bytes gets a unique pointer, realloc() of 0 bytes frees.
+ * - Failures set errno, posix_memalign() returns the error instead.
+ * - Every payload is 16 byte aligned, as the x86-64 and AArch64 ABIs expect
+ *   of malloc(). The first call switches the heap to 16 byte alignment with
+ *   sf_set_min_alignment() before any heap is laid out, so heap blocks,
+ *   blocks moved by realloc(), slab slots and huge blocks all keep it. The
+ *   first call also switches arena 0 to the mmap provider.
+ */
+#ifndef STD_API_H
+#define STD_API_H
+
+#include <stddef.h>
+
+/* The alignment of every payload the std_* functions return. */
+#define STD_ALIGN 16
+
+extern void std_init();
+extern void *std_malloc(size_t size);
+extern void std_free(void *pp);
+extern void *std_calloc(size_t nmemb, size_t size);
+extern void *std_realloc(void *pp, size_t size);
+extern void *std_reallocarray(void *pp, size_t nmemb, size_t size);
+extern int std_posix_memalign(void **memptr, size_t align, size_t size);
+extern void *std_aligned_alloc(size_t align, size_t size);
+extern void *std_memalign(size_t align, size_t size);
+extern void *std_valloc(size_t size);
+extern void *std_pvalloc(size_t size);
+extern void std_free_sized(void *pp, size_t size);
+extern size_t std_malloc_usable_size(void *pp);
+
+#endif /* STD_API_H */
@@ -0,0 +1,48 @@
+/*
+ * Thread caches
+ *
+ * Once the allocator is used from more than one thread, every thread keeps
+ * a small cache of blocks for each quick list size class, and serves
+ * allocations and frees of those sizes from it without taking the heap lock.
+ * A cache bin is refilled from the thread's arena and drained to the arenas
+ * its blocks came from, in batches under the arena locks:
+ *
+ *   sf_malloc -> bin -> (empty) refill TCACHE_BATCH blocks from the heap
+ *   sf_free   -> bin -> (full)  drain TCACHE_BATCH blocks to the heap
+ *
+ * Cached blocks stay marked allocated in their headers, so the shared heap
+ * never coalesces with them and their headers are never written without
+ * the lock. The payload of a cached block links it into its bin and holds
+ * the key of the owning cache, which catches most double frees:
+ *
+ *  +--------------------------------+
+ *  | header (allocated)             |
+ *  +--------------------------------+
+ *  | next cached block              |
+ *  | cache key                      |
+ *  +--------------------------------+
+ *
+ * A thread's cached blocks go back to the heap when it exits.
+ */
+#ifndef TCACHE_H
+#define TCACHE_H
+
+#include "sfmm.h"
+
+#define TCACHE_MAX 16
+#define TCACHE_BATCH (TCACHE_MAX / 2)
+
+typedef enum {
+  SF_TCACHE_AUTO,  // caches are used once a second thread allocates
+  SF_TCACHE_ON,
+  SF_TCACHE_OFF
+} sf_tcache_mode;
+
+extern int sf_set_thread_cache(sf_tcache_mode mode);
+extern int tcache_count(size_t size);
+extern void *tcache_malloc(size_t size);
+extern int tcache_free(void *pp);
+extern int tcache_free_block(sf_block *block);
+extern void tcache_flush();
+
+#endif /* TCACHE_H */
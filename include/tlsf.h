@@ -0,0 +1,52 @@
+/*
+ * TLSF (two-level segregated fit) free list engine
+ *
+ * Free blocks are segregated by a first level index, the power of two that
+ * the block size falls in, and a second level index which splits each power
+ * of two range linearly into TLSF_SL_COUNT lists. Sizes below
+ * TLSF_SMALL_BLOCK all share first level 0 and are split into exact
+ * 8 byte classes.
+ *
+ * A bitmap over the first level and one bitmap per first level over the
+ * second level record which lists are non-empty, so finding a fitting list
+ * takes two find-first-set instructions regardless of the size of the heap.
+ *
+ * Lists use the same circular, doubly linked layout with a dummy head as
+ * sf_free_list_heads, blocks are pushed and popped at the head.
+ */
+#ifndef TLSF_H
+#define TLSF_H
+
+#include "sfmm.h"
+
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_ALIGN_LOG2 3
+#define TLSF_SMALL_BLOCK (1 << (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2))
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2 - 1)
+#define TLSF_FL_COUNT (64 - TLSF_FL_SHIFT)
+#define TLSF_FALLBACK_SCAN 16
+
+typedef enum {
+  SF_SEGREGATED_LISTS,  // the NUM_FREE_LISTS lists in sf_free_list_heads
+  SF_TLSF               // two-level segregated fit with bitmap lookup
+} sf_free_list_engine;
+
+typedef struct {
+  uint64_t fl_bitmap;                    // non-empty first levels
+  uint32_t sl_bitmap[TLSF_FL_COUNT];     // non-empty second levels
+  struct sf_block heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} sf_tlsf_state;
+
+extern sf_free_list_engine sf_engine;
+
+extern int sf_set_free_list_engine(sf_free_list_engine engine);
+extern int tlsf_init();
+extern void tlsf_mapping(size_t size, int *fl, int *sl);
+extern sf_block *tlsf_insert(sf_block *block);
+extern sf_block *tlsf_remove_block(sf_block *block);
+extern sf_block *tlsf_find_fit(size_t size);
+extern sf_block *tlsf_find_list(size_t size);
+extern sf_block *tlsf_remove_free_list(size_t size);
+
+#endif /* TLSF_H */
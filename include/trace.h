@@ -0,0 +1,101 @@
+/*
+ * Allocation traces
+ *
+ * bin/sfmm_bench replays traces of allocation calls. Two formats are read:
+ *
+ * - text traces in the style of the CMU malloc lab: optional header lines
+ *   of numbers (suggested heap size, number of ids, number of operations,
+ *   weight), then one operation per line, where ids name the objects:
+ *
+ *     a <id> <size>            sf_malloc
+ *     r <id> <size>            sf_realloc
+ *     f <id>                   sf_free
+ *     m <id> <size> <align>    sf_memalign
+ *
+ *   Lines starting with # are comments.
+ *
+ * - binary traces: an sf_trace_header followed by sf_trace_event records
+ *   in the byte order of the machine that wrote them.
+ *
+ * sf_trace_start() records binary traces of the calls made to sf_malloc,
+ * sf_calloc, sf_realloc, sf_memalign, sf_free and their sized and batch
+ * forms. The calls only append a raw event to a ring buffer of their own
+ * thread, mapped outside the heap and taken by no lock:
+ *
+ *   thread 1 -> ring --+
+ *   thread 2 -> ring --+--> flusher thread --> file
+ *   thread 3 -> ring --+
+ *
+ * Every SF_TRACE_FLUSH_MS, or every millisecond while a ring is more than
+ * a quarter full, the flusher empties the rings, merges their events by
+ * time stamp (the time stamp counter on x86-64), and writes those older
+ * than SF_TRACE_SETTLE_MS, so that events a preempted thread has yet to
+ * publish still land in order. It turns addresses into object ids as it
+ * goes: allocations get the next id, a reallocated object keeps its id,
+ * and frees of blocks allocated before recording started are dropped.
+ * Events are dropped, and counted, when a ring is full, when a thread gets
+ * no ring (after SF_TRACE_MAX_THREADS live threads, it does not try again),
+ * and when the flusher has no memory left to follow a new object.
+ *
+ * With libsfmm.so, the SFMM_TRACE environment variable names a file to
+ * record the whole run to.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SF_TRACE_MAGIC 0x52545346u  // "SFTR"
+#define SF_TRACE_VERSION 1
+#define SF_TRACE_RING_SLOTS ((size_t)1 << 15)  // per thread, a power of 2
+#define SF_TRACE_MAX_THREADS 1024
+#define SF_TRACE_FLUSH_MS 10
+#define SF_TRACE_SETTLE_MS 10
+
+/* Operations, the same letters as in text traces. */
+#define SF_TRACE_MALLOC 'a'
+#define SF_TRACE_REALLOC 'r'
+#define SF_TRACE_FREE 'f'
+#define SF_TRACE_MEMALIGN 'm'
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+} sf_trace_header;
+
+typedef struct {
+  uint64_t time;        // nanoseconds since the trace started
+  uint64_t size;        // bytes requested, 0 for frees
+  uint32_t id;          // object id, kept by sf_realloc
+  uint16_t thread;      // thread that made the call
+  uint8_t op;           // one of SF_TRACE_*
+  uint8_t align_shift;  // log2 of the alignment of sf_memalign, 0 otherwise
+} sf_trace_event;
+
+/* An event as recorded by the calling thread, before it has an id. */
+typedef struct {
+  uint64_t time;  // ticks, see trace.c
+  uint64_t addr;  // block returned, or block freed
+  uint64_t old;   // block passed to sf_realloc
+  uint64_t size;
+  uint8_t op;
+  uint8_t align_shift;
+} sf_trace_raw;
+
+extern int sf_trace_on;  // nonzero while recording
+
+#define trace_on() __atomic_load_n(&sf_trace_on, __ATOMIC_RELAXED)
+
+extern int sf_trace_start(const char *path);
+extern int sf_trace_stop();
+extern uint64_t sf_trace_dropped();
+extern void trace_record(int op, void *pp, void *old, size_t size,
+                         size_t align);
+
+/* sf_malloc and sf_free without recording, for calls made by the allocator
+ * itself. */
+extern void *malloc_untraced(size_t size);
+extern void free_untraced(void *pp);
+
+#endif /* TRACE_H */
@@ -0,0 +1,55 @@
+/*
+ * Zeroed allocations
+ *
+ * sf_calloc() only clears the bytes of a block that may hold old data. Two
+ * kinds of memory are known to read as zero:
+ *
+ * - fresh memory, grown from a provider whose pages start out zero and not
+ *   handed out since. Each arena keeps a frontier, zero_from, that moves to
+ *   the end of every block allocated past it. Past the frontier only the
+ *   first ZERO_SKIP bytes, where a free block starting at the frontier keeps
+ *   its header, links and purge metadata, and the footer of the free block
+ *   that runs to the epilogue have ever been written:
+ *
+ *    heap_start              zero_from                        heap_end
+ *    +-----------------------+------+------------------+------+----+
+ *    | used at some point    | skip | zero             |footer|epi |
+ *    +-----------------------+------+------------------+------+----+
+ *
+ * - pages purged with MADV_DONTNEED while their block was free (purge.h).
+ *
+ * A block that is split past the frontier, as memalign() splits the block
+ * that grow_heap() split off the wilderness, moves the frontier to its old
+ * end, where the boundary words of the first split stay behind.
+ *
+ * Whenever a block is allocated past the frontier, or a purged block leaves
+ * the free lists, the part of it known to be zero is recorded in the arena.
+ * sf_calloc() clears the records, allocates, and then clears whatever part
+ * of the payload the records do not cover. Large stretches are cleared with
+ * non-temporal stores that do not pull the block into the cache.
+ */
+#ifndef ZERO_H
+#define ZERO_H
+
+#include "purge.h"
+#include "sfmm.h"
+
+/* Bytes at the start of a free block that hold metadata. */
+#define ZERO_SKIP sizeof(sf_purge_block)
+/* Stretches at least this long are cleared around the cache. */
+#define ZERO_STREAM_MIN (256 * 1024)
+
+typedef struct {
+  char *start;
+  char *end;
+} sf_zero_range;
+
+extern void *sf_calloc(size_t nmemb, size_t size);
+extern void zero_note_grow();
+extern void zero_note_alloc(sf_block *block);
+extern void zero_note_split(char *end);
+extern void zero_note_purged(char *start, char *end);
+extern void zero_note_reset();
+extern void zero_payload(void *pp, size_t size);
+
+#endif /* ZERO_H */
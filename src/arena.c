@@ -0,0 +1,215 @@
+#define _DEFAULT_SOURCE
+#include "arena.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+
+// the globals of sfmm.h are the lists of arena 0
+#undef sf_free_list_heads
+#undef sf_quick_lists
+
+static sf_arena main_arena = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .index = 0,
+    .free_list_heads = sf_free_list_heads,
+    .quick_lists = sf_quick_lists,
+    .provider = &sf_sfutil_provider,
+};
+
+__thread sf_arena *sf_arena_cur = &main_arena;
+
+static sf_arena *arenas[SF_MAX_ARENAS] = {&main_arena};
+static int arena_count;  // 0 until the first thread is assigned an arena
+static unsigned int arena_next = 1;
+static char *arena_space;  // reserved range of arenas 1 and up
+static pthread_mutex_t arena_create_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread sf_arena *thread_assigned;
+
+/*
+ * Set the number of arenas, between 1 and SF_MAX_ARENAS. By default there
+ * is one per online CPU.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if the count is out of range or
+ * a thread has already been assigned an arena other than arena 0.
+ */
+int sf_set_arena_count(int count) {
+  if (count < 1 || count > SF_MAX_ARENAS ||
+      __atomic_load_n(&arena_space, __ATOMIC_ACQUIRE) != NULL) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  __atomic_store_n(&arena_count, count, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/*
+ * @return The number of arenas threads are spread over.
+ */
+int sf_arena_count() {
+  int count = __atomic_load_n(&arena_count, __ATOMIC_RELAXED);
+  if (count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = (cpus < 1) ? 1 : (cpus > SF_MAX_ARENAS) ? SF_MAX_ARENAS : cpus;
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&arena_count, &expected, count, 0,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      count = expected;
+    }
+  }
+  return count;
+}
+
+/*
+ * @return The arena with the given index, or NULL if it was not created.
+ */
+sf_arena *get_arena(int index) {
+  if (index < 0 || index >= SF_MAX_ARENAS) {
+    return NULL;
+  }
+  return __atomic_load_n(&arenas[index], __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Create the arena with the given index, reserving the address space of
+ * all arenas the first time.
+ * @return The arena, or NULL if it could not be mapped.
+ */
+static sf_arena *arena_create(int index) {
+  pthread_mutex_lock(&arena_create_lock);
+  sf_arena *arena = arenas[index];
+  if (arena != NULL) {
+    pthread_mutex_unlock(&arena_create_lock);
+    return arena;
+  }
+  if (arena_space == NULL) {
+    void *space = mmap(NULL, (SF_MAX_ARENAS - 1) * SF_ARENA_SPAN, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (space == MAP_FAILED) {
+      pthread_mutex_unlock(&arena_create_lock);
+      return NULL;
+    }
+    __atomic_store_n(&arena_space, space, __ATOMIC_RELEASE);
+  }
+  arena = mmap(NULL, sizeof(sf_arena), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (arena == MAP_FAILED) {
+    pthread_mutex_unlock(&arena_create_lock);
+    return NULL;
+  }
+  pthread_mutex_init(&arena->lock, NULL);
+  arena->index = index;
+  arena->free_list_heads = arena->own_free_list_heads;
+  arena->quick_lists = arena->own_quick_lists;
+  arena->provider =
+      init_region_provider(&arena->own_provider, &arena->own_region,
+                           arena_space + (index - 1) * SF_ARENA_SPAN,
+                           SF_ARENA_SPAN);
+  __atomic_store_n(&arenas[index], arena, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&arena_create_lock);
+  return arena;
+}
+
+/*
+ * @return The arena the calling thread allocates from. The initial thread
+ * uses arena 0, other threads are assigned one round-robin on their first
+ * call.
+ */
+sf_arena *thread_arena() {
+  if (thread_assigned != NULL) {
+    return thread_assigned;
+  }
+  sf_arena *arena = &main_arena;
+  if (!is_initial_thread()) {
+    int index = __atomic_fetch_add(&arena_next, 1, __ATOMIC_RELAXED) %
+                sf_arena_count();
+    if (index != 0) {
+      arena = get_arena(index);
+      if (arena == NULL) {
+        arena = arena_create(index);
+      }
+      if (arena == NULL) {
+        arena = &main_arena;
+      }
+    }
+  }
+  thread_assigned = arena;
+  return arena;
+}
+
+/*
+ * @return The arena whose address space contains pp. Pointers outside the
+ * arenas' reserved range, including huge blocks, belong to arena 0.
+ */
+sf_arena *arena_of(void *pp) {
+  char *space = __atomic_load_n(&arena_space, __ATOMIC_ACQUIRE);
+  if (space == NULL || (char *)pp < space ||
+      (char *)pp >= space + (SF_MAX_ARENAS - 1) * SF_ARENA_SPAN) {
+    return &main_arena;
+  }
+  sf_arena *arena = get_arena(1 + ((char *)pp - space) / SF_ARENA_SPAN);
+  return (arena != NULL) ? arena : &main_arena;
+}
+
+/*
+ * Lock an arena and make it the current arena of the calling thread.
+ * @return The previous current arena, to be passed to arena_leave.
+ */
+sf_arena *arena_enter(sf_arena *arena) {
+  pthread_mutex_lock(&arena->lock);
+  sf_arena *prev = sf_arena_cur;
+  sf_arena_cur = arena;
+  return prev;
+}
+
+/*
+ * Unlock the current arena and restore the one that was current before.
+ */
+void arena_leave(sf_arena *prev) {
+  sf_arena *arena = sf_arena_cur;
+  sf_arena_cur = prev;
+  pthread_mutex_unlock(&arena->lock);
+}
+
+/*
+ * Check what can be checked about a pointer to be freed to an arena without
+ * holding its lock: the checks of is_pointer_invalid, except for the footer
+ * of a free previous block, which may be changing under the lock.
+ * Return 1 if the pointer looks valid, 0 otherwise.
+ */
+int is_pointer_plausible(sf_arena *arena, void *pp) {
+  sf_block *block = get_sf_block(pp);
+  if ((uintptr_t)pp % 8 != 0 || (void *)block < arena_heap_start(arena) ||
+      (void *)block >= arena_heap_end(arena)) {
+    return 0;
+  }
+  size_t size = get_block_size(block);
+  if (size < MIN_BLOCK_SIZE || size % 8 != 0 ||
+      (void *)block + size > arena_heap_end(arena)) {
+    return 0;
+  }
+  return get_alloc_bit(block) == 1 && get_quick_list_bit(block) == 0;
+}
+
+/*
+ * @return The starting address of an arena's heap.
+ */
+void *arena_heap_start(sf_arena *arena) {
+  return arena->provider->start(arena->provider->ctx);
+}
+
+/*
+ * @return The ending address of an arena's heap.
+ */
+void *arena_heap_end(sf_arena *arena) {
+  return arena->provider->end(arena->provider->ctx);
+}
@@ -0,0 +1,163 @@
+#include "batch.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "check.h"
+#include "heap.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "remote_free.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+#include "slab.h"
+#include "stats.h"
+#include "trace.h"
+
+/*
+ * Allocate n blocks of blocksize bytes back to back from a free, unlinked
+ * block of at least n * blocksize bytes. The last block also takes what is
+ * left over, which is less than MIN_BLOCK_SIZE, and is the only one whose
+ * neighbour and frontier bookkeeping alloc_block has to do.
+ */
+static void carve_blocks(sf_block *block, size_t blocksize, size_t n,
+                         void **out) {
+  size_t last = get_block_size(block) - (n - 1) * blocksize;
+  int prev_alloc = get_prev_alloc_bit(block);
+  for (size_t i = 0; i < n - 1; i++) {
+    write_block_header(block, blocksize, 0, prev_alloc, 1);
+    out[i] = (char *)block + HEADER_SIZE;
+    block = get_block_end(block);
+    prev_alloc = 1;
+  }
+  alloc_block(block, last, prev_alloc);
+  out[n - 1] = (char *)block + HEADER_SIZE;
+}
+
+/*
+ * Allocate n blocks for size bytes each from the current arena.
+ * Returns the number of blocks stored in out.
+ */
+static size_t heap_malloc_batch(size_t size, size_t n, void **out) {
+  size_t count = 0;
+  // huge blocks are mapped one by one, and the first block of an empty heap
+  // lays it out
+  if (is_huge_request(size) || heap_start() == heap_end()) {
+    if ((out[count] = heap_malloc(size)) == NULL) {
+      return count;
+    }
+    count++;
+    if (is_huge_request(size)) {
+      while (count < n && (out[count] = heap_malloc(size)) != NULL) {
+        count++;
+      }
+      return count;
+    }
+  }
+  size_t blocksize = calc_malloc_block_size(size);
+  sf_block *block;
+  while (count < n && (block = remove_quicklist(blocksize)) != NULL) {
+    alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+    stats_note_alloc(block, size);
+    out[count++] = (char *)block + HEADER_SIZE;
+  }
+  if (count == n) {
+    return count;
+  }
+  size_t left = n - count;
+  block = NULL;
+  if (blocksize <= SIZE_MAX / left) {
+    int saved = sf_errno;
+    block = remove_free_list(blocksize * left);
+    if (block == NULL) {
+      block = grow_heap(blocksize * left);
+    }
+    sf_errno = saved;
+  }
+  if (block != NULL) {
+    carve_blocks(block, blocksize, left, out + count);
+    for (size_t i = count; i < n; i++) {
+      stats_note_alloc(get_sf_block(out[i]), size);
+    }
+    return n;
+  }
+  // no room for all of them at once, what did not fit may still fit apart
+  while (count < n && (out[count] = heap_malloc(size)) != NULL) {
+    count++;
+  }
+  return count;
+}
+
+/*
+ * Allocate n objects of size bytes into out, locking the arena once.
+ * Returns the number of objects allocated, fewer than n with sf_errno set
+ * to ENOMEM if memory ran out. Those that were allocated stay allocated.
+ */
+size_t sf_malloc_batch(size_t size, size_t n, void **out) {
+  if (size == 0 || n == 0) {
+    return 0;
+  }
+  sf_arena *prev = arena_enter(thread_arena());
+  size_t count;
+  if (is_slab_request(size)) {
+    count = slab_malloc_batch(size, n, out);
+  } else {
+    remote_drain();
+    count = heap_malloc_batch(size, n, out);
+  }
+  arena_leave(prev);
+  for (size_t i = 0; trace_on() && i < count; i++) {
+    trace_record(SF_TRACE_MALLOC, out[i], NULL, size, 0);
+  }
+  return count;
+}
+
+static int compare_pointers(const void *a, const void *b) {
+  char *x = *(char *const *)a;
+  char *y = *(char *const *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Free n pointers, skipping NULL ones. The heap blocks of the calling
+ * thread's arena are freed under one lock, runs of adjacent blocks as one
+ * free block. The order of ptrs is not kept.
+ * Aborts on an invalid pointer or one listed twice.
+ */
+void sf_free_batch(void **ptrs, size_t n) {
+  sf_arena *arena = thread_arena();
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    void *pp = ptrs[i];
+    if (arena_of(pp) == arena && pp > arena_heap_start(arena) &&
+        pp < arena_heap_end(arena)) {
+      if (trace_on()) {
+        trace_record(SF_TRACE_FREE, pp, NULL, 0, 0);
+      }
+      ptrs[count++] = pp;
+    } else if (pp != NULL) {
+      // slabs, huge blocks and other arenas
+      sf_free(pp);
+    }
+  }
+  qsort(ptrs, count, sizeof(void *), compare_pointers);
+  sf_block *batch[SF_BATCH_RUN_MAX];
+  sf_arena *prev = arena_enter(arena);
+  remote_drain();
+  for (size_t i = 0; i < count; i += SF_BATCH_RUN_MAX) {
+    int m = (count - i < SF_BATCH_RUN_MAX) ? count - i : SF_BATCH_RUN_MAX;
+    for (int j = 0; j < m; j++) {
+      void *pp = ptrs[i + j];
+      if (check_pointer(pp) != 0 || (i + j > 0 && pp == ptrs[i + j - 1])) {
+        abort();
+      }
+      batch[j] = get_sf_block(pp);
+      stats_note_free(batch[j]);
+    }
+    free_block_runs(batch, m, 1);
+  }
+  arena_leave(prev);
+}
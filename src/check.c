@@ -0,0 +1,130 @@
+#include "check.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "heap.h"
+#include "mem_library.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+#include "tlsf.h"
+
+int sf_check_cur = -1;
+
+/*
+ * Set the level at which freed and reallocated pointers are checked.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if the level is unknown, or the
+ * level was fixed at build time to another one.
+ */
+int sf_set_check_level(sf_check_level level) {
+#ifdef SF_CHECK_LEVEL
+  if (level != SF_CHECK_LEVEL) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+#else
+  if (level < SF_CHECK_OFF || level > SF_CHECK_PARANOID) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  __atomic_store_n(&sf_check_cur, level, __ATOMIC_RELAXED);
+#endif
+  return 0;
+}
+
+/*
+ * Read the level from SFMM_CHECK the first time it is needed, unless it
+ * was set before. Unknown values keep the default.
+ * @return The current level.
+ */
+int check_level_init() {
+  static const char *names[] = {"off", "fast", "full", "paranoid"};
+  int level = SF_CHECK_DEFAULT;
+  const char *value = getenv("SFMM_CHECK");
+  for (int i = 0; value != NULL && i <= SF_CHECK_PARANOID; i++) {
+    if (strcmp(value, names[i]) == 0) {
+      level = i;
+    }
+  }
+  int expected = -1;
+  if (!__atomic_compare_exchange_n(&sf_check_cur, &expected, level, 0,
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    level = expected;
+  }
+  return level;
+}
+
+/*
+ * Check the header of an allocated block without reading anything else.
+ * Returns 0 if the header is that of an allocated heap block, -1 otherwise.
+ */
+int check_header(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < MIN_BLOCK_SIZE || get_alloc_bit(block) == 0 ||
+      get_quick_list_bit(block) == 1) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * @return 1 if a free block is linked into the free lists, 0 otherwise.
+ */
+static int is_linked_free_block(sf_block *block) {
+  sf_block *next = block_next(block);
+  sf_block *prev = block_prev(block);
+  if (next == NULL || prev == NULL || block_prev(next) != block ||
+      block_next(prev) != block) {
+    return 0;
+  }
+  if (sf_engine == SF_TLSF) {
+    return 1;
+  }
+  // the segregated lists can be walked from their heads
+  sf_block *head = get_free_list_head(get_block_size(block));
+  for (sf_block *cur = block_next(head); cur != head; cur = block_next(cur)) {
+    if (cur == block) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * @return 1 if the header of a free block matches its footer, 0 otherwise.
+ */
+static int is_sound_free_block(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < MIN_BLOCK_SIZE || get_quick_list_bit(block) == 1) {
+    return 0;
+  }
+  sf_word *footer = (sf_word *)((char *)block + size - FOOTER_SIZE);
+  return *footer == (sf_word)BLOCK_HEADER(block) && is_linked_free_block(block);
+}
+
+/*
+ * Cross-check a block that passed is_pointer_invalid() with its neighbours
+ * in the current arena: the next block must know this one is allocated,
+ * and a free neighbour must have a matching footer and be in the free
+ * lists.
+ * Returns 0 if the neighbours agree, -1 otherwise.
+ */
+int check_neighbours(sf_block *block) {
+  sf_block *next = get_block_end(block);
+  if (get_prev_alloc_bit(next) == 0) {
+    return -1;
+  }
+  // the epilogue has no size and is always allocated
+  if ((char *)next < (char *)heap_end() - HEADER_SIZE &&
+      get_alloc_bit(next) == 0 && !is_sound_free_block(next)) {
+    return -1;
+  }
+  if (get_prev_alloc_bit(block) == 0 &&
+      !is_sound_free_block(get_prev_block(block))) {
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#define _DEFAULT_SOURCE
+#include "counters.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "sfmm.h"
+
+static const char *event_names[SF_EV_COUNT] = {
+    "quick_hit", "quick_miss", "exact_fit", "split", "last_ditch", "miss",
+    "walk",      "grow",       "coalesce",  "flush", "flushed"};
+
+/*
+ * Add up the event counters of all arenas, locking each in turn.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to ENOTSUP if built without SF_COUNTERS.
+ */
+int sf_get_counters(sf_event_counters *counters) {
+#ifdef SF_COUNTERS
+  memset(counters, 0, sizeof(sf_event_counters));
+  for (int i = 0; i < SF_MAX_ARENAS; i++) {
+    sf_arena *arena = get_arena(i);
+    if (arena == NULL) {
+      continue;
+    }
+    sf_arena *prev = arena_enter(arena);
+    for (int event = 0; event < SF_EV_COUNT; event++) {
+      for (int index = 0; index < NUM_FREE_LISTS; index++) {
+        counters->counts[event][index] +=
+            arena->event_counters.counts[event][index];
+      }
+    }
+    arena_leave(prev);
+  }
+  return 0;
+#else
+  sf_errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(fd, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    buf += written;
+    len -= written;
+  }
+  return 0;
+}
+
+/*
+ * Write the event counters of all arenas to fd as a table with a row per
+ * size class that saw any event, headed by the largest block size of the
+ * class.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to ENOTSUP if built without SF_COUNTERS, or
+ * to the error of write().
+ */
+int sf_dump_counters(int fd) {
+  sf_event_counters counters;
+  if (sf_get_counters(&counters) != 0) {
+    return -1;
+  }
+  char line[512];
+  int len = snprintf(line, sizeof(line), "%10s", "class");
+  for (int event = 0; event < SF_EV_COUNT; event++) {
+    len += snprintf(line + len, sizeof(line) - len, " %11s",
+                    event_names[event]);
+  }
+  len += snprintf(line + len, sizeof(line) - len, "\n");
+  if (write_all(fd, line, len) != 0) {
+    sf_errno = errno;
+    return -1;
+  }
+  for (int index = 0; index < NUM_FREE_LISTS; index++) {
+    uint64_t any = 0;
+    for (int event = 0; event < SF_EV_COUNT; event++) {
+      any |= counters.counts[event][index];
+    }
+    if (any == 0) {
+      continue;
+    }
+    // the last class holds everything larger
+    if (index == NUM_FREE_LISTS - 1) {
+      len = snprintf(line, sizeof(line), "%10s", "larger");
+    } else {
+      len = snprintf(line, sizeof(line), "%10lu",
+                     (unsigned long)MIN_BLOCK_SIZE << index);
+    }
+    for (int event = 0; event < SF_EV_COUNT; event++) {
+      len += snprintf(line + len, sizeof(line) - len, " %11llu",
+                      (unsigned long long)counters.counts[event][index]);
+    }
+    len += snprintf(line + len, sizeof(line) - len, "\n");
+    if (write_all(fd, line, len) != 0) {
+      sf_errno = errno;
+      return -1;
+    }
+  }
+  return 0;
+}
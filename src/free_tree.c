@@ -0,0 +1,313 @@
+#include "free_tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "purge.h"
+#include "sfmm.h"
+
+/*
+ * Initialize the free trees.
+ * Returns 0 if successful.
+ */
+int init_free_trees() {
+  for (int i = 0; i < NUM_FREE_LISTS; i++) {
+    sf_free_tree_roots[i] = NULL;
+  }
+  return 0;
+}
+
+/*
+ * Compare two tree nodes by size, then dirty before purged, then by address.
+ * Returns 1 if a orders before b, 0 otherwise.
+ */
+static int tree_less(sf_tree_node *a, sf_tree_node *b) {
+  size_t a_size = get_block_size((sf_block *)a);
+  size_t b_size = get_block_size((sf_block *)b);
+  if (a_size != b_size) {
+    return a_size < b_size;
+  }
+  int a_purged = is_block_purged((sf_block *)a);
+  int b_purged = is_block_purged((sf_block *)b);
+  if (a_purged != b_purged) {
+    return b_purged;
+  }
+  return a < b;
+}
+
+/*
+ * Rotate the subtree rooted at x to the left.
+ */
+static void rotate_left(sf_tree_node **root, sf_tree_node *x) {
+  sf_tree_node *y = x->right;
+  x->right = y->left;
+  if (y->left != NULL) y->left->parent = x;
+  y->parent = x->parent;
+  if (x->parent == NULL) {
+    *root = y;
+  } else if (x == x->parent->left) {
+    x->parent->left = y;
+  } else {
+    x->parent->right = y;
+  }
+  y->left = x;
+  x->parent = y;
+}
+
+/*
+ * Rotate the subtree rooted at x to the right.
+ */
+static void rotate_right(sf_tree_node **root, sf_tree_node *x) {
+  sf_tree_node *y = x->left;
+  x->left = y->right;
+  if (y->right != NULL) y->right->parent = x;
+  y->parent = x->parent;
+  if (x->parent == NULL) {
+    *root = y;
+  } else if (x == x->parent->right) {
+    x->parent->right = y;
+  } else {
+    x->parent->left = y;
+  }
+  y->right = x;
+  x->parent = y;
+}
+
+static int is_red(sf_tree_node *node) { return node != NULL && node->red; }
+
+/*
+ * Insert a free block into the tree of a size class.
+ * Returns 0 if successful.
+ */
+int free_tree_insert(int index, sf_block *block) {
+  sf_tree_node **root = &sf_free_tree_roots[index];
+  sf_tree_node *node = (sf_tree_node *)block;
+  sf_tree_node *parent = NULL;
+  sf_tree_node *cur = *root;
+  while (cur != NULL) {
+    parent = cur;
+    cur = tree_less(node, cur) ? cur->left : cur->right;
+  }
+  node->parent = parent;
+  node->left = NULL;
+  node->right = NULL;
+  node->red = 1;
+  if (parent == NULL) {
+    *root = node;
+  } else if (tree_less(node, parent)) {
+    parent->left = node;
+  } else {
+    parent->right = node;
+  }
+  // restore the red-black properties
+  while (is_red(node->parent)) {
+    sf_tree_node *grandparent = node->parent->parent;
+    if (node->parent == grandparent->left) {
+      sf_tree_node *uncle = grandparent->right;
+      if (is_red(uncle)) {
+        node->parent->red = 0;
+        uncle->red = 0;
+        grandparent->red = 1;
+        node = grandparent;
+      } else {
+        if (node == node->parent->right) {
+          node = node->parent;
+          rotate_left(root, node);
+        }
+        node->parent->red = 0;
+        grandparent->red = 1;
+        rotate_right(root, grandparent);
+      }
+    } else {
+      sf_tree_node *uncle = grandparent->left;
+      if (is_red(uncle)) {
+        node->parent->red = 0;
+        uncle->red = 0;
+        grandparent->red = 1;
+        node = grandparent;
+      } else {
+        if (node == node->parent->left) {
+          node = node->parent;
+          rotate_right(root, node);
+        }
+        node->parent->red = 0;
+        grandparent->red = 1;
+        rotate_left(root, grandparent);
+      }
+    }
+  }
+  (*root)->red = 0;
+  return 0;
+}
+
+/*
+ * Replace the subtree rooted at u with the subtree rooted at v.
+ */
+static void transplant(sf_tree_node **root, sf_tree_node *u, sf_tree_node *v) {
+  if (u->parent == NULL) {
+    *root = v;
+  } else if (u == u->parent->left) {
+    u->parent->left = v;
+  } else {
+    u->parent->right = v;
+  }
+  if (v != NULL) v->parent = u->parent;
+}
+
+static sf_tree_node *tree_min(sf_tree_node *node) {
+  while (node->left != NULL) node = node->left;
+  return node;
+}
+
+/*
+ * Remove a free block from the tree of a size class.
+ * Returns 0 if successful.
+ */
+int free_tree_remove(int index, sf_block *block) {
+  sf_tree_node **root = &sf_free_tree_roots[index];
+  sf_tree_node *node = (sf_tree_node *)block;
+  sf_tree_node *x;
+  sf_tree_node *x_parent;
+  int removed_red = node->red;
+  if (node->left == NULL) {
+    x = node->right;
+    x_parent = node->parent;
+    transplant(root, node, node->right);
+  } else if (node->right == NULL) {
+    x = node->left;
+    x_parent = node->parent;
+    transplant(root, node, node->left);
+  } else {
+    // replace the node with its in-order successor
+    sf_tree_node *y = tree_min(node->right);
+    removed_red = y->red;
+    x = y->right;
+    if (y->parent == node) {
+      x_parent = y;
+    } else {
+      x_parent = y->parent;
+      transplant(root, y, y->right);
+      y->right = node->right;
+      y->right->parent = y;
+    }
+    transplant(root, node, y);
+    y->left = node->left;
+    y->left->parent = y;
+    y->red = node->red;
+  }
+  if (!removed_red) {
+    // restore the red-black properties
+    while (x != *root && !is_red(x)) {
+      if (x == x_parent->left) {
+        sf_tree_node *w = x_parent->right;
+        if (is_red(w)) {
+          w->red = 0;
+          x_parent->red = 1;
+          rotate_left(root, x_parent);
+          w = x_parent->right;
+        }
+        if (!is_red(w->left) && !is_red(w->right)) {
+          w->red = 1;
+          x = x_parent;
+          x_parent = x->parent;
+        } else {
+          if (!is_red(w->right)) {
+            w->left->red = 0;
+            w->red = 1;
+            rotate_right(root, w);
+            w = x_parent->right;
+          }
+          w->red = x_parent->red;
+          x_parent->red = 0;
+          w->right->red = 0;
+          rotate_left(root, x_parent);
+          x = *root;
+        }
+      } else {
+        sf_tree_node *w = x_parent->left;
+        if (is_red(w)) {
+          w->red = 0;
+          x_parent->red = 1;
+          rotate_right(root, x_parent);
+          w = x_parent->left;
+        }
+        if (!is_red(w->left) && !is_red(w->right)) {
+          w->red = 1;
+          x = x_parent;
+          x_parent = x->parent;
+        } else {
+          if (!is_red(w->left)) {
+            w->right->red = 0;
+            w->red = 1;
+            rotate_left(root, w);
+            w = x_parent->left;
+          }
+          w->red = x_parent->red;
+          x_parent->red = 0;
+          w->left->red = 0;
+          rotate_right(root, x_parent);
+          x = *root;
+        }
+      }
+    }
+    if (x != NULL) x->red = 0;
+  }
+  node->left = NULL;
+  node->right = NULL;
+  node->parent = NULL;
+  return 0;
+}
+
+/*
+ * Get the in-order successor of a block in its tree.
+ * Returns NULL if the block is the largest in its tree.
+ */
+sf_block *free_tree_next(sf_block *block) {
+  sf_tree_node *node = (sf_tree_node *)block;
+  if (node->right != NULL) {
+    return (sf_block *)tree_min(node->right);
+  }
+  while (node->parent != NULL && node == node->parent->right) {
+    node = node->parent;
+  }
+  return (sf_block *)node->parent;
+}
+
+/*
+ * Find the smallest block of at least size bytes in the tree of a size
+ * class, preferring the lowest address among blocks of equal size.
+ * Returns NULL if there is no such block.
+ */
+sf_block *free_tree_lower_bound(int index, size_t size) {
+  sf_tree_node *cur = sf_free_tree_roots[index];
+  sf_tree_node *best = NULL;
+  while (cur != NULL) {
+    if (get_block_size((sf_block *)cur) >= size) {
+      best = cur;
+      cur = cur->left;
+    } else {
+      cur = cur->right;
+    }
+  }
+  return (sf_block *)best;
+}
+
+/*
+ * Find the smallest block of at least size bytes in any of the free trees.
+ * Returns NULL if there is no such block.
+ */
+sf_block *free_tree_best_fit(size_t size) {
+  int index = get_free_list_index(size);
+  if (index < FREE_TREE_MIN_INDEX) {
+    index = FREE_TREE_MIN_INDEX;
+  }
+  for (; index < NUM_FREE_LISTS; index++) {
+    sf_block *block = free_tree_lower_bound(index, size);
+    if (block != NULL) {
+      return block;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,111 @@
+#include "heap.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "counters.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+
+sf_growth_policy sf_growth = SF_GROW_EXACT;
+size_t sf_growth_chunk = 0;
+
+/*
+ * Set the heap growth policy.
+ * chunk_size is only used by SF_GROW_CHUNK and must be nonzero for it.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if unsuccessful.
+ */
+int sf_set_growth_policy(sf_growth_policy policy, size_t chunk_size) {
+  if (policy != SF_GROW_EXACT && policy != SF_GROW_GEOMETRIC &&
+      policy != SF_GROW_CHUNK) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  if (policy == SF_GROW_CHUNK && chunk_size == 0) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  sf_growth = policy;
+  sf_growth_chunk = chunk_size;
+  return 0;
+}
+
+/*
+ * Calculate the number of pages to grow the heap by, when needed more bytes
+ * of free space are required at the end of the heap.
+ */
+size_t calc_growth_pages(size_t needed) {
+  size_t pages = (needed + PAGE_SZ - 1) / PAGE_SZ;
+  size_t policy_pages = 0;
+  if (sf_growth == SF_GROW_GEOMETRIC) {
+    policy_pages = (heap_end() - heap_start()) / PAGE_SZ;
+  } else if (sf_growth == SF_GROW_CHUNK) {
+    policy_pages = (sf_growth_chunk + PAGE_SZ - 1) / PAGE_SZ;
+  }
+  return (policy_pages > pages) ? policy_pages : pages;
+}
+
+/*
+ * Grow the heap in a single step so that a block of size bytes fits at its
+ * end, and carve that block out of the wilderness.
+ * The block is returned free and unlinked, any remainder is put in the free
+ * lists.
+ * Returns NULL if the heap could not grow enough, in which case whatever
+ * memory was obtained is left in the free lists.
+ */
+sf_block *grow_heap(size_t size) {
+  // get pointer for epilogue
+  sf_block *epilogue_pntr = heap_end() - HEADER_SIZE;
+  int epilogue_prev_alloc = get_prev_alloc_bit(epilogue_pntr);
+  // the wilderness block already covers part of the request
+  size_t available = 0;
+  if (epilogue_prev_alloc == 0) {
+    sf_block *wilderness = get_prev_block(epilogue_pntr);
+    available = get_block_size(wilderness);
+    if (available >= size) {
+      // the free list search gave up before reaching the wilderness
+      remove_exact_block_free_list(wilderness);
+      sf_block *remainder = split_free_block(wilderness, size);
+      if (remainder != NULL) {
+        insert_free_list(remainder);
+      }
+      return wilderness;
+    }
+  }
+  size_t pages = calc_growth_pages(size - available);
+  size_t needed_pages = (size - available + PAGE_SZ - 1) / PAGE_SZ;
+  SF_COUNT(SF_EV_GROW, size);
+  size_t grown = heap_grow(pages);
+  if (grown == 0) {
+    return NULL;
+  }
+  // write new epilogue
+  sf_block *new_epilogue_pntr = heap_end() - HEADER_SIZE;
+  write_block_header(new_epilogue_pntr, 0, 0, 0, 1);
+  // change old epilogue to head of a free block, don't subtract header size
+  // because the old epilogue is part of the new block
+  write_free_block(epilogue_pntr, grown * PAGE_SZ, 0, epilogue_prev_alloc, 0,
+                   0, 0);
+  sf_block *block = coallesce(epilogue_pntr);
+  if (epilogue_prev_alloc == 0) {
+    // the old footer and epilogue are inside the block now, clear them so
+    // that fresh memory reads as zero past them (see zero.h)
+    memset((char *)epilogue_pntr - FOOTER_SIZE, 0, FOOTER_SIZE + HEADER_SIZE);
+  }
+  if (grown < needed_pages) {
+    // keep what was grown for later requests
+    insert_free_list(block);
+    return NULL;
+  }
+  sf_block *remainder = split_free_block(block, size);
+  if (remainder != NULL) {
+    insert_free_list(remainder);
+  }
+  return block;
+}
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include "huge.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+
+#define HUGE_TABLE_TOMBSTONE ((sf_block *)1)
+
+size_t sf_huge_threshold = SF_HUGE_THRESHOLD_DEFAULT;
+
+/*
+ * Open addressing hash table of the live huge blocks, shared by all arenas.
+ */
+static pthread_mutex_t huge_table_lock = PTHREAD_MUTEX_INITIALIZER;
+static sf_block **huge_table;
+static size_t huge_table_slots;
+static size_t huge_table_used;  // live entries and tombstones
+
+static size_t huge_blocks;  // live huge blocks
+static size_t huge_bytes;   // bytes of their mappings
+
+/*
+ * Set the size from which requests get their own mapping.
+ * A threshold of 0 turns huge allocations off.
+ * Returns 0 if successful.
+ */
+int sf_set_huge_threshold(size_t threshold) {
+  sf_huge_threshold = threshold;
+  return 0;
+}
+
+/*
+ * Is a request of size bytes served by its own mapping?
+ */
+int is_huge_request(size_t size) {
+  return sf_huge_threshold != 0 && size >= sf_huge_threshold;
+}
+
+static size_t huge_hash(sf_block *block) {
+  uintptr_t key = (uintptr_t)block >> 4;
+  key ^= key >> 17;
+  key *= 0x9e3779b97f4a7c15UL;
+  return key ^ (key >> 29);
+}
+
+/*
+ * Find the slot of a block, or the slot it would be inserted at. The probe
+ * stops after a full round, so a table without empty slots still ends, at
+ * a tombstone or NULL if there is none. Live entries never fill more than
+ * half the table, so there is always a slot to insert at.
+ */
+static sf_block **huge_table_find(sf_block *block) {
+  size_t mask = huge_table_slots - 1;
+  sf_block **insert_at = NULL;
+  size_t i = huge_hash(block) & mask;
+  for (size_t probes = 0; probes < huge_table_slots;
+       probes++, i = (i + 1) & mask) {
+    sf_block *entry = huge_table[i];
+    if (entry == block) {
+      return &huge_table[i];
+    }
+    if (entry == HUGE_TABLE_TOMBSTONE && insert_at == NULL) {
+      insert_at = &huge_table[i];
+    }
+    if (entry == NULL) {
+      return (insert_at != NULL) ? insert_at : &huge_table[i];
+    }
+  }
+  return insert_at;
+}
+
+/*
+ * Rebuild the table with room for at least twice the live entries.
+ * Returns 0 if successful, -1 otherwise.
+ */
+static int huge_table_resize(size_t live) {
+  size_t slots = HUGE_TABLE_MIN_SLOTS;
+  while (slots < 4 * live) slots *= 2;
+  sf_block **table = mmap(NULL, slots * sizeof(sf_block *),
+                          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+  if (table == MAP_FAILED) {
+    return -1;
+  }
+  sf_block **old_table = huge_table;
+  size_t old_slots = huge_table_slots;
+  huge_table = table;
+  huge_table_slots = slots;
+  huge_table_used = 0;
+  for (size_t i = 0; i < old_slots; i++) {
+    if (old_table[i] != NULL && old_table[i] != HUGE_TABLE_TOMBSTONE) {
+      *huge_table_find(old_table[i]) = old_table[i];
+      huge_table_used++;
+    }
+  }
+  if (old_table != NULL) {
+    munmap(old_table, old_slots * sizeof(sf_block *));
+  }
+  return 0;
+}
+
+static int huge_table_insert(sf_block *block) {
+  pthread_mutex_lock(&huge_table_lock);
+  if (2 * (huge_table_used + 1) > huge_table_slots) {
+    if (huge_table_resize(huge_table_used + 1) != 0) {
+      pthread_mutex_unlock(&huge_table_lock);
+      return -1;
+    }
+  }
+  sf_block **slot = huge_table_find(block);
+  if (*slot == NULL) huge_table_used++;
+  *slot = block;
+  pthread_mutex_unlock(&huge_table_lock);
+  return 0;
+}
+
+/*
+ * Replace the entry of a block that moved. The old entry becomes a
+ * tombstone, so the table is rebuilt as on an insert once live entries and
+ * tombstones fill half of it. If it can not be rebuilt, the new entry may
+ * take the old one's tombstone.
+ */
+static void huge_table_move(sf_block *old_block, sf_block *block) {
+  pthread_mutex_lock(&huge_table_lock);
+  sf_block **slot = huge_table_find(old_block);
+  if (slot != NULL && *slot == old_block) {
+    *slot = HUGE_TABLE_TOMBSTONE;
+  }
+  if (2 * (huge_table_used + 1) > huge_table_slots) {
+    huge_table_resize(huge_table_used + 1);
+  }
+  slot = huge_table_find(block);
+  if (*slot == NULL) huge_table_used++;
+  *slot = block;
+  pthread_mutex_unlock(&huge_table_lock);
+}
+
+static void huge_table_remove(sf_block *block) {
+  pthread_mutex_lock(&huge_table_lock);
+  sf_block **slot = huge_table_find(block);
+  if (slot != NULL && *slot == block) {
+    *slot = HUGE_TABLE_TOMBSTONE;
+  }
+  pthread_mutex_unlock(&huge_table_lock);
+}
+
+/*
+ * The prefix sits right below the 8-byte boundary at or before the header.
+ */
+static sf_huge_prefix *huge_prefix(sf_block *block) {
+  return (sf_huge_prefix *)((uintptr_t)block & ~(uintptr_t)7) - 1;
+}
+
+/*
+ * Is pp the payload of a live huge block?
+ * Pointers inside the heap of any arena are never huge, nor is anything in
+ * the address space reserved for arenas 1 and up, so those are rejected
+ * without taking the table lock. A free to another arena stays lock free.
+ */
+int is_huge_pointer(void *pp) {
+  if (__atomic_load_n(&huge_table, __ATOMIC_RELAXED) == NULL) {
+    return 0;
+  }
+  sf_arena *owner = arena_of(pp);
+  if (owner->index != 0 ||
+      (pp >= arena_heap_start(owner) && pp < arena_heap_end(owner))) {
+    return 0;
+  }
+  sf_block *block = get_sf_block(pp);
+  pthread_mutex_lock(&huge_table_lock);
+  sf_block **slot = huge_table_find(block);
+  int found = (slot != NULL && *slot == block);
+  pthread_mutex_unlock(&huge_table_lock);
+  if (!found) {
+    return 0;
+  }
+  return (BLOCK_HEADER(block) & 0x7) == HUGE_BLOCK_MARKER;
+}
+
+/*
+ * Map a huge block with a payload of at least size bytes, aligned to align
+ * bytes (at least 16).
+ * Returns the payload, or NULL with sf_errno set to ENOMEM.
+ */
+void *huge_malloc(size_t size, size_t align) {
+  if (align < 16) align = 16;
+  size_t offset = sizeof(sf_huge_prefix) + 8;
+  // page aligned mappings already satisfy smaller alignments
+  size_t slack = (align > PAGE_SZ) ? align - PAGE_SZ : 0;
+  if (size > SIZE_MAX - offset - align - slack - PAGE_SZ) {
+    sf_errno = ENOMEM;
+    return NULL;
+  }
+  size_t map_size = (offset + align + slack + size + PAGE_SZ - 1) & ~(PAGE_SZ - 1);
+  char *base = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    sf_errno = ENOMEM;
+    return NULL;
+  }
+  uintptr_t payload = ((uintptr_t)base + offset + align - 1) & ~(align - 1);
+  sf_block *block = get_sf_block((void *)payload);
+  sf_huge_prefix *prefix = huge_prefix(block);
+  prefix->base = base;
+  prefix->map_size = map_size;
+  prefix->align = align;
+  BLOCK_HEADER(block) = (base + map_size - (char *)block) | HUGE_BLOCK_MARKER;
+  if (huge_table_insert(block) != 0) {
+    munmap(base, map_size);
+    sf_errno = ENOMEM;
+    return NULL;
+  }
+  __atomic_add_fetch(&huge_blocks, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&huge_bytes, map_size, __ATOMIC_RELAXED);
+  return (void *)payload;
+}
+
+/*
+ * Unmap a huge block.
+ */
+void huge_free(void *pp) {
+  sf_block *block = get_sf_block(pp);
+  sf_huge_prefix *prefix = huge_prefix(block);
+  huge_table_remove(block);
+  __atomic_sub_fetch(&huge_blocks, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&huge_bytes, prefix->map_size, __ATOMIC_RELAXED);
+  munmap(prefix->base, prefix->map_size);
+}
+
+/*
+ * Usable payload size of a huge block.
+ */
+size_t huge_usable_size(void *pp) {
+  sf_huge_prefix *prefix = huge_prefix(get_sf_block(pp));
+  return (char *)prefix->base + prefix->map_size - (char *)pp;
+}
+
+/*
+ * Resize a huge block. A block that stays huge is resized by remapping its
+ * pages, which only moves page table entries, a block that becomes small
+ * enough for the heap is copied there.
+ * Returns the new payload, or NULL with the old block left intact.
+ */
+void *huge_realloc(void *pp, size_t rsize) {
+  if (!is_huge_request(rsize)) {
+    void *new_pp = heap_malloc(rsize);
+    if (new_pp == NULL) {
+      return NULL;
+    }
+    size_t usable = huge_usable_size(pp);
+    memcpy(new_pp, pp, (rsize < usable) ? rsize : usable);
+    huge_free(pp);
+    return new_pp;
+  }
+  sf_block *old_block = get_sf_block(pp);
+  sf_huge_prefix *prefix = huge_prefix(old_block);
+  char *old_base = prefix->base;
+  size_t offset = (char *)pp - old_base;
+  if (rsize > SIZE_MAX - offset - PAGE_SZ) {
+    sf_errno = ENOMEM;
+    return NULL;
+  }
+  size_t map_size = (offset + rsize + PAGE_SZ - 1) & ~(PAGE_SZ - 1);
+  if (map_size == prefix->map_size) {
+    return pp;
+  }
+  // a moved mapping keeps page alignment, larger alignments must grow in
+  // place
+  int flags = (prefix->align <= PAGE_SZ) ? MREMAP_MAYMOVE : 0;
+  size_t old_map_size = prefix->map_size;
+  char *base = mremap(old_base, old_map_size, map_size, flags);
+  if (base == MAP_FAILED) {
+    if (flags == MREMAP_MAYMOVE) {
+      sf_errno = ENOMEM;
+      return NULL;
+    }
+    void *new_pp = huge_malloc(rsize, prefix->align);
+    if (new_pp == NULL) {
+      return NULL;
+    }
+    memcpy(new_pp, pp, huge_usable_size(pp));
+    huge_free(pp);
+    return new_pp;
+  }
+  __atomic_add_fetch(&huge_bytes, map_size - old_map_size, __ATOMIC_RELAXED);
+  sf_block *block = (sf_block *)(base + ((char *)old_block - old_base));
+  prefix = huge_prefix(block);
+  prefix->base = base;
+  prefix->map_size = map_size;
+  BLOCK_HEADER(block) = (base + map_size - (char *)block) | HUGE_BLOCK_MARKER;
+  if (base != old_base) {
+    huge_table_move(old_block, block);
+  }
+  return base + offset;
+}
+
+/*
+ * Store the number of live huge blocks and the bytes of their mappings.
+ */
+void huge_stats(size_t *blocks, size_t *bytes) {
+  *blocks = __atomic_load_n(&huge_blocks, __ATOMIC_RELAXED);
+  *bytes = __atomic_load_n(&huge_bytes, __ATOMIC_RELAXED);
+}
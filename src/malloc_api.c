@@ -0,0 +1,94 @@
+/*
+ * Standard allocation functions
+ *
+ * libsfmm.so and libsfmm.a are the allocator plus this file, which defines
+ * the allocation functions of the C library as the std_* functions of
+ * std_api.h, so an unmodified program runs on sfmm with
+ *
+ *   LD_PRELOAD=bin/libsfmm.so ./program
+ *
+ * It is left out of bin/sfmm and bin/sfmm_tests, which keep the malloc of
+ * the C library.
+ *
+ * Bootstrap:
+ * - Nothing here calls the allocator of the C library or looks it up with
+ *   dlsym(), so the allocations the dynamic linker and dlsym() make before
+ *   main() have nothing to recurse into.
+ * - sfutil.o is not position independent and takes its region from
+ *   malloc(), so the libraries are built without it (-DSF_NO_SFUTIL) and
+ *   the first call switches arena 0 to the mmap provider before its heap is
+ *   initialized. pthread_once() does not allocate.
+ * - Failures set errno as the C library does. Payloads are 16 byte
+ *   aligned, see std_api.h.
+ *
+ * If SFMM_TRACE names a file when the library is loaded, every call is
+ * recorded to it until the program exits (see trace.h). If SFMM_COUNTERS
+ * is set in a build with SF_COUNTERS, the hot path event counters are
+ * written to stderr when the program exits (see counters.h).
+ */
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "counters.h"
+#include "sfmm.h"
+#include "std_api.h"
+#include "trace.h"
+
+static void api_trace_stop() { sf_trace_stop(); }
+
+__attribute__((constructor)) static void api_trace_start() {
+  const char *path = getenv("SFMM_TRACE");
+  if (path == NULL || *path == '\0') {
+    return;
+  }
+  std_init();
+  if (sf_trace_start(path) == 0) {
+    atexit(api_trace_stop);
+  }
+}
+
+static void api_counters_dump() { sf_dump_counters(STDERR_FILENO); }
+
+__attribute__((constructor)) static void api_counters_start() {
+  const char *dump = getenv("SFMM_COUNTERS");
+  if (dump != NULL && *dump != '\0') {
+    atexit(api_counters_dump);
+  }
+}
+
+void *malloc(size_t size) { return std_malloc(size); }
+
+void free(void *pp) { std_free(pp); }
+
+void *calloc(size_t nmemb, size_t size) { return std_calloc(nmemb, size); }
+
+void *realloc(void *pp, size_t size) { return std_realloc(pp, size); }
+
+void *reallocarray(void *pp, size_t nmemb, size_t size) {
+  return std_reallocarray(pp, nmemb, size);
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size) {
+  return std_posix_memalign(memptr, align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+  return std_aligned_alloc(align, size);
+}
+
+void *memalign(size_t align, size_t size) { return std_memalign(align, size); }
+
+void *valloc(size_t size) { return std_valloc(size); }
+
+void *pvalloc(size_t size) { return std_pvalloc(size); }
+
+/*
+ * The sized forms of the C++ operator delete and operator delete[], under
+ * their mangled names, so that no C++ compiler is needed to build them.
+ */
+void _ZdlPvm(void *pp, size_t size) { std_free_sized(pp, size); }
+
+void _ZdaPvm(void *pp, size_t size) { std_free_sized(pp, size); }
+
+size_t malloc_usable_size(void *pp) { return std_malloc_usable_size(pp); }
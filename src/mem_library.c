@@ -1,31 +1,63 @@
 #include "mem_library.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "counters.h"
 #include "debug.h"
+#include "free_tree.h"
+#include "heap.h"
+#include "huge.h"
+#include "page_provider.h"
+#include "purge.h"
 #include "sfmm.h"
+#include "stats.h"
+#include "tlsf.h"
+
+size_t sf_min_align = 8;
+
+/*
+ * Set the alignment of every payload the heap hands out, 8 or 16 bytes.
+ * Block sizes become multiples of it and the prologue is padded so that the
+ * first payload is aligned, which keeps every later payload aligned.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if the heap is already in use or
+ * align is neither 8 nor 16.
+ */
+int sf_set_min_alignment(size_t align) {
+  if (heap_start() != heap_end()) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  if (align != 8 && align != 16) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  sf_min_align = align;
+  return 0;
+}
 
 /*
  * Calculate the size of the block to be allocated.
  */
 size_t calc_malloc_block_size(size_t size) {
   // add size, headersize, footersize, next/prev pointers (free), padding to
-  // make it a multiple of 8
+  // make it a multiple of the alignment
   size_t blocksize = size;
   // header size 4 block space, 1 in quicklist, 1 prev alloc, 1 alloc
-  blocksize += 8;
+  blocksize += HEADER_SIZE;
   // don't allocate space for footer because we can use the payload area instead
   if (size < MIN_PAYLOAD_SIZE) {
     blocksize += MIN_PAYLOAD_SIZE - size;
   }
-  if (blocksize % 8 != 0) {
-    blocksize += 8 - (blocksize % 8);
+  if (blocksize % sf_min_align != 0) {
+    blocksize += sf_min_align - (blocksize % sf_min_align);
   }
-  // minimum block size is 32
-  if (blocksize < 32) {
-    blocksize = 32;
+  // enforce the minimum block size
+  if (blocksize < MIN_BLOCK_SIZE) {
+    blocksize = MIN_BLOCK_SIZE;
   }
   return blocksize;
 }
@@ -40,22 +72,22 @@ sf_block *write_block_header(sf_block *block, size_t size, int quicklist,
   set_block_size(block, size);
   // set in quick list to 1
   if (quicklist != 0) {
-    block->header |= 0x4;
+    BLOCK_HEADER(block) |= 0x4;
   } else {
-    block->header &= ~0x4;
+    BLOCK_HEADER(block) &= ~0x4;
   }
 
   // set the prev allocated bit to 1
   if (prev_alloc != 0) {
-    block->header |= 0x2;
+    BLOCK_HEADER(block) |= 0x2;
   } else {
-    block->header &= ~0x2;
+    BLOCK_HEADER(block) &= ~0x2;
   }
   // set the allocated bit to 1
   if (alloc != 0) {
-    block->header |= 0x1;
+    BLOCK_HEADER(block) |= 0x1;
   } else {
-    block->header &= ~0x1;
+    BLOCK_HEADER(block) &= ~0x1;
   }
 
   // if block is free write footer
@@ -71,6 +103,9 @@ sf_block *write_block_header(sf_block *block, size_t size, int quicklist,
  */
 sf_block *alloc_block(sf_block *block, size_t size, int prev_alloc) {
   write_block_header(block, size, 0, prev_alloc, 1);
+  if ((char *)get_block_end(block) > sf_arena_cur->zero_from) {
+    zero_note_alloc(block);
+  }
   set_prev_alloc_bit(get_block_end(block), 1);
   // remove footer
   remove_footer(block);
@@ -82,7 +117,7 @@ sf_block *alloc_block(sf_block *block, size_t size, int prev_alloc) {
 int set_block_size(sf_block *block, size_t size) {
   // write header
   // write the block size with 3 lsb's implicitly 0
-  block->header = size & ~0x7;
+  BLOCK_HEADER(block) = size & ~0x7;
   return 0;
 }
 /*
@@ -91,7 +126,7 @@ int set_block_size(sf_block *block, size_t size) {
 size_t get_block_size(sf_block *block) {
   // read header
   // read the block size with 3 lsb's implicitly 0
-  return block->header & ~0x7;
+  return BLOCK_HEADER(block) & ~0x7;
 }
 /*
  * Set quick list bit
@@ -100,11 +135,11 @@ int set_quick_list_bit(sf_block *block, int bit) {
   // write header
   // set in quick list to 0 or 1
   if (bit == 0) {
-    block->header &= ~0x4;
+    BLOCK_HEADER(block) &= ~0x4;
     if (get_alloc_bit(block) == 0)  // if not quicklist and not allocated
       write_block_footer(block);    // update block footer
   } else {
-    block->header |= 0x4;
+    BLOCK_HEADER(block) |= 0x4;
     remove_footer(block);  // remove footer (quicklist block has no footer)
   }
   // quicklist block has no footer
@@ -116,7 +151,7 @@ int set_quick_list_bit(sf_block *block, int bit) {
 int get_quick_list_bit(sf_block *block) {
   // read header
   // read in quick list to 0 or 1
-  return ((block->header & 0x4) == 0) ? 0 : 1;
+  return ((BLOCK_HEADER(block) & 0x4) == 0) ? 0 : 1;
 }
 /*
  * Get prev allocated bit
@@ -124,7 +159,7 @@ int get_quick_list_bit(sf_block *block) {
 int get_prev_alloc_bit(sf_block *block) {
   // read header
   // read the prev allocated bit to 0 or 1
-  return ((block->header & 0x2) == 0) ? 0 : 1;
+  return ((BLOCK_HEADER(block) & 0x2) == 0) ? 0 : 1;
 }
 /*
  * Set prev allocated bit
@@ -133,9 +168,9 @@ int set_prev_alloc_bit(sf_block *block, int bit) {
   // write header
   // set the prev allocated bit to 0 or 1
   if (bit == 0) {
-    block->header &= ~0x2;
+    BLOCK_HEADER(block) &= ~0x2;
   } else {
-    block->header |= 0x2;
+    BLOCK_HEADER(block) |= 0x2;
   }
   // if not alloc or quicklist, update footer
   if (get_alloc_bit(block) == 0 && get_quick_list_bit(block) == 0) {
@@ -149,7 +184,7 @@ int set_prev_alloc_bit(sf_block *block, int bit) {
 int get_alloc_bit(sf_block *block) {
   // read header
   // read the allocated bit to 0 or 1
-  return ((block->header & 0x1) == 0) ? 0 : 1;
+  return ((BLOCK_HEADER(block) & 0x1) == 0) ? 0 : 1;
 }
 /*
  * Set allocated bit
@@ -158,12 +193,12 @@ int set_alloc_bit(sf_block *block, int bit) {
   // write header
   // set the allocated bit to 0 or 1
   if (bit == 0) {
-    block->header &= ~0x1;
+    BLOCK_HEADER(block) &= ~0x1;
     // write footer if not allocated
     if (get_quick_list_bit(block) == 0)  // if not quicklist and not allocated
       write_block_footer(block);
   } else {
-    block->header |= 0x1;
+    BLOCK_HEADER(block) |= 0x1;
     remove_footer(block);  // remove footer (allocated block has no footer)
   }
   return 0;
@@ -179,8 +214,8 @@ sf_block *write_free_block(sf_block *block, size_t size, int quicklist,
   // write header
   write_block_header(block, size, quicklist, prev_alloc, alloc);
   // set next and prev pointers
-  block->body.links.next = next;
-  block->body.links.prev = prev;
+  set_block_next(block, next);
+  set_block_prev(block, prev);
   // clone header to footer:
   write_block_footer(block);
   // write padding
@@ -192,7 +227,7 @@ sf_block *write_free_block(sf_block *block, size_t size, int quicklist,
  */
 int set_next_pntr(sf_block block, sf_block *next) {
   // write next pointer
-  block.body.links.next = next;
+  set_block_next(&block, next);
   return 0;
 }
 /*
@@ -200,22 +235,22 @@ int set_next_pntr(sf_block block, sf_block *next) {
  */
 int set_prev_pntr(sf_block block, sf_block *prev) {
   // write prev pointer
-  block.body.links.prev = prev;
+  set_block_prev(&block, prev);
   return 0;
 }
 
 /*
  * Write block footer
  */
-sf_footer *write_block_footer(sf_block *block) {
+sf_word *write_block_footer(sf_block *block) {
   // write footer
   // read size from header
   size_t size = get_block_size(block);
   // clone header to footer:
   // compute the address of the footer
-  sf_footer *footer = (sf_footer *)((void *)block + size - sizeof(sf_footer));
+  sf_word *footer = (sf_word *)((void *)block + size - FOOTER_SIZE);
   // debug("footer address: %p", footer);
-  *footer = (sf_footer)block->header;
+  *footer = (sf_word)BLOCK_HEADER(block);
   return footer;
 }
 /*
@@ -242,13 +277,14 @@ sf_block *split_free_block(sf_block *block, size_t size) {
   // sf_show_block(block);
   int prev_alloc = get_prev_alloc_bit(block);
   // get size
-  int block_size = get_block_size(block) - size;
-  if (block_size < MIN_BLOCK_SIZE) {
+  size_t block_size = get_block_size(block);
+  if (block_size < size + MIN_BLOCK_SIZE) {
     return NULL;
   }
   if (size < MIN_BLOCK_SIZE) {
     return NULL;
   }
+  block_size -= size;
   // split block by writing header after new block size (smaller block)
   // since head of split block, set prev_alloc to whatever it was on current
   // block
@@ -271,13 +307,14 @@ sf_block *split_block(sf_block *block, size_t size) {
   // sf_show_block(block);
   int prev_alloc = get_prev_alloc_bit(block);
   // get size
-  int block_size = get_block_size(block) - size;
-  if (block_size < MIN_BLOCK_SIZE) {
+  size_t block_size = get_block_size(block);
+  if (block_size < size + MIN_BLOCK_SIZE) {
     return NULL;
   }
   if (size < MIN_BLOCK_SIZE) {
     return NULL;
   }
+  block_size -= size;
   int alloc = get_alloc_bit(block);
   int quicklist = get_quick_list_bit(block);
   // split block by writing header after new block size (smaller block)
@@ -311,7 +348,7 @@ int remove_footer(sf_block *block) {
   // get size
   size_t size = get_block_size(block);
   // compute the address of the footer
-  sf_footer *footer = (sf_footer *)((void *)block + size - sizeof(sf_footer));
+  sf_word *footer = (sf_word *)((void *)block + size - FOOTER_SIZE);
   *footer = 0x0;
   return 0;
 }
@@ -326,11 +363,56 @@ int init_free_lists() {
   // every free list has a dummy block as the head of the respective doubly
   // linked list
   for (int i = 0; i < NUM_FREE_LISTS; i++) {
-    sf_free_list_heads[i].body.links.next = &sf_free_list_heads[i];
-    sf_free_list_heads[i].body.links.prev = &sf_free_list_heads[i];
+    set_block_next(&sf_free_list_heads[i], &sf_free_list_heads[i]);
+    set_block_prev(&sf_free_list_heads[i], &sf_free_list_heads[i]);
+  }
+  init_free_trees();
+#ifdef SF_COMPACT_HEADERS
+  sf_arena_cur->link_base = (char *)heap_start() - SF_LINK_HEAD_LIMIT;
+#endif
+  if (sf_engine == SF_TLSF) {
+    return tlsf_init();
   }
   return 0;
 }
+
+#ifdef SF_COMPACT_HEADERS
+/*
+ * Encode a pointer to a block or dummy list head of the current arena as a
+ * 32-bit link, see block_layout.h.
+ */
+sf_link link_encode(sf_block *block) {
+  if (block == NULL) {
+    return 0;
+  }
+  uintptr_t offset = (uintptr_t)block - (uintptr_t)sf_free_list_heads;
+  if (offset < NUM_FREE_LISTS * sizeof(sf_block)) {
+    return 1 + offset / sizeof(sf_block);
+  }
+  offset = (uintptr_t)block - (uintptr_t)sf_tlsf_heads;
+  if (offset < sizeof(sf_tlsf_heads)) {
+    return 1 + NUM_FREE_LISTS + offset / sizeof(sf_block);
+  }
+  return (char *)block - sf_arena_cur->link_base;
+}
+
+/*
+ * Decode a 32-bit link of the current arena.
+ */
+sf_block *link_decode(sf_link link) {
+  if (link >= SF_LINK_HEAD_LIMIT) {
+    return (sf_block *)(sf_arena_cur->link_base + link);
+  }
+  if (link == 0) {
+    return NULL;
+  }
+  if (link <= NUM_FREE_LISTS) {
+    return &sf_free_list_heads[link - 1];
+  }
+  link -= 1 + NUM_FREE_LISTS;
+  return &sf_tlsf_heads[link / TLSF_SL_COUNT][link % TLSF_SL_COUNT];
+}
+#endif /* SF_COMPACT_HEADERS */
 /*
  * Append a block to the free list.
  * Returns head of freelist if successful.
@@ -351,25 +433,43 @@ sf_block *append_free_list(sf_block *block) {
   if (potential_coalesce != NULL) {
     block = potential_coalesce;
   }
-
+  return insert_free_list(block);
+}
+/*
+ * Insert an already coalesced block into the free list.
+ * Returns head of freelist if successful.
+ */
+sf_block *insert_free_list(sf_block *block) {
+  purge_note_insert(block);
+  stats_note_insert(block);
+  if (sf_engine == SF_TLSF) {
+    return tlsf_insert(block);
+  }
   size_t size = get_block_size(block);
   // get the index of the free list
-  sf_block *dummy_pointer = get_free_list_head(size);
+  int index = get_free_list_index(size);
+  sf_block *dummy_pointer = &sf_free_list_heads[index];
   // get the first block in the free list
-  sf_block *next = dummy_pointer->body.links.next;
+  sf_block *next = block_next(dummy_pointer);
+  if (index >= FREE_TREE_MIN_INDEX) {
+    // large blocks go in front of their successor in the free tree
+    free_tree_insert(index, block);
+    next = free_tree_next(block);
+    if (next == NULL) next = dummy_pointer;
+  }
   // append by size order (smallest to largest)
   while (next != dummy_pointer && get_block_size(next) < size) {
     // debug("next: %p", next);
     // debug("block: %p", block);
     // debug("dummy_pointer: %p", dummy_pointer);
-    next = next->body.links.next;
+    next = block_next(next);
   }
 
   // append the block to the free list
-  block->body.links.next = next;
-  block->body.links.prev = next->body.links.prev;
-  next->body.links.prev->body.links.next = block;
-  next->body.links.prev = block;
+  set_block_next(block, next);
+  set_block_prev(block, block_prev(next));
+  set_block_next(block_prev(next), block);
+  set_block_prev(next, block);
   return dummy_pointer;
 }
 /*
@@ -378,6 +478,13 @@ sf_block *append_free_list(sf_block *block) {
  * Returns NULL if no block in the free list .
  */
 sf_block *remove_free_list(size_t size) {
+  if (sf_engine == SF_TLSF) {
+    return tlsf_remove_free_list(size);
+  }
+  // large requests are served from the free trees
+  if (get_free_list_index(size) >= FREE_TREE_MIN_INDEX) {
+    return remove_free_tree(size);
+  }
   // get the index of the free list
   sf_block *dummy_pointer = get_free_list_head(size);
   // get the first block in the free list
@@ -387,69 +494,117 @@ sf_block *remove_free_list(size_t size) {
     return NULL;
   }
 
-  sf_block *next = dummy_pointer->body.links.next;
+  sf_block *next = block_next(dummy_pointer);
   // iterate through the free list
   while (next != dummy_pointer) {
+    SF_COUNT(SF_EV_WALK, size);
     if (get_block_size(next) == size) {
       // remove the block from the free list
-      next->body.links.prev->body.links.next = next->body.links.next;
-      next->body.links.next->body.links.prev = next->body.links.prev;
+      stats_note_remove(next);
+      set_block_next(block_prev(next), block_next(next));
+      set_block_prev(block_next(next), block_prev(next));
+      SF_COUNT(SF_EV_EXACT_FIT, size);
       return next;
     }
-    next = next->body.links.next;
+    next = block_next(next);
   }
   // debug("did not find exact fit");
   // there is no block which is an exact fit
   // find a block of at least size+MIN_BLOCK_SIZE
   int current_list = get_free_list_index(size + MIN_BLOCK_SIZE);
   int current_list_backup = current_list;
-  while (current_list < NUM_FREE_LISTS) {
+  while (current_list < FREE_TREE_MIN_INDEX) {
     dummy_pointer = &sf_free_list_heads[current_list];
-    next = dummy_pointer->body.links.next;
+    next = block_next(dummy_pointer);
     while (next != dummy_pointer) {
+      SF_COUNT(SF_EV_WALK, size);
       // debug("blocksize, size: %d, %d", get_block_size(next),
       //       size + MIN_BLOCK_SIZE);
       if (get_block_size(next) >= size + MIN_BLOCK_SIZE) {
         // preserve next and prev pointers
-        sf_block *this_prev = next->body.links.prev;
-        sf_block *this_next = next->body.links.next;
+        sf_block *this_prev = block_prev(next);
+        sf_block *this_next = block_next(next);
         // remove the block from the free list
-        this_prev->body.links.next = this_next;
-        this_next->body.links.prev = this_prev;
+        stats_note_remove(next);
+        set_block_next(this_prev, this_next);
+        set_block_prev(this_next, this_prev);
         // split the block
         sf_block *block1 = split_free_block(next, size);
         // add the unwanted block to the free list
         append_free_list(block1);
         // debug("found suitable fit in list %d", current_list);
+        SF_COUNT(SF_EV_SPLIT, size);
         return next;
       }
-      next = next->body.links.next;
+      next = block_next(next);
     }
     // debug("did not find suitable fit in list %d", current_list);
     current_list++;
     // move to next free list
   }
+  next = free_tree_best_fit(size + MIN_BLOCK_SIZE);
+  if (next != NULL) {
+    remove_exact_block_free_list(next);
+    append_free_list(split_free_block(next, size));
+    SF_COUNT(SF_EV_SPLIT, size);
+    return next;
+  }
   debug("last ditch effort");
-  while (current_list_backup < NUM_FREE_LISTS) {
+  while (current_list_backup < FREE_TREE_MIN_INDEX) {
     dummy_pointer = &sf_free_list_heads[current_list_backup];
-    next = dummy_pointer->body.links.next;
+    next = block_next(dummy_pointer);
     while (next != dummy_pointer) {
+      SF_COUNT(SF_EV_WALK, size);
       // last ditch option, find a block of at least size and do not split
       if (get_block_size(next) >= size) {
         // preserve next and prev pointers
-        sf_block *this_prev = next->body.links.prev;
-        sf_block *this_next = next->body.links.next;
+        sf_block *this_prev = block_prev(next);
+        sf_block *this_next = block_next(next);
         // remove the block from the free list
-        this_prev->body.links.next = this_next;
-        this_next->body.links.prev = this_prev;
+        stats_note_remove(next);
+        set_block_next(this_prev, this_next);
+        set_block_prev(this_next, this_prev);
+        SF_COUNT(SF_EV_LAST_DITCH, size);
         return next;
       }
-      next = next->body.links.next;
+      next = block_next(next);
     }
     current_list_backup++;
   }
+  next = free_tree_best_fit(size);
+  if (next != NULL) {
+    remove_exact_block_free_list(next);
+    SF_COUNT(SF_EV_LAST_DITCH, size);
+  } else {
+    SF_COUNT(SF_EV_MISS, size);
+  }
+  return next;
+}
 
-  return NULL;
+/*
+ * Remove a block of at least size bytes from the free trees.
+ * The smallest block that fits is used, unless using it would leave a
+ * splinter and a block that can be split exists.
+ * Returns NULL if no block in the free trees.
+ */
+sf_block *remove_free_tree(size_t size) {
+  sf_block *block = free_tree_best_fit(size);
+  if (block == NULL) {
+    SF_COUNT(SF_EV_MISS, size);
+    return NULL;
+  }
+  size_t block_size = get_block_size(block);
+  if (block_size != size && block_size < size + MIN_BLOCK_SIZE) {
+    // last ditch, only use the block as is if nothing can be split
+    sf_block *splittable = free_tree_best_fit(size + MIN_BLOCK_SIZE);
+    if (splittable != NULL) {
+      block = splittable;
+    }
+  }
+  SF_COUNT_FIT(get_block_size(block), size);
+  remove_exact_block_free_list(block);
+  append_free_list(split_free_block(block, size));
+  return block;
 }
 
 /*
@@ -507,19 +662,50 @@ int get_quick_list_head(size_t size) {
 sf_block *convert_to_quicklist_block(sf_block *block) {
   // get size
   size_t size = get_block_size(block);
-  block->body.links.next = NULL;
+  set_block_next(block, NULL);
   set_quick_list_bit(block, 1);
   set_alloc_bit(block, 1);
   set_prev_alloc_bit(get_block_end(block), 1);
   // remove footer
-  sf_footer *footer = (sf_footer *)((void *)block + size - sizeof(sf_footer));
-  *footer = (sf_footer)0x0;
+  sf_word *footer = (sf_word *)((void *)block + size - FOOTER_SIZE);
+  *footer = (sf_word)0x0;
   return block;
 }
 
+/*
+ * Get the current depth (flush threshold) of a quick list
+ */
+int get_quick_list_depth(int quick_index) {
+  int depth = sf_quick_list_ctls[quick_index].depth;
+  return (depth == 0) ? QUICK_LIST_MAX : depth;
+}
+
+/*
+ * Adapt the depth of a quick list that is about to overflow.
+ * A list that served at least a full list worth of mallocs since its last
+ * overflow is hot and doubles its depth, a list that served none is cold and
+ * halves it.
+ * Returns the new depth.
+ */
+int adapt_quick_list_depth(int quick_index) {
+  sf_quick_list_ctl *ctl = &sf_quick_list_ctls[quick_index];
+  int depth = get_quick_list_depth(quick_index);
+  if (ctl->hits >= depth) {
+    depth *= 2;
+    if (depth > QUICK_LIST_MAX_DEPTH) depth = QUICK_LIST_MAX_DEPTH;
+  } else if (ctl->hits == 0) {
+    depth /= 2;
+    if (depth < QUICK_LIST_MIN_DEPTH) depth = QUICK_LIST_MIN_DEPTH;
+  }
+  ctl->depth = depth;
+  ctl->hits = 0;
+  return depth;
+}
+
 /*
  * Append to quicklist
- * Quicklist is a singly linked list using LIFO format
+ * Quicklist is a singly linked list using LIFO format, blocks are pushed onto
+ * the head of the list.
  * Returns 0 if successful.
  * Returns -1 if unsuccessful.
  */
@@ -529,28 +715,27 @@ int append_quicklist(sf_block *block) {
   if (quick_index == -1) {
     return -1;
   }
-  if (sf_quick_lists[quick_index].length >= QUICK_LIST_MAX) {
-    flush_quicklist(quick_index);
+  int length = sf_quick_lists[quick_index].length;
+  if (length >= get_quick_list_depth(quick_index)) {
+    int hot = sf_quick_list_ctls[quick_index].hits >=
+              get_quick_list_depth(quick_index);
+    // only flush if the list did not grow deep enough to hold the block
+    if (length >= adapt_quick_list_depth(quick_index)) {
+      if (hot) {
+        // a hot list at its maximum depth keeps its most recent half
+        flush_quicklist_batch(quick_index, length / 2);
+      } else {
+        flush_quicklist(quick_index);
+      }
+    }
   }
-  // append the block to the end of the quick list
-  sf_block *next = sf_quick_lists[quick_index].first;
   set_quick_list_bit(block, 1);
   set_alloc_bit(block, 1);
   set_prev_alloc_bit(get_block_end(block), 1);
-  if (next == NULL) {
-    sf_quick_lists[quick_index].first = block;
-    sf_quick_lists[quick_index].length++;
-    return 0;
-  }
-  while (next != NULL) {
-    sf_block *peek = next->body.links.next;
-    if (peek == NULL) {
-      next->body.links.next = block;
-      sf_quick_lists[quick_index].length++;
-      return 0;
-    }
-    next = next->body.links.next;
-  }
+  // push the block onto the head of the quick list
+  set_block_next(block, sf_quick_lists[quick_index].first);
+  sf_quick_lists[quick_index].first = block;
+  sf_quick_lists[quick_index].length++;
   return 0;
 }
 
@@ -564,75 +749,36 @@ sf_block *remove_quicklist(size_t size) {
   if (quick_index == -1) {
     return NULL;
   }
-  // get the first block in the quick list
-  sf_block *next = sf_quick_lists[quick_index].first;
-  if (next == NULL) {
-    return NULL;
-  }
-  if (sf_quick_lists[quick_index].length == 1) {
-    sf_quick_lists[quick_index].first = NULL;
-    sf_quick_lists[quick_index].length--;
-    set_quick_list_bit(next, 0);
-    set_alloc_bit(next, 0);
-    set_prev_alloc_bit(get_block_end(next), 0);
-
-    return next;
-  }
-  // iterate through the quick list
-  while (next != NULL) {
-    sf_block *peek = next->body.links.next->body.links.next;
-    if (peek == NULL) {
-      // remove the block from the quick list
-      sf_block *temp = next->body.links.next;
-      next->body.links.next = NULL;
-      sf_quick_lists[quick_index].length--;
-      set_quick_list_bit(temp, 0);
-      set_alloc_bit(temp, 0);
-      set_prev_alloc_bit(get_block_end(temp), 0);
-      return temp;
-    }
-    next = next->body.links.next;
+  sf_block *block = remove_specific_quicklist(quick_index);
+  if (block != NULL) {
+    sf_quick_list_ctls[quick_index].hits++;
+    SF_COUNT(SF_EV_QUICK_HIT, size);
+  } else {
+    SF_COUNT(SF_EV_QUICK_MISS, size);
   }
-  return NULL;
+  return block;
 }
 /*
  * Remove from specific quicklist
- * Quicklist is a singly linked list using LIFO format
+ * Quicklist is a singly linked list using LIFO format, blocks are popped off
+ * the head of the list.
  */
 sf_block *remove_specific_quicklist(int quick_index) {
   // get the index of the quick list
   if (quick_index == -1) {
     return NULL;
   }
-  // get the first block in the quick list
-  sf_block *next = sf_quick_lists[quick_index].first;
-  if (next == NULL) {
+  // pop the first block in the quick list
+  sf_block *block = sf_quick_lists[quick_index].first;
+  if (block == NULL) {
     return NULL;
   }
-  if (sf_quick_lists[quick_index].length == 1) {
-    sf_quick_lists[quick_index].first = NULL;
-    sf_quick_lists[quick_index].length--;
-    set_quick_list_bit(next, 0);
-    set_alloc_bit(next, 0);
-    set_prev_alloc_bit(get_block_end(next), 0);
-    return next;
-  }
-  // iterate through the quick list
-  while (next != NULL) {
-    sf_block *peek = next->body.links.next->body.links.next;
-    if (peek == NULL) {
-      // remove the block from the quick list
-      sf_block *temp = next->body.links.next;
-      next->body.links.next = NULL;
-      sf_quick_lists[quick_index].length--;
-      set_quick_list_bit(temp, 0);
-      set_alloc_bit(temp, 0);
-      set_prev_alloc_bit(get_block_end(temp), 0);
-      return temp;
-    }
-    next = next->body.links.next;
-  }
-  return NULL;
+  sf_quick_lists[quick_index].first = block_next(block);
+  sf_quick_lists[quick_index].length--;
+  set_quick_list_bit(block, 0);
+  set_alloc_bit(block, 0);
+  set_prev_alloc_bit(get_block_end(block), 0);
+  return block;
 }
 /*
  * Flush quicklist
@@ -645,36 +791,97 @@ int flush_quicklist(int quick_index) {
   if (quick_index == -1) {
     return 0;
   }
-  // get the first block in the quick list
-  sf_block *next = sf_quick_lists[quick_index].first;
-  if (next == NULL) {
-    return 0;
-  }
+  // empty the quick list into the free lists
+  return flush_quicklist_batch(quick_index,
+                               sf_quick_lists[quick_index].length) > 0;
+}
 
-  if (sf_quick_lists[quick_index].length < QUICK_LIST_MAX) {
+/*
+ * Flush the count oldest blocks (the tail) of a quicklist in one batch.
+ * The detached blocks are sorted by address so that adjacent blocks can be
+ * merged into runs in a single pass, each run is then coalesced with its free
+ * neighbours once and inserted into the free lists.
+ * Returns the number of blocks flushed.
+ */
+int flush_quicklist_batch(int quick_index, int count) {
+  sf_block *batch[QUICK_LIST_MAX_DEPTH];
+  if (quick_index == -1 || count <= 0) {
     return 0;
   }
-  // iterate through the quick list
-  for (int i = 0; i < QUICK_LIST_MAX; i++) {
-    sf_block *quickblock = remove_specific_quicklist(quick_index);
-    if (quickblock == NULL) {
-      return 0;
+  int length = sf_quick_lists[quick_index].length;
+  if (count > length) count = length;
+  if (count > QUICK_LIST_MAX_DEPTH) count = QUICK_LIST_MAX_DEPTH;
+  // detach the tail of the list, keeping the most recently freed blocks
+  sf_block *next = sf_quick_lists[quick_index].first;
+  if (count == length) {
+    sf_quick_lists[quick_index].first = NULL;
+  } else {
+    sf_block *last_kept = next;
+    for (int i = 1; i < length - count; i++) {
+      last_kept = block_next(last_kept);
+    }
+    next = block_next(last_kept);
+    set_block_next(last_kept, NULL);
+  }
+  sf_quick_lists[quick_index].length -= count;
+  // insertion sort by address, batches are at most QUICK_LIST_MAX_DEPTH long
+  int n = 0;
+  while (next != NULL && n < count) {
+    sf_block *block = next;
+    next = block_next(block);
+    int i = n++;
+    while (i > 0 && batch[i - 1] > block) {
+      batch[i] = batch[i - 1];
+      i--;
+    }
+    batch[i] = block;
+  }
+  SF_COUNT(SF_EV_FLUSH, MIN_BLOCK_SIZE + quick_index * 8);
+  SF_COUNT_N(SF_EV_FLUSHED, MIN_BLOCK_SIZE + quick_index * 8, n);
+  free_block_runs(batch, n, 0);
+  return n;
+}
+
+/*
+ * Free n allocated or quick list blocks sorted by address. Runs of adjacent
+ * blocks are merged in a single pass, each run is then coalesced with its
+ * free neighbours once and inserted into the free lists. If purge is set,
+ * every run may also be purged or trimmed as a single freed block would be.
+ * Returns the number of runs.
+ */
+int free_block_runs(sf_block **batch, int n, int purge) {
+  int runs = 0;
+  int i = 0;
+  while (i < n) {
+    sf_block *run = batch[i];
+    size_t run_size = get_block_size(run);
+    int j = i + 1;
+    while (j < n && (void *)run + run_size == (void *)batch[j]) {
+      run_size += get_block_size(batch[j]);
+      BLOCK_HEADER(batch[j]) = 0x0;
+      j++;
+    }
+    write_free_block(run, run_size, 0, get_prev_alloc_bit(run), 0, NULL, NULL);
+    set_prev_alloc_bit(get_block_end(run), 0);
+    run = coallesce(run);
+    insert_free_list(run);
+    if (purge) {
+      purge_after_free(run);
     }
-    // check if can coallesce
-    quickblock = coallesce(quickblock);
-    append_free_list(quickblock);
+    runs++;
+    i = j;
   }
-  return 1;
+  return runs;
 }
 
 /*
  * Get header from footer
  */
-sf_block *get_header_from_footer(sf_footer *footer) {
+sf_block *get_header_from_footer(sf_word *footer) {
   // read the block size with the 3 LSBs implicitly 0
   size_t size = *footer & ~0x7;
   // get the header
-  sf_block *header = (sf_block *)((void *)footer - size + sizeof(sf_footer));
+  sf_block *header = (sf_block *)((void *)footer - size + FOOTER_SIZE);
   return header;
 }
 /*
@@ -684,15 +891,15 @@ sf_block *remove_exact_block_free_list(sf_block *block) {
   if (get_alloc_bit(block) == 1) {
     return NULL;
   }
-  if (block->body.links.next == NULL) {
+  if (block_next(block) == NULL) {
     return NULL;
   }
-  if (block->body.links.prev == NULL) {
+  if (block_prev(block) == NULL) {
     return NULL;
   }
   // get the next and previous blocks
-  sf_block *next = block->body.links.next;
-  sf_block *prev = block->body.links.prev;
+  sf_block *next = block_next(block);
+  sf_block *prev = block_prev(block);
   // why would next and prev pointers not be set??
   if (next == NULL) {
     return NULL;
@@ -701,14 +908,23 @@ sf_block *remove_exact_block_free_list(sf_block *block) {
     return NULL;
   }
   // anyway...
+  purge_note_remove(block);
+  stats_note_remove(block);
+  if (sf_engine == SF_TLSF) {
+    return tlsf_remove_block(block);
+  }
+  int index = get_free_list_index(get_block_size(block));
+  if (index >= FREE_TREE_MIN_INDEX) {
+    free_tree_remove(index, block);
+  }
 
   // remove the block from the free list
-  next->body.links.prev = prev;
-  prev->body.links.next = next;
+  set_block_prev(next, prev);
+  set_block_next(prev, next);
 
   // set the next and previous pointers to NULL
-  block->body.links.next = NULL;
-  block->body.links.prev = NULL;
+  set_block_next(block, NULL);
+  set_block_prev(block, NULL);
   return block;
 }
 
@@ -723,7 +939,7 @@ sf_block *coallesce_prev(sf_block *block) {
     return NULL;
   }
   // get the previous block
-  sf_footer *prev_footer = (sf_footer *)((void *)block - sizeof(sf_footer));
+  sf_word *prev_footer = (sf_word *)((void *)block - FOOTER_SIZE);
   sf_block *prev = get_header_from_footer(prev_footer);
   // check if the previous block is free
   if (get_alloc_bit(prev) == 1) {
@@ -739,7 +955,7 @@ sf_block *coallesce_prev(sf_block *block) {
   int prev_alloc = get_prev_alloc_bit(prev);
   // wipe block header
   remove_footer(block);
-  block->header = 0x0;
+  BLOCK_HEADER(block) = 0x0;
   // write new block header
   write_free_block(prev, size, 0, prev_alloc, 0, 0, 0);
   // return the coallesced block
@@ -778,7 +994,7 @@ sf_block *coallesce_next(sf_block *block) {
   int prev_alloc = get_prev_alloc_bit(block);
   // wipe block header
   remove_footer(next);
-  next->header = 0x0;
+  BLOCK_HEADER(next) = 0x0;
   // write new block header
   write_free_block(block, size, 0, prev_alloc, 0, 0, 0);
   // return the coallesced block
@@ -811,14 +1027,22 @@ int is_pointer_invalid(void *pp) {
   // get the block
   sf_block *block = get_sf_block(pp);
   // check if pointer is 8-byte aligned
-  uintptr_t block_pointer_int = (uintptr_t)block;
-  if (block_pointer_int % 8 != 0) {
+  uintptr_t pointer_int = (uintptr_t)pp;
+  if (pointer_int % 8 != 0) {
     // debug("Pointer is not 8-byte aligned");
     return 1;
   }
+  // check if header of the block is outside the heap before reading it, the
+  // memory there may not be mapped
+  if ((void *)block < heap_start() || (void *)block >= heap_end()) {
+    // debug(
+    //     "Header of the block is before the start of the first block of the "
+    //     "heap");
+    return 1;
+  }
   // get the block
-  // check if block size is less than the minimum block size of 32
-  if (get_block_size(block) < 32) {
+  // check if block size is less than the minimum block size
+  if (get_block_size(block) < MIN_BLOCK_SIZE) {
     return 1;
   }
   // check if block size is not a multiple of 8
@@ -826,16 +1050,8 @@ int is_pointer_invalid(void *pp) {
     // debug("Block size is not a multiple of 8");
     return 1;
   }
-  // check if header of the block is before the start of the first block of the
-  // heap
-  if ((void *)block < sf_mem_start()) {
-    // debug(
-    //     "Header of the block is before the start of the first block of the "
-    //     "heap");
-    return 1;
-  }
   // check if footer of the block is after the end of the last block in the heap
-  if ((void *)block + get_block_size(block) > sf_mem_end()) {
+  if ((void *)block + get_block_size(block) > heap_end()) {
     // debug("Footer of the block is after the end of the last block in the
     // heap");
     return 1;
@@ -854,7 +1070,7 @@ int is_pointer_invalid(void *pp) {
   // block is free, but the alloc field of the previous block header is not 0
   if (get_prev_alloc_bit(block) == 0) {
     // get the previous block
-    sf_footer *prev_footer = (sf_footer *)((void *)block - sizeof(sf_footer));
+    sf_word *prev_footer = (sf_word *)((void *)block - FOOTER_SIZE);
     sf_block *prev = get_header_from_footer(prev_footer);
     if (get_alloc_bit(prev) != 0) {
       // debug(
@@ -866,6 +1082,23 @@ int is_pointer_invalid(void *pp) {
   }
   return 0;
 }
+/*
+ * Could an allocated block have been returned for a request of size bytes?
+ * A block is less than MIN_BLOCK_SIZE bigger than the request needs when
+ * the rest was too small to split off.
+ */
+int is_block_of_size(sf_block *block, size_t size) {
+  void *pp = (char *)block + HEADER_SIZE;
+  if ((BLOCK_HEADER(block) & 0x7) == HUGE_BLOCK_MARKER) {
+    return is_huge_pointer(pp) && huge_usable_size(pp) >= size;
+  }
+  if (!is_pointer_plausible(arena_of(pp), pp)) {
+    return 0;
+  }
+  size_t needed = calc_malloc_block_size(size);
+  size_t block_size = get_block_size(block);
+  return block_size >= needed && block_size < needed + MIN_BLOCK_SIZE;
+}
 /*
  * total coallesce
  */
@@ -873,11 +1106,13 @@ sf_block *coallesce(sf_block *block) {
   sf_block *coallesced_block = block;
   sf_block *potential = coallesce_prev(block);
   while (potential != NULL) {
+    SF_COUNT(SF_EV_COALESCE, get_block_size(potential));
     coallesced_block = potential;
     potential = coallesce_prev(coallesced_block);
   }
   potential = coallesce_next(coallesced_block);
   while (potential != NULL) {
+    SF_COUNT(SF_EV_COALESCE, get_block_size(potential));
     coallesced_block = potential;
     potential = coallesce_next(coallesced_block);
   }
@@ -891,7 +1126,7 @@ int is_exact_block_in_freelist(sf_block *block) {
   // get the index of the free list
   sf_block *dummy_pointer = get_free_list_head(get_block_size(block));
   // get the first block in the free list
-  sf_block *next = dummy_pointer->body.links.next;
+  sf_block *next = block_next(dummy_pointer);
   // iterate through the free list
   // debug("dummy_pointer: %p", dummy_pointer);
   // debug("next: %p", next);
@@ -905,22 +1140,62 @@ int is_exact_block_in_freelist(sf_block *block) {
 }
 
 sf_block *get_prev_block(sf_block *block) {
-  sf_footer *prev_footer = (sf_footer *)((void *)block - sizeof(sf_footer));
+  sf_word *prev_footer = (sf_word *)((void *)block - FOOTER_SIZE);
   sf_block *prev = get_header_from_footer(prev_footer);
   return prev;
 }
 sf_block *get_sf_block(void *pp) {
-  sf_block *block = (void *)((char *)pp - sizeof(sf_header));
+  sf_block *block = (void *)((char *)pp - HEADER_SIZE);
   return block;
 }
 
+/*
+ * Grow an allocated block in place, by absorbing the free block after it
+ * and, if the block ends at the epilogue, by growing the heap.
+ * Any remainder beyond the new size is split off into the free lists.
+ * Returns pp, or NULL if the block can not grow in place.
+ */
+sf_block *realloc_in_place(void *pp, size_t rsize) {
+  sf_block *block = get_sf_block(pp);
+  size_t size = calc_malloc_block_size(rsize);
+  size_t block_size = get_block_size(block);
+  sf_block *next = get_block_end(block);
+  size_t available = block_size;
+  sf_block *end = next;
+  if (get_alloc_bit(next) == 0) {
+    available += get_block_size(next);
+    end = get_block_end(next);
+  }
+  sf_block *extension = NULL;
+  if (available >= size) {
+    extension = remove_exact_block_free_list(next);
+  } else if ((void *)end == heap_end() - HEADER_SIZE) {
+    // the heap grows behind the block, taking in the wilderness if any
+    extension = grow_heap(size - block_size);
+  }
+  if (extension == NULL) {
+    return NULL;
+  }
+  size_t total = block_size + get_block_size(extension);
+  remove_footer(extension);
+  BLOCK_HEADER(extension) = 0x0;
+  // split before allocating, so that only what is used stops being fresh
+  write_block_header(block, total, 0, get_prev_alloc_bit(block), 1);
+  sf_block *remainder = split_block(block, size);
+  alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+  if (remainder != NULL) {
+    append_free_list(remainder);
+  }
+  return pp;
+}
+
 sf_block *realloc_more_mem(void *pp, size_t rsize) {
-  void *new_pp = sf_malloc(rsize);
+  void *new_pp = heap_malloc(rsize);
   if (new_pp == NULL) {
     return NULL;
   }
-  memcpy(new_pp, pp, get_block_size(get_sf_block(pp)) - sizeof(sf_header));
-  sf_free(pp);
+  memcpy(new_pp, pp, get_block_size(get_sf_block(pp)) - HEADER_SIZE);
+  heap_free(pp);
   return new_pp;
 }
 
@@ -943,86 +1218,75 @@ sf_block *realloc_less_mem(void *pp, size_t rsize) {
   return pp;
 }
 /*
- * Split block such that the first block is free and the second block is
- * allocated
+ * Distance from the payload of a free block to the first payload address
+ * with the given alignment that leaves room for a free block in front.
  */
-sf_block *memalign_split_block_1(sf_block *block, size_t size) {
-  int prev_alloc = get_prev_alloc_bit(block);
-  // get size
-  int block_size = get_block_size(block) - size;
-
-  if (block_size < MIN_BLOCK_SIZE) {
-    return NULL;
-  }
-  if (size < MIN_BLOCK_SIZE) {
-    return NULL;
+size_t aligned_offset(sf_block *block, size_t align) {
+  uintptr_t start = (uintptr_t)block + HEADER_SIZE;
+  uintptr_t payload = (start + align - 1) & ~(uintptr_t)(align - 1);
+  if (payload != start && payload - start < MIN_BLOCK_SIZE) {
+    payload = (start + MIN_BLOCK_SIZE + align - 1) & ~(uintptr_t)(align - 1);
   }
-  // split block by writing header after new block size (smaller block)
-  // since head of split block, set prev_alloc to whatever it was on current
-  // block
-  sf_block *block1 = write_free_block(block, size, 0, prev_alloc, 0, 0, 0);
-  // write header for new block, which should have size block_size (bigger
-  // block)
-  sf_block *block2 = alloc_block(get_block_end(block1), block_size, 0);
-  append_free_list(block1);
-  return block2;
+  return payload - start;
 }
 /*
- * Split block such that the second block is free and the first block is
- * allocated
+ * Remove a free block that can hold a block of the given size whose payload
+ * has the given alignment.
+ * Returns NULL if there is no such block.
  */
-sf_block *memalign_split_block_2(sf_block *block, size_t size) {
-  int prev_alloc = get_prev_alloc_bit(block);
-  // get size
-  int block_size = get_block_size(block) - size;
-  // debug("block_size: %d", block_size);
-  if (block_size < MIN_BLOCK_SIZE) {
-    return NULL;
+sf_block *remove_aligned_fit(size_t size, size_t align) {
+  // any block this big fits, wherever it starts
+  size_t worst = size + align + MIN_BLOCK_SIZE;
+  sf_block *block = NULL;
+  if (sf_engine == SF_TLSF) {
+    block = tlsf_find_fit(worst);
+  } else {
+    // smaller blocks fit if they happen to start in the right place
+    for (int i = get_free_list_index(size);
+         block == NULL && i < FREE_TREE_MIN_INDEX; i++) {
+      sf_block *head = &sf_free_list_heads[i];
+      for (sf_block *cur = block_next(head); cur != head;
+           cur = block_next(cur)) {
+        if (aligned_offset(cur, align) + size <= get_block_size(cur)) {
+          block = cur;
+          break;
+        }
+      }
+    }
+    if (block == NULL) {
+      block = free_tree_best_fit(worst);
+    }
   }
-  if (size < MIN_BLOCK_SIZE) {
+  if (block == NULL) {
     return NULL;
   }
-  // split block by writing header after new block size (smaller block)
-  // since head of split block, set prev_alloc to whatever it was on current
-  // block
-  sf_block *block1 = alloc_block(block, size, prev_alloc);
-  // write header for new block, which should have size block_size (bigger
-  // block)
-  sf_block *block2 =
-      write_free_block(get_block_end(block1), block_size, 0, 1, 0, 0, 0);
-  set_prev_alloc_bit(get_block_end(block2), 0);
-  append_free_list(block2);
-  return block1;
+  return remove_exact_block_free_list(block);
 }
 /*
- * Memalign alloc new block
+ * Allocate a block of the given size with an aligned payload out of a free
+ * block that has been removed from the free lists. The space in front of
+ * the payload and the space after the block are freed.
+ * Returns the aligned payload.
  */
-void *memalign_malloc(void *pp, size_t alignment, size_t expected_size) {
-  // if pp is aligned
-  if (((uintptr_t)pp % (alignment)) == 0) {
-    // split uneeded end of block
-    sf_block *block = get_sf_block(pp);
-    // debug("start of pp aligned, pp: %p", pp);
-    memalign_split_block_2(block, expected_size);
-    return pp;
-  }
-  sf_block *block = get_sf_block(pp);
-  size_t split_size = MIN_BLOCK_SIZE;
-  pp = (void *)((char *)pp + MIN_BLOCK_SIZE);
-  // find the first address that is aligned with at least MIN_BLOCK_SIZE bytes
-  // after start of block
-  while (((uintptr_t)pp % (alignment)) != 0) {
-    pp = (void *)((char *)pp + sizeof(sf_header));
-    split_size += sizeof(sf_header);
-  }
-  // debug("pp should be aligned: %ld", ((uintptr_t)pp % (alignment)));
-
-  // split beginning of block
-  sf_block *potential = memalign_split_block_1(block, split_size);
-  if (potential != NULL) {
-    block = potential;
-  }
-  // split uneeded end of block
-  memalign_split_block_2(block, expected_size);
-  return pp;
-}
\ No newline at end of file
+void *alloc_aligned(sf_block *block, size_t size, size_t align) {
+  int prev_alloc = get_prev_alloc_bit(block);
+  size_t block_size = get_block_size(block);
+  char *end = (char *)get_block_end(block);
+  size_t offset = aligned_offset(block, align);
+  if (offset != 0) {
+    // the block in front follows an allocated block, no need to coalesce
+    insert_free_list(write_free_block(block, offset, 0, prev_alloc, 0, 0, 0));
+    block = (sf_block *)((char *)block + offset);
+    block_size -= offset;
+    prev_alloc = 0;
+  }
+  write_block_header(block, block_size, 0, prev_alloc, 1);
+  sf_block *remainder = split_block(block, size);
+  alloc_block(block, get_block_size(block), prev_alloc);
+  if (remainder != NULL) {
+    append_free_list(remainder);
+  }
+  // the block after the tail may have been split off this one (see zero.h)
+  zero_note_split(end);
+  return (char *)block + HEADER_SIZE;
+}
@@ -0,0 +1,230 @@
+#define _DEFAULT_SOURCE
+#include "page_provider.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "zero.h"
+
+static sf_region mmap_region;
+static sf_region static_region;
+
+/*
+ * sfutil provider
+ */
+#ifdef SF_NO_SFUTIL
+// built without sfutil.o (see malloc_api.c), the provider has no pages
+static void *sfutil_start(void *ctx) { return NULL; }
+static void *sfutil_end(void *ctx) { return NULL; }
+static size_t sfutil_grow(void *ctx, size_t pages) { return 0; }
+#else
+static void *sfutil_start(void *ctx) { return sf_mem_start(); }
+static void *sfutil_end(void *ctx) { return sf_mem_end(); }
+static size_t sfutil_grow(void *ctx, size_t pages) {
+  size_t grown = 0;
+  while (grown < pages && sf_mem_grow() != NULL) {
+    grown++;
+  }
+  return grown;
+}
+#endif /* SF_NO_SFUTIL */
+
+sf_page_provider sf_sfutil_provider = {"sfutil", sfutil_start, sfutil_end,
+                                       sfutil_grow, NULL, NULL, 0};
+
+/*
+ * Region backed providers
+ */
+static void *region_start(void *ctx) { return ((sf_region *)ctx)->base; }
+static void *region_end(void *ctx) { return ((sf_region *)ctx)->brk; }
+
+static size_t static_grow(void *ctx, size_t pages) {
+  sf_region *region = ctx;
+  size_t left = (region->limit - region->brk) / PAGE_SZ;
+  if (pages > left) pages = left;
+  region->brk += pages * PAGE_SZ;
+  return pages;
+}
+
+static size_t static_shrink(void *ctx, size_t pages) {
+  sf_region *region = ctx;
+  size_t used = (region->brk - region->base) / PAGE_SZ;
+  if (pages > used) pages = used;
+  region->brk -= pages * PAGE_SZ;
+  return pages;
+}
+
+static size_t mmap_grow(void *ctx, size_t pages) {
+  sf_region *region = ctx;
+  if (region->base == NULL) {
+    // reserve the address space without committing any memory
+    void *base = mmap(NULL, region->size, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+      return 0;
+    }
+    region->base = base;
+    region->brk = base;
+    region->limit = (char *)base + region->size;
+  }
+  size_t left = (region->limit - region->brk) / PAGE_SZ;
+  if (pages > left) pages = left;
+  if (pages == 0) {
+    return 0;
+  }
+  // commit the pages
+  if (mprotect(region->brk, pages * PAGE_SZ, PROT_READ | PROT_WRITE) != 0) {
+    return 0;
+  }
+  region->brk += pages * PAGE_SZ;
+  return pages;
+}
+
+static size_t mmap_shrink(void *ctx, size_t pages) {
+  sf_region *region = ctx;
+  size_t used = (region->brk - region->base) / PAGE_SZ;
+  if (pages > used) pages = used;
+  if (pages == 0) {
+    return 0;
+  }
+  // decommit the pages but keep the addresses reserved
+  char *start = region->brk - pages * PAGE_SZ;
+  if (madvise(start, pages * PAGE_SZ, MADV_DONTNEED) != 0 ||
+      mprotect(start, pages * PAGE_SZ, PROT_NONE) != 0) {
+    return 0;
+  }
+  region->brk = start;
+  return pages;
+}
+
+static sf_page_provider mmap_provider = {
+    "mmap", region_start, region_end, mmap_grow, mmap_shrink, &mmap_region, 1};
+static sf_page_provider static_provider = {
+    "static", region_start, region_end, static_grow, static_shrink,
+    &static_region, 0};
+
+/*
+ * Set the page provider of the heap.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if the heap is already initialized.
+ */
+int sf_set_page_provider(sf_page_provider *provider) {
+  if (provider == NULL || heap_start() != heap_end()) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  sf_provider = provider;
+  return 0;
+}
+
+/*
+ * Use the fixed region of sfutil.o.
+ */
+int sf_use_sfutil_provider() { return sf_set_page_provider(&sf_sfutil_provider); }
+
+/*
+ * Use a range of reserve_size bytes of address space, committed on demand.
+ * A reserve_size of 0 reserves SF_MMAP_DEFAULT_RESERVE bytes.
+ */
+int sf_use_mmap_provider(size_t reserve_size) {
+  if (reserve_size == 0) {
+    reserve_size = SF_MMAP_DEFAULT_RESERVE;
+  }
+  if (mmap_region.base != NULL) {
+    // the range of an earlier heap can only be reused if it is large enough
+    if (mmap_region.size < reserve_size || heap_start() != heap_end()) {
+      sf_errno = EINVAL;
+      return -1;
+    }
+    return sf_set_page_provider(&mmap_provider);
+  }
+  mmap_region.size = (reserve_size + PAGE_SZ - 1) & ~(PAGE_SZ - 1);
+  return sf_set_page_provider(&mmap_provider);
+}
+
+/*
+ * Use a caller supplied buffer of size bytes.
+ * The heap starts at the first page aligned address in the buffer.
+ */
+int sf_use_static_provider(void *buffer, size_t size) {
+  if (buffer == NULL) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  uintptr_t base = ((uintptr_t)buffer + PAGE_SZ - 1) & ~(PAGE_SZ - 1);
+  uintptr_t limit = ((uintptr_t)buffer + size) & ~(PAGE_SZ - 1);
+  if (limit <= base) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  sf_region region = {(char *)base, (char *)base, (char *)limit, limit - base};
+  if (heap_start() != heap_end()) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  static_region = region;
+  return sf_set_page_provider(&static_provider);
+}
+
+/*
+ * Set up a provider like the mmap provider over size bytes of address space
+ * starting at base, which the caller has already reserved.
+ * @return The provider.
+ */
+sf_page_provider *init_region_provider(sf_page_provider *provider,
+                                       sf_region *region, void *base,
+                                       size_t size) {
+  region->base = base;
+  region->brk = base;
+  region->limit = (char *)base + size;
+  region->size = size;
+  *provider = mmap_provider;
+  provider->ctx = region;
+  return provider;
+}
+
+/*
+ * @return The starting address of the heap.
+ */
+void *heap_start() { return sf_provider->start(sf_provider->ctx); }
+
+/*
+ * @return The ending address of the heap.
+ */
+void *heap_end() { return sf_provider->end(sf_provider->ctx); }
+
+/*
+ * Grow the heap by up to pages pages at its end.
+ * @return The number of pages the heap grew by.
+ */
+size_t heap_grow(size_t pages) {
+#ifdef SF_COMPACT_HEADERS
+  size_t room = (SF_HEAP_MAX - (size_t)(heap_end() - heap_start())) / PAGE_SZ;
+  if (pages > room) pages = room;
+  if (pages == 0) return 0;
+#endif
+  size_t grown = sf_provider->grow(sf_provider->ctx, pages);
+  if (grown != 0) {
+    zero_note_grow();
+    sf_heap_counters.grows++;
+    sf_heap_counters.grown_bytes += grown * PAGE_SZ;
+  }
+  return grown;
+}
+
+/*
+ * Release up to pages pages at the end of the heap.
+ * @return The number of pages the heap shrank by, 0 if the provider can not
+ * shrink.
+ */
+size_t heap_shrink(size_t pages) {
+  if (sf_provider->shrink == NULL) {
+    return 0;
+  }
+  return sf_provider->shrink(sf_provider->ctx, pages);
+}
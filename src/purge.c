@@ -0,0 +1,299 @@
+#define _DEFAULT_SOURCE
+#include "purge.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "remote_free.h"
+#include "sfmm.h"
+#include "tlsf.h"
+#include "zero.h"
+
+static long purge_decay_ms = SF_PURGE_DECAY_DEFAULT;
+static sf_purge_mode purge_mode = SF_PURGE_DONTNEED;
+static size_t trim_threshold = SF_TRIM_THRESHOLD_DEFAULT;
+
+/*
+ * @return Milliseconds on the monotonic clock.
+ */
+static uint64_t now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Set how long a large block stays free before its pages are purged.
+ * A decay of 0 purges on every free, a negative decay turns automatic
+ * purging off.
+ * Returns 0 if successful.
+ */
+int sf_set_purge_decay(long decay_ms) {
+  purge_decay_ms = decay_ms;
+  return 0;
+}
+
+/*
+ * Set the madvise() advice used to purge pages.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if unsuccessful.
+ */
+int sf_set_purge_mode(sf_purge_mode mode) {
+  if (mode != SF_PURGE_DONTNEED && mode != SF_PURGE_FREE) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+#ifndef MADV_FREE
+  if (mode == SF_PURGE_FREE) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+#endif
+  purge_mode = mode;
+  return 0;
+}
+
+/*
+ * Set the size of the wilderness block above which the heap is trimmed
+ * after a free. A threshold of 0 turns automatic trimming off.
+ * Returns 0 if successful.
+ */
+int sf_set_trim_threshold(size_t threshold) {
+  trim_threshold = threshold;
+  return 0;
+}
+
+/*
+ * Find the pages of a large free block that can be purged, those after its
+ * metadata and before its footer.
+ */
+static void purge_range(sf_block *block, uintptr_t *start, uintptr_t *end) {
+  *start = ((uintptr_t)block + sizeof(sf_purge_block) + PAGE_SZ - 1) &
+           ~(PAGE_SZ - 1);
+  *end = ((uintptr_t)block + get_block_size(block) - FOOTER_SIZE) &
+         ~(PAGE_SZ - 1);
+}
+
+/*
+ * Record that a large block was just freed.
+ * Must be called before the block is inserted into the free lists.
+ */
+void purge_note_insert(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < PURGE_MIN_BLOCK_SIZE) {
+    return;
+  }
+  sf_purge_block *pb = (sf_purge_block *)block;
+  pb->freed_at = now_ms();
+  pb->purged_pages = 0;
+  sf_purge_counters.dirty_bytes += size;
+}
+
+/*
+ * Record that a large block is leaving the free lists.
+ * Its purged pages count as dirty from now on.
+ */
+void purge_note_remove(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < PURGE_MIN_BLOCK_SIZE) {
+    return;
+  }
+  sf_purge_block *pb = (sf_purge_block *)block;
+  size_t purged = pb->purged_pages * PAGE_SZ;
+  sf_purge_counters.dirty_bytes -= size - purged;
+  sf_purge_counters.purged_bytes -= purged;
+  if (purged != 0 && pb->zeroed) {
+    uintptr_t start, end;
+    purge_range(block, &start, &end);
+    zero_note_purged((char *)start, (char *)start + purged);
+  }
+}
+
+/*
+ * Have the pages of a free block been purged?
+ */
+int is_block_purged(sf_block *block) {
+  if (get_block_size(block) < PURGE_MIN_BLOCK_SIZE) {
+    return 0;
+  }
+  return ((sf_purge_block *)block)->purged_pages != 0;
+}
+
+/*
+ * Purge the whole pages of a large free block that does not hold metadata.
+ * Returns the number of pages purged.
+ */
+size_t purge_block(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < PURGE_MIN_BLOCK_SIZE || is_block_purged(block)) {
+    return 0;
+  }
+  uintptr_t start, end;
+  purge_range(block, &start, &end);
+  if (end <= start) {
+    return 0;
+  }
+  int advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+  if (purge_mode == SF_PURGE_FREE) advice = MADV_FREE;
+#endif
+  if (madvise((void *)start, end - start, advice) != 0) {
+    return 0;
+  }
+  size_t pages = (end - start) / PAGE_SZ;
+  ((sf_purge_block *)block)->purged_pages = pages;
+  ((sf_purge_block *)block)->zeroed = (advice == MADV_DONTNEED);
+  sf_purge_counters.dirty_bytes -= pages * PAGE_SZ;
+  sf_purge_counters.purged_bytes += pages * PAGE_SZ;
+  sf_purge_counters.purges++;
+  return pages;
+}
+
+/*
+ * Should a free block be purged by a pass over blocks freed before
+ * freed_before?
+ */
+static int purge_candidate(sf_block *block, uint64_t freed_before) {
+  return get_block_size(block) >= PURGE_MIN_BLOCK_SIZE &&
+         !is_block_purged(block) &&
+         ((sf_purge_block *)block)->freed_at <= freed_before;
+}
+
+/*
+ * Purge every large free block that was freed before freed_before.
+ * Purged blocks move behind the dirty blocks of the same size, so that they
+ * are reused last.
+ * Returns the number of pages purged.
+ */
+size_t purge_free_blocks(uint64_t freed_before) {
+  size_t pages = 0;
+  if (heap_start() == heap_end()) {
+    return 0;
+  }
+  if (sf_engine == SF_TLSF) {
+    int min_fl, min_sl;
+    tlsf_mapping(PURGE_MIN_BLOCK_SIZE, &min_fl, &min_sl);
+    for (int fl = min_fl; fl < TLSF_FL_COUNT; fl++) {
+      if ((sf_tlsf_fl_bitmap & (1UL << fl)) == 0) continue;
+      for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+        sf_block *head = &sf_tlsf_heads[fl][sl];
+        sf_block *block = block_next(head);
+        sf_block *last = block_prev(head);
+        while (block != head) {
+          sf_block *next = block_next(block);
+          if (purge_candidate(block, freed_before) && purge_block(block)) {
+            pages += ((sf_purge_block *)block)->purged_pages;
+            // move to the tail of the list
+            set_block_next(block_prev(block), next);
+            set_block_prev(next, block_prev(block));
+            set_block_next(block, head);
+            set_block_prev(block, block_prev(head));
+            set_block_next(block_prev(head), block);
+            set_block_prev(head, block);
+          }
+          if (block == last) break;
+          block = next;
+        }
+      }
+    }
+    return pages;
+  }
+  for (int index = FREE_TREE_MIN_INDEX; index < NUM_FREE_LISTS; index++) {
+    sf_block *head = &sf_free_list_heads[index];
+    for (sf_block *block = block_next(head); block != head;
+         block = block_next(block)) {
+      if (purge_candidate(block, freed_before)) {
+        // purged blocks order after dirty ones in the tree, so re-key it
+        free_tree_remove(index, block);
+        pages += purge_block(block);
+        free_tree_insert(index, block);
+      }
+    }
+  }
+  return pages;
+}
+
+/*
+ * Shrink the heap so that at most pad bytes of the wilderness block
+ * (beyond the minimum block size) stay at its end.
+ * Returns the number of bytes the heap shrank by.
+ */
+size_t trim_wilderness(size_t pad) {
+  if (heap_start() == heap_end()) {
+    return 0;
+  }
+  sf_block *epilogue_pntr = heap_end() - HEADER_SIZE;
+  if (get_prev_alloc_bit(epilogue_pntr) == 1) {
+    return 0;
+  }
+  sf_block *wilderness = get_prev_block(epilogue_pntr);
+  size_t size = get_block_size(wilderness);
+  if (size < pad + MIN_BLOCK_SIZE + PAGE_SZ) {
+    return 0;
+  }
+  size_t pages = (size - pad - MIN_BLOCK_SIZE) / PAGE_SZ;
+  remove_exact_block_free_list(wilderness);
+  size_t released = heap_shrink(pages);
+  size -= released * PAGE_SZ;
+  // write new epilogue
+  write_block_header(heap_end() - HEADER_SIZE, 0, 0, 0, 1);
+  write_free_block(wilderness, size, 0, get_prev_alloc_bit(wilderness), 0, 0,
+                   0);
+  insert_free_list(wilderness);
+  if (released != 0) {
+    sf_purge_counters.trimmed_bytes += released * PAGE_SZ;
+    sf_purge_counters.trims++;
+  }
+  return released * PAGE_SZ;
+}
+
+/*
+ * Give memory back to the OS: shrink the heap of every arena so that at most
+ * pad bytes of free space stay at its end, and purge the pages of every
+ * large free block.
+ * Returns 1 if any memory was released, 0 otherwise.
+ */
+int sf_trim(size_t pad) {
+  size_t trimmed = 0;
+  size_t purged = 0;
+  for (int i = 0; i < SF_MAX_ARENAS; i++) {
+    sf_arena *arena = get_arena(i);
+    if (arena == NULL) {
+      continue;
+    }
+    sf_arena *prev = arena_enter(arena);
+    remote_drain();
+    trimmed += trim_wilderness(pad);
+    purged += purge_free_blocks(UINT64_MAX);
+    arena_leave(prev);
+  }
+  return (trimmed != 0 || purged != 0) ? 1 : 0;
+}
+
+/*
+ * Trim or purge after a block was freed and inserted into the free lists.
+ */
+void purge_after_free(sf_block *block) {
+  size_t size = get_block_size(block);
+  if (size < PURGE_MIN_BLOCK_SIZE) {
+    return;
+  }
+  if (trim_threshold != 0 && size >= trim_threshold &&
+      get_block_end(block) == heap_end() - HEADER_SIZE) {
+    trim_wilderness(trim_threshold / 2);
+  }
+  if (purge_decay_ms < 0) {
+    return;
+  }
+  uint64_t now = now_ms();
+  if (now - sf_arena_cur->last_purge_pass >= (uint64_t)purge_decay_ms) {
+    sf_arena_cur->last_purge_pass = now;
+    purge_free_blocks(now - purge_decay_ms);
+  }
+}
@@ -0,0 +1,76 @@
+#include "remote_free.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "check.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+
+/*
+ * Push a block onto the remote free stack of the arena that owns it.
+ * Returns 0 if the block was queued, -1 if the caller has to free it with
+ * the arena locked.
+ */
+int remote_free(sf_arena *arena, void *pp) {
+  if (check_pointer_unlocked(arena, pp) != 0) {
+    return -1;
+  }
+  return remote_free_block(arena, get_sf_block(pp));
+}
+
+/*
+ * Push a block known to be allocated in another arena onto that arena's
+ * remote free stack.
+ * Returns 0 if the block was queued, -1 if it looks like a double free and
+ * the caller should free it under the arena lock instead.
+ */
+int remote_free_block(sf_arena *arena, sf_block *block) {
+  if (HELD_BLOCK(block)->key == REMOTE_KEY(arena)) {
+    // the key is set, this may be a double free
+    return -1;
+  }
+  HELD_BLOCK(block)->key = REMOTE_KEY(arena);
+  uint64_t top = __atomic_load_n(&arena->remote_frees, __ATOMIC_RELAXED);
+  uint64_t new_top;
+  do {
+    HELD_BLOCK(block)->next = (sf_block *)(uintptr_t)(top & REMOTE_PTR_MASK);
+    new_top = (uintptr_t)block |
+              ((top + ((uint64_t)1 << REMOTE_TAG_SHIFT)) & ~REMOTE_PTR_MASK);
+  } while (!__atomic_compare_exchange_n(&arena->remote_frees, &top, new_top,
+                                        1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+  return 0;
+}
+
+/*
+ * Take the whole remote free stack of the current arena and free its
+ * blocks. The arena lock must be held.
+ * @return The number of blocks freed.
+ */
+size_t remote_drain() {
+  uint64_t *stack = &sf_arena_cur->remote_frees;
+  uint64_t top = __atomic_load_n(stack, __ATOMIC_ACQUIRE);
+  if ((top & REMOTE_PTR_MASK) == 0) {
+    return 0;
+  }
+  while (!__atomic_compare_exchange_n(
+      stack, &top,
+      (top + ((uint64_t)1 << REMOTE_TAG_SHIFT)) & ~REMOTE_PTR_MASK, 1,
+      __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+  }
+  size_t freed = 0;
+  sf_block *block = (sf_block *)(uintptr_t)(top & REMOTE_PTR_MASK);
+  while (block != NULL) {
+    sf_block *next = HELD_BLOCK(block)->next;
+    HELD_BLOCK(block)->key = 0;
+    heap_free((char *)block + HEADER_SIZE);
+    freed++;
+    block = next;
+  }
+  return freed;
+}
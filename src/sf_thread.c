@@ -0,0 +1,33 @@
+#define _DEFAULT_SOURCE
+#include "sfmm.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "sf_thread.h"
+
+// the global sf_errno from sfmm.h, used by the initial thread
+#undef sf_errno
+
+static __thread int thread_errno;
+static __thread int thread_kind;  // 0 unknown, 1 initial thread, -1 other
+
+/*
+ * @return 1 if the calling thread is the one the process started with.
+ */
+int is_initial_thread() {
+  if (thread_kind == 0) {
+    thread_kind = (syscall(SYS_gettid) == getpid()) ? 1 : -1;
+  }
+  return thread_kind > 0;
+}
+
+/*
+ * @return The sf_errno of the calling thread.
+ */
+int *sf_errno_location() {
+  if (is_initial_thread()) {
+    return &sf_errno;
+  }
+  return &thread_errno;
+}
@@ -9,35 +9,210 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
+#include "check.h"
 #include "debug.h"
+#include "heap.h"
+#include "huge.h"
 #include "mem_library.h"
+#include "page_provider.h"
+#include "purge.h"
+#include "remote_free.h"
+#include "sf_thread.h"
+#include "slab.h"
+#include "stats.h"
+#include "tcache.h"
+#include "trace.h"
+#include "zero.h"
 
 void *sf_malloc(size_t size) {
+  void *pp = malloc_untraced(size);
+  if (trace_on()) {
+    trace_record(SF_TRACE_MALLOC, pp, NULL, size, 0);
+  }
+  return pp;
+}
+
+void sf_free(void *pp) {
+  if (trace_on() && pp != NULL) {
+    trace_record(SF_TRACE_FREE, pp, NULL, 0, 0);
+  }
+  free_untraced(pp);
+}
+
+void *malloc_untraced(size_t size) {
+  if (size == 0) return NULL;
+  if (is_slab_request(size)) {
+    sf_arena *prev = arena_enter(thread_arena());
+    void *pp = slab_malloc(size);
+    arena_leave(prev);
+    return pp;
+  }
+  void *pp = tcache_malloc(size);
+  if (pp != NULL) {
+    return pp;
+  }
+  sf_arena *prev = arena_enter(thread_arena());
+  remote_drain();
+  pp = heap_malloc(size);
+  arena_leave(prev);
+  return pp;
+}
+
+void free_untraced(void *pp) {
+  if (is_slab_pointer(pp)) {
+    sf_arena *owner = get_slab(pp)->arena;
+    if (owner == NULL) {
+      abort();
+    }
+    sf_arena *prev = arena_enter(owner);
+    slab_free(pp);
+    arena_leave(prev);
+    return;
+  }
+  if (tcache_free(pp) == 0) {
+    return;
+  }
+  if (is_huge_pointer(pp)) {
+    huge_free(pp);
+    return;
+  }
+  // blocks go back to the arena they came from, without waiting for its
+  // lock if this thread allocates elsewhere
+  sf_arena *arena = arena_of(pp);
+  if (arena != thread_arena() && remote_free(arena, pp) == 0) {
+    return;
+  }
+  sf_arena *prev = arena_enter(arena);
+  remote_drain();
+  heap_free(pp);
+  arena_leave(prev);
+}
+
+/*
+ * Free a block whose requested size the caller knows. Only the header is
+ * read: the pointer checks of sf_free() are skipped, and at the paranoid
+ * check level the size is checked against the header instead.
+ */
+void sf_free_sized(void *pp, size_t size) {
+  if (pp == NULL || is_slab_pointer(pp)) {
+    sf_free(pp);
+    return;
+  }
+  if (trace_on()) {
+    trace_record(SF_TRACE_FREE, pp, NULL, 0, 0);
+  }
+  sf_block *block = get_sf_block(pp);
+  if (check_level() == SF_CHECK_PARANOID && !is_block_of_size(block, size)) {
+    abort();
+  }
+  if ((BLOCK_HEADER(block) & 0x7) == HUGE_BLOCK_MARKER) {
+    huge_free(pp);
+    return;
+  }
+  if (tcache_free_block(block) == 0) {
+    return;
+  }
+  sf_arena *arena = arena_of(pp);
+  if (arena != thread_arena() && remote_free_block(arena, block) == 0) {
+    return;
+  }
+  sf_arena *prev = arena_enter(arena);
+  remote_drain();
+  if (arena == thread_arena()) {
+    heap_free_block(block);
+  } else {
+    // the remote free stack suspected a double free
+    heap_free(pp);
+  }
+  arena_leave(prev);
+}
+
+void *sf_realloc(void *pp, size_t rsize) {
+  void *new_pp;
+  if (is_slab_pointer(pp)) {
+    new_pp = slab_realloc(pp, rsize);
+  } else {
+    sf_arena *prev = arena_enter(arena_of(pp));
+    new_pp = heap_realloc(pp, rsize);
+    arena_leave(prev);
+  }
+  if (trace_on()) {
+    trace_record(SF_TRACE_REALLOC, new_pp, pp, rsize, 0);
+  }
+  return new_pp;
+}
+
+void *sf_memalign(size_t size, size_t align) {
+  sf_arena *prev = arena_enter(thread_arena());
+  remote_drain();
+  void *pp = heap_memalign(size, align);
+  arena_leave(prev);
+  if (trace_on()) {
+    trace_record(SF_TRACE_MEMALIGN, pp, NULL, size, align);
+  }
+  return pp;
+}
+
+void *sf_calloc(size_t nmemb, size_t size) {
+  sf_arena *prev = arena_enter(thread_arena());
+  remote_drain();
+  void *pp = heap_calloc(nmemb, size);
+  arena_leave(prev);
+  if (trace_on()) {
+    trace_record(SF_TRACE_MALLOC, pp, NULL, nmemb * size, 0);
+  }
+  return pp;
+}
+
+/*
+ * Lay out the prologue, the first free block and the epilogue the first
+ * time the heap is used.
+ * Returns 0 on success, -1 with sf_errno set to ENOMEM otherwise.
+ */
+static int heap_init() {
+  if (heap_grow(1) == 0) {
+    sf_errno = ENOMEM;
+    return -1;
+  }
+  void *allowed_pntr = heap_start() + HEAP_PAD;  // prologue block
+  // pad the prologue so that the payload of the block after it is aligned
+  uintptr_t first_payload =
+      (uintptr_t)allowed_pntr + MIN_BLOCK_SIZE + HEADER_SIZE;
+  size_t pad = -first_payload & (sf_min_align - 1);
+  // allocate block of minimum size at prologue so it cannot be used
+  alloc_block(allowed_pntr, MIN_BLOCK_SIZE + pad, 0);
+  allowed_pntr = get_block_end(
+      allowed_pntr);  // set new allowed pointer to after prolouge
+  init_free_lists();  // initialize all the free lists
+  // turn rest of newly grown memory into free block
+  size_t blocksize = (heap_end() - allowed_pntr) - HEADER_SIZE;
+  sf_block *block = allowed_pntr;
+  write_free_block(block, blocksize, 0, 1, 0, 0, 0);
+  // write epilogue before the free block looks for neighbours to coalesce
+  sf_block *epilogue_pntr = heap_end() - HEADER_SIZE;
+  write_block_header(epilogue_pntr, 0, 0, 0, 1);
+  // add block to free list
+  append_free_list(block);
+  return 0;
+}
+
+/*
+ * The heap_* functions do the work of the public entry points above, with
+ * the lock of the current arena held.
+ */
+void *heap_malloc(size_t size) {
   if (size == 0) return NULL;
-  void *allowed_pntr = 0;
-  if (sf_mem_start() == sf_mem_end()) {
-    // first time malloc is called
-    // initialize heap
-    allowed_pntr = sf_mem_grow();  // prologue block
-    // allocate block of minimum size at prologue so it cannot be used
-    alloc_block(allowed_pntr, MIN_BLOCK_SIZE, 0);
-    allowed_pntr = get_block_end(
-        allowed_pntr);  // set new allowed pointer to after prolouge
-    init_free_lists();  // initialize all the free lists
-    // turn rest of newly grown memory into free block
-    int blocksize = (sf_mem_end() - allowed_pntr) - sizeof(sf_header);
-    sf_block *block = allowed_pntr;
-    write_free_block(block, blocksize, 0, 1, 0, 0, 0);
-    // add block to free list
-    append_free_list(block);
-    // write epilogue
-    sf_block *epilogue_pntr = sf_mem_end() - sizeof(sf_header);
-    write_block_header(epilogue_pntr, 0, 0, 0, 1);
+  if (is_huge_request(size)) {
+    return huge_malloc(size, 16);
+  }
+  if (heap_start() == heap_end() && heap_init() != 0) {
+    return NULL;
   }
   // determine the size of the block
   // add size, headersize, footersize, next/prev pointers (free), padding to
   // make it a multiple of 8
-  int blocksize = calc_malloc_block_size(size);
+  size_t blocksize = calc_malloc_block_size(size);
   // debug("blocksize: %d", blocksize);
 
   // check if there is a block in the quicklist that fits
@@ -47,8 +222,9 @@ void *sf_malloc(size_t size) {
     // block found in quicklist
     // alloc block
     alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+    stats_note_alloc(block, size);
     // return pointer to payload of block
-    void *payload = (void *)((char *)block + sizeof(sf_header));
+    void *payload = (void *)((char *)block + HEADER_SIZE);
     return payload;
   }
 
@@ -59,56 +235,44 @@ void *sf_malloc(size_t size) {
   if (block != NULL) {
     // block found in free list
     alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+    stats_note_alloc(block, size);
     // add second block to free list
-    void *payload = (void *)((char *)block + sizeof(sf_header));
+    void *payload = (void *)((char *)block + HEADER_SIZE);
     return payload;
   }
 
   // no block found in free list or quicklist
-  // grow heap
-  // get pointer for epilogue
-  sf_block *epilogue_pntr = sf_mem_end() - sizeof(sf_header);
-  int epilogue_prev_alloc = get_prev_alloc_bit(epilogue_pntr);
-  sf_block *new_memblock = epilogue_pntr;
-  void *old_end_of_memory = sf_mem_end();
-  // grow heap
-  allowed_pntr = sf_mem_grow();
-  // check if allowed_pntr is NULL
-  if (allowed_pntr == NULL) {
+  // grow heap by all the pages needed at once and carve the block from it
+  block = grow_heap(blocksize);
+  if (block == NULL) {
     sf_errno = ENOMEM;
     return NULL;
   }
-  // get pointer for new epilogue
-  sf_block *new_epilogue_pntr = sf_mem_end() - sizeof(sf_header);
-  // write new epilogue
-  write_block_header(new_epilogue_pntr, 0, 0, 0, 1);
-  // get block size
-  int new_blocksize =
-      (sf_mem_end() - old_end_of_memory);  // don't subtract header size because
-                                           // coalescing previous epilogue
-  // change old epilogue to head of a free block
-  write_free_block(epilogue_pntr, new_blocksize, 0, epilogue_prev_alloc, 0, 0,
-                   0);
-  // sf_show_block(epilogue_pntr);
-  // don't forger to coalesce
-  new_memblock = coallesce(epilogue_pntr);
-
-  // append after potential coallasing
-  append_free_list(new_memblock);
-  // add block to free list
-  // call sf_malloc again
-  return sf_malloc(size);
+  alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+  stats_note_alloc(block, size);
+  void *payload = (void *)((char *)block + HEADER_SIZE);
+  return payload;
 }
 
-void sf_free(void *pp) {
+void heap_free(void *pp) {
   if (pp == NULL) {
     abort();
   }
-  // get block
-  sf_block *block = (void *)((char *)pp - sizeof(sf_header));
-  if (is_pointer_invalid(pp)) {
+  if (is_huge_pointer(pp)) {
+    huge_free(pp);
+    return;
+  }
+  if (check_pointer(pp) != 0) {
     abort();
   }
+  heap_free_block(get_sf_block(pp));
+}
+
+/*
+ * Free a block known to be a valid allocated heap block.
+ */
+void heap_free_block(sf_block *block) {
+  stats_note_free(block);
   convert_to_free(block);
   sf_block *next = get_block_end(block);
   // check if can add to quicklist
@@ -120,40 +284,51 @@ void sf_free(void *pp) {
   // check if can coalesce
   block = coallesce(block);
   // add to free list
-  append_free_list(block);
+  insert_free_list(block);
+  // give large free blocks back to the OS
+  purge_after_free(block);
   return;
 }
 
-void *sf_realloc(void *pp, size_t rsize) {
+void *heap_realloc(void *pp, size_t rsize) {
   // check if pointer is valid
   if (pp == NULL) {
     sf_errno = EINVAL;
     return NULL;
   }
+  if (is_huge_pointer(pp)) {
+    if (rsize == 0) {
+      huge_free(pp);
+      return NULL;
+    }
+    return huge_realloc(pp, rsize);
+  }
   sf_block *block = get_sf_block(pp);
   // debug("block: %p", block);
   // sf_show_block(block);
-  if (is_pointer_invalid(pp)) {
+  if (check_pointer(pp) != 0) {
     sf_errno = EINVAL;
     return NULL;
   }
   if (rsize == 0) {
-    sf_free(pp);
+    heap_free(pp);
     return NULL;
   }
-  if (calc_malloc_block_size(rsize) == get_block_size(block)) {
+  size_t size = calc_malloc_block_size(rsize);
+  if (size == get_block_size(block)) {
     return pp;
   }
-  if (rsize > get_block_size(block)) {
-    return realloc_more_mem(pp, rsize);
-  }
-  if (rsize < get_block_size(block)) {
+  if (size < get_block_size(block)) {
     return realloc_less_mem(pp, rsize);
   }
-  return NULL;
+  // only copy if the block can not grow into its neighbour or the heap
+  if (!is_huge_request(rsize) && realloc_in_place(pp, rsize) != NULL) {
+    return pp;
+  }
+  return realloc_more_mem(pp, rsize);
 }
 
-void *sf_memalign(size_t size, size_t align) {
+void *heap_memalign(size_t size, size_t align) {
   // check if size is less than minimum alignment of 8
   if (size == 0) {
     // debug("size is 0");
@@ -170,22 +345,43 @@ void *sf_memalign(size_t size, size_t align) {
     sf_errno = EINVAL;
     return NULL;
   }
-  /*
-  attempt to allocate a block whose size is at
-  least the requested size, plus the alignment size,
-  plus the minimum block size, plus the size required for a
-  block header and footer
-  */
-  size_t blocksize = size + sizeof(sf_footer) + align + MIN_BLOCK_SIZE;
-  void *pp = sf_malloc(blocksize);  // malloc calls calc_malloc_block_size which
-                                    // adds 8 bytes for the header
-  if (sf_errno == ENOMEM) {
+  // page alignment comes for free with a mapping of its own
+  if (align >= PAGE_SZ || is_huge_request(size)) {
+    return huge_malloc(size, align);
+  }
+  if (heap_start() == heap_end() && heap_init() != 0) {
     return NULL;
   }
-  if (pp == NULL) {
+  size_t blocksize = calc_malloc_block_size(size);
+  sf_block *block = remove_aligned_fit(blocksize, align);
+  if (block == NULL) {
+    // room for the block wherever the new memory ends up starting
+    block = grow_heap(blocksize + align + MIN_BLOCK_SIZE);
+    if (block == NULL) {
+      sf_errno = ENOMEM;
+      return NULL;
+    }
+  }
+  void *pp = alloc_aligned(block, blocksize, align);
+  stats_note_alloc(get_sf_block(pp), size);
+  return pp;
+}
+
+void *heap_calloc(size_t nmemb, size_t size) {
+  if (nmemb == 0 || size == 0) return NULL;
+  if (size > SIZE_MAX / nmemb) {
+    sf_errno = ENOMEM;
     return NULL;
   }
-  blocksize = get_block_size(get_sf_block(pp));
-  // malloc will automatically add 8 bytes for the header
-  return memalign_malloc(pp, align, calc_malloc_block_size(size));
+  size *= nmemb;
+  // huge blocks are fresh mappings, which are always zero
+  if (is_huge_request(size)) {
+    return huge_malloc(size, 16);
+  }
+  zero_note_reset();
+  void *pp = heap_malloc(size);
+  if (pp != NULL) {
+    zero_payload(pp, size);
+  }
+  return pp;
 }
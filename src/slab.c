@@ -0,0 +1,347 @@
+#define _DEFAULT_SOURCE
+#include "slab.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+#include "trace.h"
+
+static const uint32_t slab_class_sizes[SLAB_CLASS_COUNT] = {8,  16, 24,
+                                                            32, 48, 64};
+
+static size_t slab_max;  // largest request served from slabs, 0 for none
+static char *slab_space;
+static char *slab_brk;  // end of the pages handed out so far
+
+/*
+ * Stack of released slab pages, kept outside the pages since their
+ * contents are purged.
+ */
+static pthread_mutex_t slab_space_lock = PTHREAD_MUTEX_INITIALIZER;
+static sf_slab **released_slabs;
+static size_t released_count;
+static size_t released_slots;
+
+/*
+ * Set the largest request served from slabs, at most SLAB_MAX_SIZE.
+ * A max_size of 0, the default, turns slabs off.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if max_size is too large.
+ */
+int sf_set_slab_max(size_t max_size) {
+  if (max_size > SLAB_MAX_SIZE) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  __atomic_store_n(&slab_max, max_size, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/*
+ * Is a request of size bytes served from a slab?
+ */
+int is_slab_request(size_t size) {
+  return size != 0 && size <= __atomic_load_n(&slab_max, __ATOMIC_RELAXED);
+}
+
+/*
+ * Is pp inside the address range of the slabs?
+ */
+int is_slab_pointer(void *pp) {
+  char *space = __atomic_load_n(&slab_space, __ATOMIC_ACQUIRE);
+  return space != NULL && (char *)pp >= space &&
+         (char *)pp < space + SLAB_SPACE;
+}
+
+/*
+ * @return The slab containing a slab pointer.
+ */
+sf_slab *get_slab(void *pp) {
+  return (sf_slab *)((uintptr_t)pp & ~(PAGE_SZ - 1));
+}
+
+/*
+ * @return The index of the smallest size class that fits size bytes and
+ * keeps its slots aligned like heap payloads (see sf_set_min_alignment).
+ */
+static int slab_class(size_t size) {
+  int index = 0;
+  while (slab_class_sizes[index] < size ||
+         slab_class_sizes[index] % sf_min_align != 0) {
+    index++;
+  }
+  return index;
+}
+
+/*
+ * Take a page for a new slab, reusing a released page if there is one.
+ * @return The page, or NULL if the slab range is exhausted.
+ */
+static sf_slab *slab_page_alloc() {
+  sf_slab *slab = NULL;
+  pthread_mutex_lock(&slab_space_lock);
+  if (released_count > 0) {
+    slab = released_slabs[--released_count];
+  } else {
+    if (slab_space == NULL) {
+      // reserve the address space without committing any memory
+      char *space = mmap(NULL, SLAB_SPACE, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (space != MAP_FAILED) {
+        slab_brk = space;
+        __atomic_store_n(&slab_space, space, __ATOMIC_RELEASE);
+      }
+    }
+    if (slab_space != NULL && slab_brk < slab_space + SLAB_SPACE &&
+        mprotect(slab_brk, PAGE_SZ, PROT_READ | PROT_WRITE) == 0) {
+      slab = (sf_slab *)slab_brk;
+      slab_brk += PAGE_SZ;
+    }
+  }
+  pthread_mutex_unlock(&slab_space_lock);
+  return slab;
+}
+
+/*
+ * Purge the page of an empty slab and keep it for a later slab. If there
+ * is no room to keep it, it stays with the current arena as its spare.
+ */
+static void slab_page_release(sf_slab *slab) {
+  pthread_mutex_lock(&slab_space_lock);
+  if (released_count == released_slots) {
+    size_t slots = (released_slots == 0) ? PAGE_SZ / sizeof(sf_slab *)
+                                         : 2 * released_slots;
+    sf_slab **stack = mmap(NULL, slots * sizeof(sf_slab *),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+      pthread_mutex_unlock(&slab_space_lock);
+      sf_arena_cur->spare_slab = slab;
+      return;
+    }
+    if (released_slabs != NULL) {
+      memcpy(stack, released_slabs, released_count * sizeof(sf_slab *));
+      munmap(released_slabs, released_slots * sizeof(sf_slab *));
+    }
+    released_slabs = stack;
+    released_slots = slots;
+  }
+  // the page reads back as zero, which marks it as not in use
+  madvise(slab, PAGE_SZ, MADV_DONTNEED);
+  released_slabs[released_count++] = slab;
+  pthread_mutex_unlock(&slab_space_lock);
+}
+
+/*
+ * Turn a page into an empty slab of the current arena.
+ */
+static sf_slab *slab_init(sf_slab *slab, uint32_t slot_size) {
+  memset(slab, 0, sizeof(sf_slab));
+  slab->arena = sf_arena_cur;
+  slab->slot_size = slot_size;
+  slab->first_slot = (sizeof(sf_slab) + 15) & ~15;
+  slab->slots = (PAGE_SZ - slab->first_slot) / slot_size;
+  // mark the bits past the last slot as used so they are never handed out
+  for (uint32_t i = slab->slots; i < SLAB_BITMAP_WORDS * 64; i++) {
+    slab->bitmap[i / 64] |= (uint64_t)1 << (i % 64);
+  }
+  return slab;
+}
+
+static void slab_link(sf_slab *slab, int index) {
+  sf_slab **head = &sf_arena_cur->slabs[index];
+  slab->prev = NULL;
+  slab->next = *head;
+  if (*head != NULL) {
+    (*head)->prev = slab;
+  }
+  *head = slab;
+}
+
+static void slab_unlink(sf_slab *slab, int index) {
+  if (slab->prev != NULL) {
+    slab->prev->next = slab->next;
+  } else {
+    sf_arena_cur->slabs[index] = slab->next;
+  }
+  if (slab->next != NULL) {
+    slab->next->prev = slab->prev;
+  }
+  slab->next = NULL;
+  slab->prev = NULL;
+}
+
+/*
+ * @return A slab of the current arena with a free slot in the size class,
+ * or NULL with sf_errno set to ENOMEM.
+ */
+static sf_slab *slab_with_room(int index) {
+  sf_slab *slab = sf_arena_cur->slabs[index];
+  if (slab == NULL) {
+    slab = sf_arena_cur->spare_slab;
+    if (slab != NULL) {
+      sf_arena_cur->spare_slab = NULL;
+    } else {
+      slab = slab_page_alloc();
+    }
+    if (slab == NULL) {
+      sf_errno = ENOMEM;
+      return NULL;
+    }
+    slab_init(slab, slab_class_sizes[index]);
+    slab_link(slab, index);
+  }
+  return slab;
+}
+
+/*
+ * Allocate a slot for size bytes from a slab of the current arena.
+ * The arena lock must be held.
+ * Returns the slot, or NULL with sf_errno set to ENOMEM.
+ */
+void *slab_malloc(size_t size) {
+  int index = slab_class(size);
+  sf_slab *slab = slab_with_room(index);
+  if (slab == NULL) {
+    return NULL;
+  }
+  int slot = 0;
+  for (int i = 0; i < SLAB_BITMAP_WORDS; i++) {
+    if (~slab->bitmap[i] != 0) {
+      slot = i * 64 + __builtin_ctzll(~slab->bitmap[i]);
+      break;
+    }
+  }
+  slab->bitmap[slot / 64] |= (uint64_t)1 << (slot % 64);
+  sf_heap_counters.slab_slots++;
+  sf_heap_counters.slab_bytes += slab->slot_size;
+  if (++slab->used == slab->slots) {
+    slab_unlink(slab, index);
+  }
+  return (char *)slab + slab->first_slot + (size_t)slot * slab->slot_size;
+}
+
+/*
+ * Allocate n slots for size bytes, taking all the free slots of a bitmap
+ * word at once. The arena lock must be held.
+ * Returns the number of slots stored in out, fewer than n with sf_errno
+ * set to ENOMEM if no more slabs could be mapped.
+ */
+size_t slab_malloc_batch(size_t size, size_t n, void **out) {
+  int index = slab_class(size);
+  size_t count = 0;
+  while (count < n) {
+    sf_slab *slab = slab_with_room(index);
+    if (slab == NULL) {
+      break;
+    }
+    char *first = (char *)slab + slab->first_slot;
+    for (int i = 0; i < SLAB_BITMAP_WORDS && count < n; i++) {
+      uint64_t free_bits = ~slab->bitmap[i];
+      while (free_bits != 0 && count < n) {
+        int slot = i * 64 + __builtin_ctzll(free_bits);
+        free_bits &= free_bits - 1;
+        out[count++] = first + (size_t)slot * slab->slot_size;
+        slab->used++;
+        sf_heap_counters.slab_slots++;
+        sf_heap_counters.slab_bytes += slab->slot_size;
+      }
+      slab->bitmap[i] = ~free_bits;
+    }
+    if (slab->used == slab->slots) {
+      slab_unlink(slab, index);
+    }
+  }
+  return count;
+}
+
+/*
+ * @return The index of the slot at pp, or -1 if pp is not the start of a
+ * slot in use.
+ */
+static int slab_slot(sf_slab *slab, void *pp) {
+  size_t offset = (char *)pp - (char *)slab;
+  if (slab->slot_size == 0 || offset < slab->first_slot ||
+      (offset - slab->first_slot) % slab->slot_size != 0) {
+    return -1;
+  }
+  size_t slot = (offset - slab->first_slot) / slab->slot_size;
+  if (slot >= slab->slots ||
+      (slab->bitmap[slot / 64] & ((uint64_t)1 << (slot % 64))) == 0) {
+    return -1;
+  }
+  return slot;
+}
+
+/*
+ * Free a slot. The lock of the slab's arena must be held and be the
+ * current arena.
+ * Aborts if pp is not a slot in use.
+ */
+void slab_free(void *pp) {
+  sf_slab *slab = get_slab(pp);
+  int slot = slab_slot(slab, pp);
+  if (slot < 0) {
+    abort();
+  }
+  int index = slab_class(slab->slot_size);
+  slab->bitmap[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+  sf_heap_counters.slab_slots--;
+  sf_heap_counters.slab_bytes -= slab->slot_size;
+  if (slab->used-- == slab->slots) {
+    slab_link(slab, index);
+  }
+  if (slab->used == 0) {
+    slab_unlink(slab, index);
+    if (sf_arena_cur->spare_slab == NULL) {
+      sf_arena_cur->spare_slab = slab;
+    } else {
+      slab_page_release(slab);
+    }
+  }
+}
+
+/*
+ * Usable size of a slot, 0 if pp is not a slot in use.
+ */
+size_t slab_usable_size(void *pp) {
+  sf_slab *slab = get_slab(pp);
+  return (slab_slot(slab, pp) < 0) ? 0 : slab->slot_size;
+}
+
+/*
+ * Resize a slot, keeping it if the new size is in the same size class and
+ * copying it to a new slot or heap block otherwise. Called without a lock.
+ * Returns the new pointer, or NULL with the old slot left intact.
+ */
+void *slab_realloc(void *pp, size_t rsize) {
+  size_t usable = slab_usable_size(pp);
+  if (usable == 0) {
+    sf_errno = EINVAL;
+    return NULL;
+  }
+  if (rsize == 0) {
+    free_untraced(pp);
+    return NULL;
+  }
+  if (is_slab_request(rsize) &&
+      slab_class(rsize) == slab_class(usable)) {
+    return pp;
+  }
+  void *new_pp = malloc_untraced(rsize);
+  if (new_pp == NULL) {
+    return NULL;
+  }
+  memcpy(new_pp, pp, (rsize < usable) ? rsize : usable);
+  free_untraced(pp);
+  return new_pp;
+}
@@ -0,0 +1,152 @@
+#include "stats.h"
+
+#include <string.h>
+
+#include "arena.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tlsf.h"
+
+/*
+ * Record that a free block is entering the free lists of the current arena.
+ */
+void stats_note_insert(sf_block *block) {
+  size_t size = get_block_size(block);
+  int index = get_free_list_index(size);
+  sf_heap_counters.free_blocks[index]++;
+  sf_heap_counters.free_bytes[index] += size;
+}
+
+/*
+ * Record that a free block is leaving the free lists of the current arena.
+ * Must be called before its size changes.
+ */
+void stats_note_remove(sf_block *block) {
+  size_t size = get_block_size(block);
+  int index = get_free_list_index(size);
+  sf_heap_counters.free_blocks[index]--;
+  sf_heap_counters.free_bytes[index] -= size;
+}
+
+/*
+ * Record that a block of the current arena was allocated for a request of
+ * requested bytes, 0 for blocks taken by a thread cache ahead of any
+ * request.
+ */
+void stats_note_alloc(sf_block *block, size_t requested) {
+  sf_heap_counters.live_blocks++;
+  if (requested != 0) {
+    sf_heap_counters.requested_bytes += requested;
+    sf_heap_counters.allocated_bytes += get_block_size(block);
+  }
+}
+
+/*
+ * Record that an allocated block of the current arena is being freed.
+ */
+void stats_note_free(sf_block *block) { sf_heap_counters.live_blocks--; }
+
+/*
+ * @return The size of the largest block in the free lists of the current
+ * arena.
+ */
+static size_t largest_free_block() {
+  if (sf_engine == SF_TLSF) {
+    if (sf_tlsf_fl_bitmap == 0) {
+      return 0;
+    }
+    int fl = 63 - __builtin_clzl(sf_tlsf_fl_bitmap);
+    int sl = 31 - __builtin_clz(sf_tlsf_sl_bitmap[fl]);
+    sf_block *head = &sf_tlsf_heads[fl][sl];
+    size_t largest = 0;
+    for (sf_block *cur = block_next(head); cur != head; cur = block_next(cur)) {
+      if (get_block_size(cur) > largest) {
+        largest = get_block_size(cur);
+      }
+    }
+    return largest;
+  }
+  for (int i = NUM_FREE_LISTS - 1; i >= 0; i--) {
+    if (sf_heap_counters.free_blocks[i] != 0) {
+      // the lists are sorted by size
+      return get_block_size(block_prev(&sf_free_list_heads[i]));
+    }
+  }
+  return 0;
+}
+
+/*
+ * Add the counters of the current arena to stats.
+ */
+static void add_arena_stats(sf_stats *stats) {
+  sf_heap_stats *counters = &sf_heap_counters;
+  size_t heap_size = heap_end() - heap_start();
+  size_t unused = 0;
+  for (int i = 0; i < NUM_FREE_LISTS; i++) {
+    stats->free_blocks[i] += counters->free_blocks[i];
+    stats->free_bytes[i] += counters->free_bytes[i];
+    unused += counters->free_bytes[i];
+  }
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+    int length = sf_quick_lists[i].length;
+    stats->quick_blocks[i] += length;
+    unused += length * (MIN_BLOCK_SIZE + i * 8);
+  }
+  if (heap_size != 0) {
+    // less the padding, the prologue and the epilogue
+    sf_block *prologue = (sf_block *)((char *)heap_start() + HEAP_PAD);
+    stats->live_bytes += heap_size - HEAP_PAD - get_block_size(prologue) -
+                         HEADER_SIZE - unused;
+  }
+  size_t largest = largest_free_block();
+  if (largest > stats->largest_free) {
+    stats->largest_free = largest;
+  }
+  stats->heap_size += heap_size;
+  stats->live_blocks += counters->live_blocks;
+  stats->requested_bytes += counters->requested_bytes;
+  stats->allocated_bytes += counters->allocated_bytes;
+  stats->grows += counters->grows;
+  stats->grown_bytes += counters->grown_bytes;
+  stats->trims += sf_purge_counters.trims;
+  stats->trimmed_bytes += sf_purge_counters.trimmed_bytes;
+  stats->slab_slots += counters->slab_slots;
+  stats->slab_bytes += counters->slab_bytes;
+}
+
+/*
+ * Take the statistics of all arenas, locking each in turn. Nothing is
+ * walked but the quick list lengths and, with the TLSF engine, the list
+ * holding the largest free block.
+ * @return The statistics.
+ */
+sf_stats sf_get_stats() {
+  sf_stats stats;
+  memset(&stats, 0, sizeof(stats));
+  for (int i = 0; i < SF_MAX_ARENAS; i++) {
+    sf_arena *arena = get_arena(i);
+    if (arena == NULL) {
+      continue;
+    }
+    sf_arena *prev = arena_enter(arena);
+    add_arena_stats(&stats);
+    arena_leave(prev);
+  }
+  for (int i = 0; i < NUM_FREE_LISTS; i++) {
+    stats.free_total += stats.free_bytes[i];
+  }
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+    stats.quick_bytes += stats.quick_blocks[i] * (MIN_BLOCK_SIZE + i * 8);
+  }
+  if (stats.allocated_bytes != 0) {
+    stats.internal_fragmentation =
+        1.0 - (double)stats.requested_bytes / stats.allocated_bytes;
+  }
+  if (stats.free_total != 0) {
+    stats.external_fragmentation =
+        1.0 - (double)stats.largest_free / stats.free_total;
+  }
+  huge_stats(&stats.huge_blocks, &stats.huge_bytes);
+  return stats;
+}
@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE
+#include "std_api.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "huge.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+#include "slab.h"
+
+static pthread_once_t std_once = PTHREAD_ONCE_INIT;
+
+static void std_setup() {
+  sf_use_mmap_provider(0);
+  sf_set_min_alignment(STD_ALIGN);
+}
+
+/*
+ * Get the heap ready for the std_* functions, once. pthread_once() does not
+ * allocate.
+ */
+void std_init() { pthread_once(&std_once, std_setup); }
+
+/*
+ * Aligned allocation shared by the memalign() family.
+ */
+static void *std_alloc_aligned(size_t align, size_t size) {
+  std_init();
+  if (size == 0) size = 1;
+  // every payload is STD_ALIGN byte aligned already
+  void *pp = (align <= STD_ALIGN) ? sf_malloc(size) : sf_memalign(size, align);
+  if (pp == NULL) {
+    errno = ENOMEM;
+  }
+  return pp;
+}
+
+void *std_malloc(size_t size) {
+  std_init();
+  // a unique pointer, as the C library returns for 0 bytes
+  void *pp = sf_malloc(size ? size : 1);
+  if (pp == NULL) {
+    errno = ENOMEM;
+  }
+  return pp;
+}
+
+void std_free(void *pp) {
+  if (pp != NULL) {
+    sf_free(pp);
+  }
+}
+
+void *std_calloc(size_t nmemb, size_t size) {
+  std_init();
+  if (nmemb == 0 || size == 0) {
+    nmemb = size = 1;
+  }
+  void *pp = sf_calloc(nmemb, size);
+  if (pp == NULL) {
+    errno = ENOMEM;
+  }
+  return pp;
+}
+
+void *std_realloc(void *pp, size_t size) {
+  if (pp == NULL) {
+    return std_malloc(size);
+  }
+  if (size == 0) {
+    sf_free(pp);
+    return NULL;
+  }
+  void *new_pp = sf_realloc(pp, size);
+  if (new_pp == NULL) {
+    errno = ENOMEM;
+  }
+  return new_pp;
+}
+
+void *std_reallocarray(void *pp, size_t nmemb, size_t size) {
+  if (size != 0 && nmemb > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  return std_realloc(pp, nmemb * size);
+}
+
+int std_posix_memalign(void **memptr, size_t align, size_t size) {
+  if (align == 0 || align % sizeof(void *) != 0 ||
+      (align & (align - 1)) != 0) {
+    return EINVAL;
+  }
+  int saved = errno;
+  void *pp = std_alloc_aligned(align, size);
+  errno = saved;
+  if (pp == NULL) {
+    return ENOMEM;
+  }
+  *memptr = pp;
+  return 0;
+}
+
+void *std_aligned_alloc(size_t align, size_t size) {
+  if (align == 0 || (align & (align - 1)) != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return std_alloc_aligned(align, size);
+}
+
+void *std_memalign(size_t align, size_t size) {
+  return std_aligned_alloc(align, size);
+}
+
+void *std_valloc(size_t size) { return std_alloc_aligned(PAGE_SZ, size); }
+
+void *std_pvalloc(size_t size) {
+  return std_alloc_aligned(PAGE_SZ, (size + PAGE_SZ - 1) & ~(PAGE_SZ - 1));
+}
+
+void std_free_sized(void *pp, size_t size) {
+  if (pp != NULL) {
+    sf_free_sized(pp, size);
+  }
+}
+
+size_t std_malloc_usable_size(void *pp) {
+  if (pp == NULL) {
+    return 0;
+  }
+  if (is_slab_pointer(pp)) {
+    return slab_usable_size(pp);
+  }
+  if (is_huge_pointer(pp)) {
+    return huge_usable_size(pp);
+  }
+  // allocated blocks have no footer
+  return get_block_size(get_sf_block(pp)) - HEADER_SIZE;
+}
@@ -0,0 +1,256 @@
+#include "tcache.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "check.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "remote_free.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+#include "stats.h"
+
+typedef struct {
+  int length;
+  sf_block *first;
+} sf_tcache_bin;
+
+static sf_tcache_mode tcache_mode = SF_TCACHE_AUTO;
+static int tcache_active;  // set once a thread other than the initial one
+                           // allocates
+static __thread sf_tcache_bin tcache_bins[NUM_QUICK_LISTS];
+// the key of the calling thread's cache, kept in the blocks it holds
+#define TCACHE_KEY ((uint32_t)(uintptr_t)tcache_bins | 1)
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+static __thread int tcache_registered;
+
+/*
+ * Return the cached blocks of an exiting thread to the heap.
+ */
+static void tcache_thread_exit(void *arg) { tcache_flush(); }
+
+static void tcache_make_key() {
+  pthread_key_create(&tcache_key, tcache_thread_exit);
+}
+
+/*
+ * Make sure the cache of the calling thread is flushed when it exits.
+ */
+static void tcache_register() {
+  if (tcache_registered) {
+    return;
+  }
+  pthread_once(&tcache_key_once, tcache_make_key);
+  pthread_setspecific(tcache_key, tcache_bins);
+  tcache_registered = 1;
+}
+
+/*
+ * @return 1 if the calling thread should use its cache.
+ */
+static int tcache_enabled() {
+  if (tcache_mode != SF_TCACHE_AUTO) {
+    return tcache_mode == SF_TCACHE_ON;
+  }
+  if (__atomic_load_n(&tcache_active, __ATOMIC_RELAXED)) {
+    return 1;
+  }
+  if (!is_initial_thread()) {
+    __atomic_store_n(&tcache_active, 1, __ATOMIC_RELAXED);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Select whether threads cache small blocks. SF_TCACHE_AUTO, the default,
+ * turns the caches on once a second thread uses the allocator.
+ * Blocks the calling thread has cached go back to the heap when caches are
+ * turned off.
+ * Returns 0 if successful.
+ */
+int sf_set_thread_cache(sf_tcache_mode mode) {
+  if (mode != SF_TCACHE_AUTO && mode != SF_TCACHE_ON &&
+      mode != SF_TCACHE_OFF) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  tcache_mode = mode;
+  if (mode == SF_TCACHE_OFF) {
+    tcache_flush();
+  }
+  return 0;
+}
+
+/*
+ * @return The number of blocks of the given block size cached by the
+ * calling thread.
+ */
+int tcache_count(size_t size) {
+  int index = get_quick_list_head(size);
+  if (index < 0) {
+    return 0;
+  }
+  return tcache_bins[index].length;
+}
+
+static void tcache_push(sf_tcache_bin *bin, sf_block *block) {
+  HELD_BLOCK(block)->next = bin->first;
+  HELD_BLOCK(block)->key = TCACHE_KEY;
+  bin->first = block;
+  bin->length++;
+}
+
+static sf_block *tcache_pop(sf_tcache_bin *bin) {
+  sf_block *block = bin->first;
+  bin->first = HELD_BLOCK(block)->next;
+  bin->length--;
+  HELD_BLOCK(block)->key = 0;
+  return block;
+}
+
+/*
+ * Return count blocks of a bin to the arenas they came from. Blocks of
+ * other threads' arenas go onto their remote free stacks, the rest are
+ * freed locking each arena once for a run of its blocks.
+ */
+static void tcache_drain(sf_tcache_bin *bin, int count) {
+  sf_arena *held = NULL;
+  sf_arena *prev = NULL;
+  while (count-- > 0 && bin->first != NULL) {
+    sf_block *block = tcache_pop(bin);
+    sf_arena *arena = arena_of(block);
+    if (arena != thread_arena() &&
+        remote_free(arena, (char *)block + HEADER_SIZE) == 0) {
+      continue;
+    }
+    if (arena != held) {
+      if (held != NULL) {
+        arena_leave(prev);
+      }
+      prev = arena_enter(arena);
+      held = arena;
+    }
+    heap_free((char *)block + HEADER_SIZE);
+  }
+  if (held != NULL) {
+    arena_leave(prev);
+  }
+}
+
+/*
+ * Allocate a block for an empty bin, and take up to TCACHE_BATCH - 1 more
+ * blocks of the same size from the heap's quick and free lists for later
+ * allocations. The heap is only grown for the block that is returned.
+ */
+static void *tcache_refill(sf_tcache_bin *bin, size_t size) {
+  sf_arena *prev = arena_enter(thread_arena());
+  remote_drain();
+  void *pp = heap_malloc(size);
+  if (pp != NULL) {
+    size_t blocksize = calc_malloc_block_size(size);
+    for (int i = 1; i < TCACHE_BATCH; i++) {
+      sf_block *block = remove_quicklist(blocksize);
+      if (block == NULL) {
+        block = remove_free_list(blocksize);
+      }
+      if (block == NULL) {
+        break;
+      }
+      alloc_block(block, get_block_size(block), get_prev_alloc_bit(block));
+      stats_note_alloc(block, 0);
+      if (get_block_size(block) != blocksize) {
+        // the free list left no room for a split, the block belongs to
+        // another bin
+        heap_free((char *)block + HEADER_SIZE);
+        break;
+      }
+      tcache_push(bin, block);
+    }
+  }
+  arena_leave(prev);
+  tcache_register();
+  return pp;
+}
+
+/*
+ * Allocate from the calling thread's cache.
+ * Returns NULL if the cache is not used for this size, the caller then
+ * allocates from the heap.
+ */
+void *tcache_malloc(size_t size) {
+  if (!tcache_enabled()) {
+    return NULL;
+  }
+  int index = get_quick_list_head(calc_malloc_block_size(size));
+  if (index < 0) {
+    return NULL;
+  }
+  sf_tcache_bin *bin = &tcache_bins[index];
+  if (bin->first == NULL) {
+    return tcache_refill(bin, size);
+  }
+  sf_block *block = tcache_pop(bin);
+  return (char *)block + HEADER_SIZE;
+}
+
+/*
+ * Free into the calling thread's cache, draining half of the bin to the
+ * heap if it is full.
+ * Returns 0 if the block was cached, -1 if the caller should free it to
+ * the heap instead.
+ */
+int tcache_free(void *pp) {
+  if (pp == NULL || !tcache_enabled()) {
+    return -1;
+  }
+  if (check_pointer_unlocked(arena_of(pp), pp) != 0) {
+    return -1;
+  }
+  return tcache_free_block(get_sf_block(pp));
+}
+
+/*
+ * Free a block known to be allocated into the calling thread's cache.
+ * Returns 0 if the block was cached, -1 if the caller should free it to
+ * the heap instead.
+ */
+int tcache_free_block(sf_block *block) {
+  if (!tcache_enabled()) {
+    return -1;
+  }
+  int index = get_quick_list_head(get_block_size(block));
+  if (index < 0) {
+    return -1;
+  }
+  sf_tcache_bin *bin = &tcache_bins[index];
+  if (HELD_BLOCK(block)->key == TCACHE_KEY) {
+    // the key is set, this may be a double free
+    for (sf_block *cur = bin->first; cur != NULL; cur = HELD_BLOCK(cur)->next) {
+      if (cur == block) {
+        abort();
+      }
+    }
+  }
+  if (bin->length >= TCACHE_MAX) {
+    tcache_drain(bin, TCACHE_BATCH);
+  }
+  tcache_push(bin, block);
+  tcache_register();
+  return 0;
+}
+
+/*
+ * Return every block cached by the calling thread to the heap.
+ */
+void tcache_flush() {
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+    tcache_drain(&tcache_bins[i], tcache_bins[i].length);
+  }
+}
@@ -0,0 +1,193 @@
+#include "tlsf.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "counters.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "purge.h"
+#include "sfmm.h"
+#include "stats.h"
+
+sf_free_list_engine sf_engine = SF_SEGREGATED_LISTS;
+
+/*
+ * Select the free list engine.
+ * The engine can only be changed before the heap is initialized.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if unsuccessful.
+ */
+int sf_set_free_list_engine(sf_free_list_engine engine) {
+  if (heap_start() != heap_end()) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  if (engine != SF_SEGREGATED_LISTS && engine != SF_TLSF) {
+    sf_errno = EINVAL;
+    return -1;
+  }
+  sf_engine = engine;
+  return 0;
+}
+
+/*
+ * Initialize the TLSF lists with dummy blocks and clear the bitmaps.
+ * Returns 0 if successful.
+ */
+int tlsf_init() {
+  sf_tlsf_fl_bitmap = 0;
+  for (int fl = 0; fl < TLSF_FL_COUNT; fl++) {
+    sf_tlsf_sl_bitmap[fl] = 0;
+    for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+      set_block_next(&sf_tlsf_heads[fl][sl], &sf_tlsf_heads[fl][sl]);
+      set_block_prev(&sf_tlsf_heads[fl][sl], &sf_tlsf_heads[fl][sl]);
+    }
+  }
+  return 0;
+}
+
+/*
+ * Map a block size to its first and second level indices.
+ */
+void tlsf_mapping(size_t size, int *fl, int *sl) {
+  if (size < TLSF_SMALL_BLOCK) {
+    // small blocks get one list per 8 bytes
+    *fl = 0;
+    *sl = size >> TLSF_ALIGN_LOG2;
+    return;
+  }
+  int log2 = 63 - __builtin_clzl(size);
+  *sl = (size >> (log2 - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+  *fl = log2 - TLSF_FL_SHIFT;
+}
+
+/*
+ * Insert a free block at the head of its TLSF list.
+ * Returns the dummy head of the list.
+ */
+sf_block *tlsf_insert(sf_block *block) {
+  int fl, sl;
+  tlsf_mapping(get_block_size(block), &fl, &sl);
+  sf_block *head = &sf_tlsf_heads[fl][sl];
+  set_block_next(block, block_next(head));
+  set_block_prev(block, head);
+  set_block_prev(block_next(head), block);
+  set_block_next(head, block);
+  sf_tlsf_fl_bitmap |= 1UL << fl;
+  sf_tlsf_sl_bitmap[fl] |= 1U << sl;
+  return head;
+}
+
+/*
+ * Unlink a free block from its TLSF list, clearing the bitmap bits of the
+ * list if it became empty.
+ * Returns the block.
+ */
+sf_block *tlsf_remove_block(sf_block *block) {
+  int fl, sl;
+  tlsf_mapping(get_block_size(block), &fl, &sl);
+  sf_block *next = block_next(block);
+  sf_block *prev = block_prev(block);
+  set_block_prev(next, prev);
+  set_block_next(prev, next);
+  set_block_next(block, NULL);
+  set_block_prev(block, NULL);
+  sf_block *head = &sf_tlsf_heads[fl][sl];
+  if (block_next(head) == head) {
+    sf_tlsf_sl_bitmap[fl] &= ~(1U << sl);
+    if (sf_tlsf_sl_bitmap[fl] == 0) {
+      sf_tlsf_fl_bitmap &= ~(1UL << fl);
+    }
+  }
+  return block;
+}
+
+/*
+ * Find a free block of at least size bytes.
+ * The size is rounded up to the next list boundary so that every block in
+ * the list found is large enough, the first block of that list is returned
+ * without unlinking it.
+ * If no such list exists, the first TLSF_FALLBACK_SCAN blocks of the list
+ * the size itself maps to are checked before giving up, so a block that fits
+ * but shares a list with smaller blocks does not force the heap to grow.
+ * Returns NULL if no large enough block was found.
+ */
+sf_block *tlsf_find_fit(size_t size) {
+  sf_block *block = tlsf_find_list(size);
+  if (block != NULL) {
+    return block;
+  }
+  int fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  if (fl >= TLSF_FL_COUNT) {
+    return NULL;
+  }
+  sf_block *head = &sf_tlsf_heads[fl][sl];
+  block = block_next(head);
+  for (int i = 0; i < TLSF_FALLBACK_SCAN && block != head; i++) {
+    SF_COUNT(SF_EV_WALK, size);
+    if (get_block_size(block) >= size) {
+      return block;
+    }
+    block = block_next(block);
+  }
+  return NULL;
+}
+
+/*
+ * Find the first block of the smallest non-empty list whose blocks are all
+ * at least size bytes.
+ * Returns NULL if there is no such list.
+ */
+sf_block *tlsf_find_list(size_t size) {
+  if (size >= TLSF_SMALL_BLOCK) {
+    int log2 = 63 - __builtin_clzl(size);
+    size += (1UL << (log2 - TLSF_SL_LOG2)) - 1;
+  }
+  int fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  if (fl >= TLSF_FL_COUNT) {
+    return NULL;
+  }
+  // search the remaining lists of this first level
+  uint32_t sl_map = sf_tlsf_sl_bitmap[fl] & (~0U << sl);
+  if (sl_map == 0) {
+    // otherwise take the smallest non-empty list of a larger first level
+    uint64_t fl_map = (fl + 1 < 64) ? sf_tlsf_fl_bitmap & (~0UL << (fl + 1)) : 0;
+    if (fl_map == 0) {
+      return NULL;
+    }
+    fl = __builtin_ctzl(fl_map);
+    sl_map = sf_tlsf_sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+  return block_next(&sf_tlsf_heads[fl][sl]);
+}
+
+/*
+ * Remove a block of at least size bytes from the TLSF lists.
+ * If the block found is large enough to be split without leaving a splinter,
+ * the remainder is returned to the free lists.
+ * Returns NULL if there is no large enough block.
+ */
+sf_block *tlsf_remove_free_list(size_t size) {
+  sf_block *block = tlsf_find_fit(size);
+  if (block == NULL) {
+    SF_COUNT(SF_EV_MISS, size);
+    return NULL;
+  }
+  SF_COUNT_FIT(get_block_size(block), size);
+  purge_note_remove(block);
+  stats_note_remove(block);
+  tlsf_remove_block(block);
+  sf_block *remainder = split_free_block(block, size);
+  if (remainder != NULL) {
+    purge_note_insert(remainder);
+    stats_note_insert(remainder);
+    tlsf_insert(remainder);
+  }
+  return block;
+}
@@ -0,0 +1,601 @@
+#define _GNU_SOURCE
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sf_thread.h"
+#include "sfmm.h"
+
+#define RING_FREE 0
+#define RING_OWNED 1
+#define RING_EXITED 2
+// the ring of a thread that could not get one, so it does not try again
+#define RING_NONE ((sf_trace_ring *)&ring_none)
+
+typedef struct {
+  uint64_t head;   // next slot the owning thread writes
+  uint64_t tail;   // next slot the flusher reads
+  int state;       // RING_*
+  uint16_t thread;
+  sf_trace_raw slots[SF_TRACE_RING_SLOTS];
+} sf_trace_ring;
+
+/* A raw event drained from the ring of a thread. */
+typedef struct {
+  sf_trace_raw raw;
+  uint16_t thread;
+} sf_trace_pending;
+
+int sf_trace_on;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static sf_trace_ring *rings[SF_TRACE_MAX_THREADS];
+static int ring_count;  // slots of rings taken, at most SF_TRACE_MAX_THREADS
+static char ring_none;
+static uint64_t trace_epoch;  // CLOCK_MONOTONIC at sf_trace_start
+static uint64_t tick_epoch;   // trace_ticks() at sf_trace_start
+static uint64_t dropped;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static __thread sf_trace_ring *thread_ring;
+static __thread int thread_busy;  // set while recording or exiting
+
+// state of the flusher, which alone touches it while recording
+static pthread_t flusher;
+static int flusher_stop;
+static int trace_fd = -1;
+static sf_trace_pending *pending;  // drained but not yet written
+static size_t pending_count;
+static size_t pending_capacity;
+static sf_trace_pending *merged;  // where runs of pending are merged to
+static size_t merged_capacity;
+static size_t run_starts[SF_TRACE_MAX_THREADS + 2];
+static uint64_t *id_addrs;  // open addressing table from addresses to ids
+static uint32_t *id_values;
+static size_t id_capacity;
+static size_t id_count;
+static uint32_t next_id;
+static sf_trace_event out[1024];
+static size_t out_count;
+static double tick_ns;  // nanoseconds per tick, measured as the trace runs
+static uint64_t last_time;
+
+static uint64_t trace_clock() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Timestamp of an event. The time stamp counter of x86-64 is read in a few
+ * cycles and is in step across cores on the processors with an invariant
+ * one; the flusher turns its ticks into nanoseconds.
+ */
+static uint64_t trace_ticks() {
+#ifdef __x86_64__
+  return __builtin_ia32_rdtsc();
+#else
+  return trace_clock();
+#endif
+}
+
+/*
+ * Mark the ring of an exiting thread for reuse once it is drained. Events
+ * of later destructors of the thread are dropped.
+ */
+static void ring_thread_exit(void *arg) {
+  sf_trace_ring *ring = arg;
+  thread_busy = 1;
+  __atomic_store_n(&ring->state, RING_EXITED, __ATOMIC_RELEASE);
+}
+
+static void ring_make_key() { pthread_key_create(&ring_key, ring_thread_exit); }
+
+/*
+ * Give the calling thread a ring, reusing that of an exited thread if one
+ * was drained. A thread that gets none is given RING_NONE for good.
+ * @return The ring, or NULL if all slots are taken or none could be mapped.
+ */
+static sf_trace_ring *ring_attach() {
+  sf_trace_ring *ring = NULL;
+  int count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < count && i < SF_TRACE_MAX_THREADS && ring == NULL;
+       i++) {
+    sf_trace_ring *cur = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+    int expected = RING_FREE;
+    if (cur != NULL &&
+        __atomic_compare_exchange_n(&cur->state, &expected, RING_OWNED, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      ring = cur;
+    }
+  }
+  if (ring == NULL) {
+    int index = __atomic_load_n(&ring_count, __ATOMIC_RELAXED);
+    do {
+      if (index >= SF_TRACE_MAX_THREADS) {
+        thread_ring = RING_NONE;
+        return NULL;
+      }
+    } while (!__atomic_compare_exchange_n(&ring_count, &index, index + 1, 1,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    ring = mmap(NULL, sizeof(sf_trace_ring), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ring == MAP_FAILED) {
+      // give the slot back unless a later one was taken, the flusher skips
+      // empty slots
+      int taken = index + 1;
+      __atomic_compare_exchange_n(&ring_count, &taken, index, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+      thread_ring = RING_NONE;
+      return NULL;
+    }
+    ring->thread = index;
+    ring->state = RING_OWNED;
+    __atomic_store_n(&rings[index], ring, __ATOMIC_RELEASE);
+  }
+  pthread_once(&ring_key_once, ring_make_key);
+  pthread_setspecific(ring_key, ring);
+  thread_ring = ring;
+  return ring;
+}
+
+/*
+ * Append an event to the calling thread's ring. pp is the block returned,
+ * or the block freed, old the block passed to sf_realloc.
+ */
+void trace_record(int op, void *pp, void *old, size_t size, size_t align) {
+  if (thread_busy) {
+    return;
+  }
+  // whatever the ring setup allocates is not the program's
+  thread_busy = 1;
+  sf_trace_ring *ring = (thread_ring != NULL) ? thread_ring : ring_attach();
+  if (ring == NULL || ring == RING_NONE) {
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    thread_busy = 0;
+    return;
+  }
+  uint64_t head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+      SF_TRACE_RING_SLOTS) {
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    thread_busy = 0;
+    return;
+  }
+  sf_trace_raw *raw = &ring->slots[head & (SF_TRACE_RING_SLOTS - 1)];
+  raw->time = trace_ticks();
+  raw->addr = (uintptr_t)pp;
+  raw->old = (uintptr_t)old;
+  raw->size = size;
+  raw->op = op;
+  raw->align_shift = (align != 0) ? __builtin_ctzll(align) : 0;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  thread_busy = 0;
+}
+
+/*
+ * Grow an array mapped outside the heap to hold at least needed elements.
+ * Returns 0 if successful, -1 otherwise.
+ */
+static int grow_mapping(void **array, size_t *capacity, size_t needed,
+                        size_t elem) {
+  if (needed <= *capacity) {
+    return 0;
+  }
+  size_t new_capacity = (*capacity == 0) ? 4096 : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  void *grown = (*array == NULL)
+                    ? mmap(NULL, new_capacity * elem, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                    : mremap(*array, *capacity * elem, new_capacity * elem,
+                             MREMAP_MAYMOVE);
+  if (grown == MAP_FAILED) {
+    return -1;
+  }
+  *array = grown;
+  *capacity = new_capacity;
+  return 0;
+}
+
+static size_t id_slot(uint64_t addr) {
+  // addresses are multiples of 8, mix the rest
+  return (size_t)((addr >> 3) * 0x9E3779B97F4A7C15ull) & (id_capacity - 1);
+}
+
+/*
+ * Map addr to id, doubling the table when it gets half full.
+ * Returns 0 if successful, -1 if the table could not grow.
+ */
+static int id_put(uint64_t addr, uint32_t id) {
+  if (2 * (id_count + 1) > id_capacity) {
+    uint64_t *old_addrs = id_addrs;
+    uint32_t *old_values = id_values;
+    size_t old_capacity = id_capacity;
+    size_t capacity = (old_capacity == 0) ? 4096 : 2 * old_capacity;
+    uint64_t *addrs = mmap(NULL, capacity * sizeof(uint64_t),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1, 0);
+    uint32_t *values = mmap(NULL, capacity * sizeof(uint32_t),
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addrs == MAP_FAILED || values == MAP_FAILED) {
+      if (addrs != MAP_FAILED) {
+        munmap(addrs, capacity * sizeof(uint64_t));
+      }
+      if (values != MAP_FAILED) {
+        munmap(values, capacity * sizeof(uint32_t));
+      }
+      return -1;
+    }
+    id_addrs = addrs;
+    id_values = values;
+    id_capacity = capacity;
+    id_count = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_addrs[i] != 0) {
+        id_put(old_addrs[i], old_values[i]);
+      }
+    }
+    if (old_capacity != 0) {
+      munmap(old_addrs, old_capacity * sizeof(uint64_t));
+      munmap(old_values, old_capacity * sizeof(uint32_t));
+    }
+  }
+  size_t i = id_slot(addr);
+  while (id_addrs[i] != 0 && id_addrs[i] != addr) {
+    i = (i + 1) & (id_capacity - 1);
+  }
+  if (id_addrs[i] == 0) {
+    id_count++;
+  }
+  id_addrs[i] = addr;
+  id_values[i] = id;
+  return 0;
+}
+
+/*
+ * Remove addr from the table, shifting back the entries after it.
+ * Returns 0 with its id stored in id, -1 if it is not in the table.
+ */
+static int id_take(uint64_t addr, uint32_t *id) {
+  if (id_capacity == 0) {
+    return -1;
+  }
+  size_t i = id_slot(addr);
+  while (id_addrs[i] != addr) {
+    if (id_addrs[i] == 0) {
+      return -1;
+    }
+    i = (i + 1) & (id_capacity - 1);
+  }
+  *id = id_values[i];
+  size_t hole = i;
+  for (size_t j = (i + 1) & (id_capacity - 1); id_addrs[j] != 0;
+       j = (j + 1) & (id_capacity - 1)) {
+    size_t home = id_slot(id_addrs[j]);
+    // move entries whose home is not between the hole and their slot
+    if (((j - home) & (id_capacity - 1)) >= ((j - hole) & (id_capacity - 1))) {
+      id_addrs[hole] = id_addrs[j];
+      id_values[hole] = id_values[j];
+      hole = j;
+    }
+  }
+  id_addrs[hole] = 0;
+  id_count--;
+  return 0;
+}
+
+static void out_flush() {
+  char *buf = (char *)out;
+  size_t left = out_count * sizeof(sf_trace_event);
+  while (left > 0) {
+    ssize_t n = write(trace_fd, buf, left);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    buf += n;
+    left -= n;
+  }
+  out_count = 0;
+}
+
+/*
+ * Turn a raw event into an event with an object id and queue it for the
+ * file. Events about blocks that were not seen being allocated are dropped.
+ */
+static void emit(sf_trace_pending *p) {
+  sf_trace_raw *raw = &p->raw;
+  uint64_t time = (raw->time > tick_epoch)
+                      ? (uint64_t)((raw->time - tick_epoch) * tick_ns)
+                      : 0;
+  // the rate is refined as the trace runs, times must not go back
+  if (time < last_time) {
+    time = last_time;
+  }
+  last_time = time;
+  sf_trace_event event = {.time = time,
+                          .size = raw->size,
+                          .thread = p->thread,
+                          .op = raw->op,
+                          .align_shift = raw->align_shift};
+  uint32_t id;
+  switch (raw->op) {
+    case SF_TRACE_MALLOC:
+    case SF_TRACE_MEMALIGN:
+      if (raw->addr == 0) {
+        return;
+      }
+      // an object the flusher cannot follow is left out
+      if (id_put(raw->addr, next_id) != 0) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+      }
+      event.id = next_id++;
+      break;
+    case SF_TRACE_FREE:
+      if (id_take(raw->addr, &id) != 0) {
+        return;
+      }
+      event.id = id;
+      event.size = 0;
+      break;
+    case SF_TRACE_REALLOC:
+      if (raw->addr == 0 && raw->size != 0) {
+        return;  // failed, the old block is still there
+      }
+      if (raw->old == 0 || id_take(raw->old, &id) != 0) {
+        // an object the trace does not know yet
+        if (raw->addr == 0) {
+          return;
+        }
+        event.op = SF_TRACE_MALLOC;
+        id = next_id;
+      }
+      event.id = id;
+      if (raw->addr == 0) {
+        event.op = SF_TRACE_FREE;
+        event.size = 0;
+        break;
+      }
+      if (id_put(raw->addr, id) != 0) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        if (event.op == SF_TRACE_MALLOC) {
+          return;
+        }
+        // the object cannot be followed past here, end it
+        event.op = SF_TRACE_FREE;
+        event.size = 0;
+        break;
+      }
+      if (event.op == SF_TRACE_MALLOC) {
+        next_id++;
+      }
+      break;
+    default:
+      return;
+  }
+  out[out_count++] = event;
+  if (out_count == sizeof(out) / sizeof(out[0])) {
+    out_flush();
+  }
+}
+
+static int is_before(sf_trace_pending *x, sf_trace_pending *y) {
+  return x->raw.time < y->raw.time ||
+         (x->raw.time == y->raw.time && x->thread < y->thread);
+}
+
+/*
+ * Sort pending, made of runs that are sorted already, the events of one
+ * thread being in order, by merging the runs two by two.
+ */
+static void merge_runs(int runs) {
+  while (runs > 1) {
+    int merged_runs = 0;
+    for (int r = 0; r < runs; r += 2) {
+      size_t lo = run_starts[r];
+      size_t mid = run_starts[(r + 1 < runs) ? r + 1 : runs];
+      size_t hi = run_starts[(r + 2 < runs) ? r + 2 : runs];
+      size_t i = lo, j = mid, k = lo;
+      while (i < mid && j < hi) {
+        merged[k++] = is_before(&pending[j], &pending[i]) ? pending[j++]
+                                                          : pending[i++];
+      }
+      memcpy(&merged[k], &pending[i], (mid - i) * sizeof(*pending));
+      k += mid - i;
+      memcpy(&merged[k], &pending[j], (hi - j) * sizeof(*pending));
+      run_starts[merged_runs++] = lo;
+    }
+    run_starts[merged_runs] = pending_count;
+    runs = merged_runs;
+    sf_trace_pending *swap = pending;
+    pending = merged;
+    merged = swap;
+    size_t capacity = pending_capacity;
+    pending_capacity = merged_capacity;
+    merged_capacity = capacity;
+  }
+}
+
+/*
+ * Empty the rings and write the events recorded before cutoff, in the
+ * order they were recorded.
+ * @return The most events found in one ring.
+ */
+static size_t trace_drain(uint64_t cutoff) {
+  size_t fullest = 0;
+  int runs = 0;
+  if (pending_count > 0) {
+    run_starts[runs++] = 0;  // what the last drain left
+  }
+  int count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+  if (count > SF_TRACE_MAX_THREADS) {
+    count = SF_TRACE_MAX_THREADS;
+  }
+  for (int i = 0; i < count; i++) {
+    sf_trace_ring *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+    if (ring == NULL) {
+      continue;
+    }
+    int state = __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+    if (head - tail > fullest) {
+      fullest = head - tail;
+    }
+    size_t needed = pending_count + (head - tail);
+    if (head != tail &&
+        grow_mapping((void **)&pending, &pending_capacity, needed,
+                     sizeof(sf_trace_pending)) == 0 &&
+        grow_mapping((void **)&merged, &merged_capacity, needed,
+                     sizeof(sf_trace_pending)) == 0) {
+      run_starts[runs++] = pending_count;
+      for (; tail != head; tail++) {
+        sf_trace_pending *p = &pending[pending_count++];
+        p->raw = ring->slots[tail & (SF_TRACE_RING_SLOTS - 1)];
+        p->thread = ring->thread;
+      }
+      __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (state == RING_EXITED && head == tail) {
+      // the thread is gone and wrote nothing after it said so
+      __atomic_store_n(&ring->state, RING_FREE, __ATOMIC_RELEASE);
+    }
+  }
+  run_starts[runs] = pending_count;
+  merge_runs(runs);
+  size_t n = 0;
+  while (n < pending_count && pending[n].raw.time < cutoff) {
+    emit(&pending[n++]);
+  }
+  memmove(pending, pending + n, (pending_count - n) * sizeof(*pending));
+  pending_count -= n;
+  out_flush();
+  return fullest;
+}
+
+static void *trace_flusher(void *arg) {
+  thread_busy = 1;
+  struct timespec period = {0, SF_TRACE_FLUSH_MS * 1000000L};
+  struct timespec short_period = {0, 1000000L};
+  size_t fullest = 0;
+  while (!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE)) {
+    // come back sooner while a thread fills its ring faster than that
+    nanosleep((fullest > SF_TRACE_RING_SLOTS / 4) ? &short_period : &period,
+              NULL);
+    uint64_t ticks = trace_ticks();
+    uint64_t ns = trace_clock();
+    if (ticks > tick_epoch && ns > trace_epoch) {
+      tick_ns = (double)(ns - trace_epoch) / (ticks - tick_epoch);
+    }
+    uint64_t settle = SF_TRACE_SETTLE_MS * 1000000 / tick_ns;
+    fullest =
+        trace_drain((ticks - tick_epoch > settle) ? ticks - settle : 0);
+  }
+  trace_drain(UINT64_MAX);
+  return NULL;
+}
+
+/*
+ * Start recording the allocation calls of all threads to a new file at
+ * path.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if already recording, or to the
+ * error of the file or the flusher thread.
+ */
+int sf_trace_start(const char *path) {
+  pthread_mutex_lock(&trace_lock);
+  if (trace_fd >= 0) {
+    pthread_mutex_unlock(&trace_lock);
+    sf_errno = EINVAL;
+    return -1;
+  }
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  sf_trace_header header = {SF_TRACE_MAGIC, SF_TRACE_VERSION};
+  if (fd < 0 || write(fd, &header, sizeof(header)) != sizeof(header)) {
+    int error = errno;
+    if (fd >= 0) {
+      close(fd);
+    }
+    pthread_mutex_unlock(&trace_lock);
+    sf_errno = error;
+    return -1;
+  }
+  // events left behind by threads that raced with the last stop
+  int count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < count && i < SF_TRACE_MAX_THREADS; i++) {
+    sf_trace_ring *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+    if (ring != NULL) {
+      __atomic_store_n(&ring->tail,
+                       __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                       __ATOMIC_RELEASE);
+    }
+  }
+  if (id_capacity != 0) {
+    memset(id_addrs, 0, id_capacity * sizeof(uint64_t));
+  }
+  id_count = 0;
+  next_id = 0;
+  pending_count = 0;
+  trace_fd = fd;
+  trace_epoch = trace_clock();
+  tick_epoch = trace_ticks();
+  tick_ns = 1;
+  last_time = 0;
+  __atomic_store_n(&dropped, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&flusher_stop, 0, __ATOMIC_RELEASE);
+  int error = pthread_create(&flusher, NULL, trace_flusher, NULL);
+  if (error != 0) {
+    close(fd);
+    trace_fd = -1;
+    pthread_mutex_unlock(&trace_lock);
+    sf_errno = error;
+    return -1;
+  }
+  __atomic_store_n(&sf_trace_on, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&trace_lock);
+  return 0;
+}
+
+/*
+ * Stop recording, and write out and close the trace.
+ * Returns 0 if successful.
+ * Returns -1 and sets sf_errno to EINVAL if not recording.
+ */
+int sf_trace_stop() {
+  pthread_mutex_lock(&trace_lock);
+  if (trace_fd < 0) {
+    pthread_mutex_unlock(&trace_lock);
+    sf_errno = EINVAL;
+    return -1;
+  }
+  __atomic_store_n(&sf_trace_on, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&flusher_stop, 1, __ATOMIC_RELEASE);
+  pthread_join(flusher, NULL);
+  close(trace_fd);
+  trace_fd = -1;
+  pthread_mutex_unlock(&trace_lock);
+  return 0;
+}
+
+/*
+ * @return The number of events dropped since recording started because a
+ * ring was full or could not be mapped, or the table of live objects could
+ * not grow.
+ */
+uint64_t sf_trace_dropped() {
+  return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,119 @@
+#define _DEFAULT_SOURCE
+#include "zero.h"
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+
+/*
+ * Move the frontier after the heap grew. Pages from a provider that does
+ * not promise zeroed pages are never fresh.
+ */
+void zero_note_grow() {
+  if (!sf_provider->zeroed) {
+    sf_arena_cur->zero_from = heap_end();
+  } else if (sf_arena_cur->zero_from == NULL) {
+    sf_arena_cur->zero_from = heap_start();
+  }
+}
+
+/*
+ * Record the fresh part of a block that is being allocated past the
+ * frontier, and move the frontier to its end. The footer of the free block
+ * it was carved from may be its last word, so that is left out.
+ */
+void zero_note_alloc(sf_block *block) {
+  char *payload = (char *)block + HEADER_SIZE;
+  char *fresh = sf_arena_cur->zero_from + ZERO_SKIP;
+  char *end = (char *)get_block_end(block);
+  sf_arena_cur->zero_fresh.start = (fresh > payload) ? fresh : payload;
+  sf_arena_cur->zero_fresh.end = end - FOOTER_SIZE;
+  sf_arena_cur->zero_from = end;
+}
+
+/*
+ * Move the frontier to end, the old end of a block that was split past the
+ * frontier and whose tail merged with the free block after it. The header
+ * and links of that block and the footers of the split stay behind in the
+ * merged block, within ZERO_SKIP bytes of end.
+ */
+void zero_note_split(char *end) {
+  if (end > sf_arena_cur->zero_from) {
+    sf_arena_cur->zero_from = end;
+  }
+}
+
+/*
+ * Record the purged pages of a block that is leaving the free lists.
+ */
+void zero_note_purged(char *start, char *end) {
+  sf_arena_cur->zero_purged.start = start;
+  sf_arena_cur->zero_purged.end = end;
+}
+
+/*
+ * Forget what was recorded about the last blocks allocated.
+ */
+void zero_note_reset() {
+  sf_arena_cur->zero_fresh.start = sf_arena_cur->zero_fresh.end = NULL;
+  sf_arena_cur->zero_purged.start = sf_arena_cur->zero_purged.end = NULL;
+}
+
+/*
+ * Clear the bytes from start to end.
+ */
+static void zero_fill(char *start, char *end) {
+#ifdef __SSE2__
+  if (end - start >= ZERO_STREAM_MIN) {
+    // the head and tail up to 64 byte boundaries go through the cache
+    char *first = (char *)(((uintptr_t)start + 63) & ~(uintptr_t)63);
+    char *last = (char *)((uintptr_t)end & ~(uintptr_t)63);
+    memset(start, 0, first - start);
+    __m128i zero = _mm_setzero_si128();
+    for (char *p = first; p < last; p += 64) {
+      _mm_stream_si128((__m128i *)p, zero);
+      _mm_stream_si128((__m128i *)(p + 16), zero);
+      _mm_stream_si128((__m128i *)(p + 32), zero);
+      _mm_stream_si128((__m128i *)(p + 48), zero);
+    }
+    _mm_sfence();
+    memset(last, 0, end - last);
+    return;
+  }
+#endif
+  memset(start, 0, end - start);
+}
+
+/*
+ * Clear the first size bytes of the payload pp of a block that was just
+ * allocated, skipping the parts recorded as zero since zero_note_reset().
+ */
+void zero_payload(void *pp, size_t size) {
+  char *cur = pp;
+  char *end = cur + size;
+  sf_zero_range ranges[2] = {sf_arena_cur->zero_fresh,
+                             sf_arena_cur->zero_purged};
+  if (ranges[1].start < ranges[0].start) {
+    ranges[0] = sf_arena_cur->zero_purged;
+    ranges[1] = sf_arena_cur->zero_fresh;
+  }
+  for (int i = 0; i < 2 && cur < end; i++) {
+    if (ranges[i].start >= ranges[i].end || ranges[i].end <= cur) {
+      continue;
+    }
+    if (ranges[i].start > cur) {
+      zero_fill(cur, (ranges[i].start < end) ? ranges[i].start : end);
+    }
+    cur = ranges[i].end;
+  }
+  if (cur < end) {
+    zero_fill(cur, end);
+  }
+}
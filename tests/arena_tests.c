@@ -0,0 +1,139 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "mem_library.h"
+#include "remote_free.h"
+#include "sfmm.h"
+#include "tcache.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+static void *malloc_in_thread(void *arg) { return sf_malloc((uintptr_t)arg); }
+
+static int quick_list_length(sf_arena *arena) {
+  sf_arena *prev = arena_enter(arena);
+  int length = 0;
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+    length += sf_quick_lists[i].length;
+  }
+  arena_leave(prev);
+  return length;
+}
+
+Test(sfmm_arena_suite, threads_get_own_arenas, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(4);
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  void *x = sf_malloc(100);
+  cr_assert_eq(arena_of(x)->index, 0, "initial thread is not in arena 0");
+  void *seen[4];
+  for (int t = 0; t < 3; t++) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, malloc_in_thread, (void *)(uintptr_t)100);
+    pthread_join(thread, &seen[t]);
+    cr_assert_not_null(seen[t], "malloc in thread %d failed", t);
+    cr_assert_eq(arena_of(seen[t])->index, t + 1, "thread %d is in arena %d",
+                 t, arena_of(seen[t])->index);
+  }
+  // the next thread wraps around to arena 0
+  pthread_t thread;
+  pthread_create(&thread, NULL, malloc_in_thread, (void *)(uintptr_t)100);
+  pthread_join(thread, &seen[3]);
+  cr_assert_eq(arena_of(seen[3])->index, 0, "arenas did not wrap around");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_arena_suite, free_returns_to_owner, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(2);
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  sf_malloc(8);
+  pthread_t thread;
+  void *x;
+  pthread_create(&thread, NULL, malloc_in_thread, (void *)(uintptr_t)100);
+  pthread_join(thread, &x);
+  sf_arena *owner = arena_of(x);
+  cr_assert_eq(owner->index, 1, "block is not in arena 1");
+  // freed by the initial thread, which allocates from arena 0
+  sf_free(x);
+  sf_arena *prev = arena_enter(owner);
+  remote_drain();
+  arena_leave(prev);
+  cr_assert_eq(quick_list_length(owner), 1, "block is not in its arena");
+  cr_assert_eq(quick_list_length(get_arena(0)), 0, "block went to arena 0");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_arena_suite, single_arena, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(1);
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  pthread_t thread;
+  void *x;
+  pthread_create(&thread, NULL, malloc_in_thread, (void *)(uintptr_t)100);
+  pthread_join(thread, &x);
+  cr_assert_eq(arena_of(x)->index, 0, "block is not in arena 0");
+  cr_assert_null(get_arena(1), "arena 1 was created");
+}
+
+Test(sfmm_arena_suite, invalid_arena_count, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_arena_count(0), -1, "count 0 was accepted");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+  sf_errno = 0;
+  cr_assert_eq(sf_set_arena_count(SF_MAX_ARENAS + 1), -1,
+               "count above maximum was accepted");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
+
+#define STRESS_THREADS 8
+#define STRESS_LIVE 16
+#define STRESS_ROUNDS 20000
+
+static void *stress(void *arg) {
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  unsigned char *live[STRESS_LIVE] = {NULL};
+  size_t sizes[STRESS_LIVE] = {0};
+  for (int round = 0; round < STRESS_ROUNDS; round++) {
+    int i = rand_r(&seed) % STRESS_LIVE;
+    if (live[i] != NULL) {
+      for (size_t j = 0; j < sizes[i]; j++) {
+        if (live[i][j] != (unsigned char)(i + (uintptr_t)arg)) {
+          return NULL;
+        }
+      }
+      sf_free(live[i]);
+    }
+    sizes[i] = 1 + rand_r(&seed) % 1000;
+    live[i] = sf_malloc(sizes[i]);
+    if (live[i] == NULL) {
+      return NULL;
+    }
+    memset(live[i], (unsigned char)(i + (uintptr_t)arg), sizes[i]);
+  }
+  for (int i = 0; i < STRESS_LIVE; i++) {
+    sf_free(live[i]);
+  }
+  return arg;
+}
+
+Test(sfmm_arena_suite, concurrent_arenas, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(STRESS_THREADS);
+  pthread_t threads[STRESS_THREADS];
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    pthread_create(&threads[t], NULL, stress, (void *)(t + 1));
+  }
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    void *result;
+    pthread_join(threads[t], &result);
+    cr_assert_eq(result, (void *)(t + 1), "thread %ld failed", (long)t);
+  }
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
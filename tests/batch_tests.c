@@ -0,0 +1,131 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "batch.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "slab.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_batch_suite, carves_back_to_back, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *out[10];
+  cr_assert_eq(sf_malloc_batch(100, 10, out), 10, "batch is short");
+  for (int i = 0; i < 10; i++) {
+    assert_allocated_block(out[i], block);
+    if (i > 0) {
+      cr_assert_eq((char *)out[i] - (char *)out[i - 1], block,
+                   "blocks are not back to back");
+    }
+  }
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, quick_list_first, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *x = sf_malloc(100);
+  void *y = sf_malloc(100);
+  sf_malloc(sizeof(double));
+  sf_free(x);
+  sf_free(y);
+  assert_quick_list_block_count(block, 2);
+  void *out[4];
+  cr_assert_eq(sf_malloc_batch(100, 4, out), 4, "batch is short");
+  // quick lists are LIFO
+  assert_pntr_equal(out[0], y);
+  assert_pntr_equal(out[1], x);
+  assert_quick_list_block_count(block, 0);
+  cr_assert_eq((char *)out[3] - (char *)out[2], block,
+               "blocks are not back to back");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, free_merges_runs, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *out[10];
+  cr_assert_eq(sf_malloc_batch(100, 10, out), 10, "batch is short");
+  sf_malloc(sizeof(double));
+  // in no particular order, with a NULL that is skipped
+  void *ptrs[11] = {out[3], out[9], NULL, out[0], out[5], out[1],
+                    out[7], out[2], out[8], out[4], out[6]};
+  sf_free_batch(ptrs, 11);
+  assert_quick_list_block_count(0, 0);
+  assert_free_block_count(10 * block, 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, free_coalesces_neighbours, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *out[4];
+  cr_assert_eq(sf_malloc_batch(100, 4, out), 4, "batch is short");
+  sf_malloc(sizeof(double));
+  sf_free(out[0]);
+  sf_free(out[3]);
+  // the quick listed blocks stay out of the batch's run
+  void *ptrs[2] = {out[2], out[1]};
+  sf_free_batch(ptrs, 2);
+  assert_free_block_count(2 * block, 1);
+  assert_quick_list_block_count(block, 2);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, slab_words, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(16);
+  void *out[600];
+  cr_assert_eq(sf_malloc_batch(16, 600, out), 600, "batch is short");
+  for (int i = 0; i < 600; i++) {
+    cr_assert(is_slab_pointer(out[i]), "object is not in a slab");
+    for (int j = 0; j < i; j++) {
+      assert_pntr_not_equal(out[i], out[j]);
+    }
+  }
+  sf_slab *first = get_slab(out[0]);
+  cr_assert_eq(first->used, first->slots, "first slab is not full");
+  sf_free_batch(out, 600);
+  cr_assert_eq(get_slab(out[599])->used, 0, "slots were not freed");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, huge_blocks, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *out[3];
+  cr_assert_eq(sf_malloc_batch(2 << 20, 3, out), 3, "batch is short");
+  for (int i = 0; i < 3; i++) {
+    cr_assert(is_huge_pointer(out[i]), "block is not mapped");
+  }
+  void *ptrs[3] = {out[0], out[1], out[2]};
+  sf_free_batch(ptrs, 3);
+  for (int i = 0; i < 3; i++) {
+    cr_assert(!is_huge_pointer(out[i]), "block was not unmapped");
+  }
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_batch_suite, out_of_memory, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  // the sfutil heap is far smaller than this
+  void *out[64];
+  size_t count = sf_malloc_batch(PAGE_SZ, 64, out);
+  cr_assert_lt(count, 64, "batch did not run out of memory");
+  cr_assert_gt(count, 0, "nothing was allocated");
+  cr_assert_eq(ENOMEM, sf_errno, "sf_errno is not ENOMEM");
+  for (size_t i = 0; i < count; i++) {
+    assert_allocated_block(out[i], PAGE_SZ + 8);
+  }
+}
+
+Test(sfmm_batch_suite, free_duplicate, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  void *out[2];
+  sf_malloc_batch(100, 2, out);
+  void *ptrs[3] = {out[0], out[1], out[0]};
+  sf_free_batch(ptrs, 3);
+}
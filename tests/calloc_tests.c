@@ -0,0 +1,132 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <string.h>
+
+#include "mem_library.h"
+#include "page_provider.h"
+#include "purge.h"
+#include "sfmm.h"
+#include "zero.h"
+#define TEST_TIMEOUT 15
+
+static int is_zero(char *pp, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (pp[i] != 0) return 0;
+  }
+  return 1;
+}
+
+Test(sfmm_calloc_suite, zeroes_reused_block, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  char *x = sf_malloc(400);
+  sf_malloc(1);
+  memset(x, 0xff, 400);
+  sf_free(x);
+  char *y = sf_calloc(100, 4);
+  cr_assert_eq(x, y, "freed block was not reused");
+  cr_assert(is_zero(y, 400), "payload is not zero");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_calloc_suite, overflow, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_null(sf_calloc(SIZE_MAX / 2, 4), "overflowing calloc succeeded");
+  cr_assert_eq(ENOMEM, sf_errno, "sf_errno is not ENOMEM");
+  sf_errno = 0;
+  cr_assert_null(sf_calloc(0, 4), "calloc of 0 elements is not NULL");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_calloc_suite, skips_fresh_pages, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  sf_malloc(8);
+  size_t size = 64 * PAGE_SZ;
+  char *x = sf_calloc(1, size);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert(is_zero(x, size), "payload is not zero");
+  // only the metadata left at the start of the block needed clearing
+  cr_assert_leq(sf_arena_cur->zero_fresh.start, x + ZERO_SKIP,
+                "fresh memory was not recognized");
+  cr_assert_geq(sf_arena_cur->zero_fresh.end, x + size - FOOTER_SIZE,
+                "fresh memory was not recognized");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_calloc_suite, clears_untrusted_pages, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  // sfutil pages are not promised to be zero
+  char *x = sf_calloc(1, 2 * PAGE_SZ);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert(is_zero(x, 2 * PAGE_SZ), "payload is not zero");
+  cr_assert_geq(sf_arena_cur->zero_fresh.start, sf_arena_cur->zero_fresh.end,
+                "sfutil memory was taken as fresh");
+}
+
+Test(sfmm_calloc_suite, skips_purged_pages, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  sf_set_purge_decay(-1);
+  sf_set_trim_threshold(0);
+  size_t size = 8 * PAGE_SZ;
+  char *x = sf_malloc(size);
+  sf_malloc(8);
+  memset(x, 0xff, size);
+  sf_free(x);
+  cr_assert_eq(sf_trim(0), 1, "nothing was purged");
+  char *y = sf_calloc(1, size);
+  cr_assert_eq(x, y, "purged block was not reused");
+  cr_assert(is_zero(y, size), "payload is not zero");
+  cr_assert_gt(sf_arena_cur->zero_purged.end - sf_arena_cur->zero_purged.start,
+               0, "purged pages were not recognized");
+}
+
+Test(sfmm_calloc_suite, clears_freed_fresh_block, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  sf_set_purge_decay(-1);
+  sf_set_trim_threshold(0);
+  // a block freed next to the fresh wilderness leaves old data behind
+  char *x = sf_malloc(1000);
+  memset(x, 0xff, 1000);
+  sf_free(x);
+  char *y = sf_calloc(1, 3000);
+  cr_assert_not_null(y, "y is NULL!");
+  cr_assert(is_zero(y, 3000), "payload is not zero");
+  sf_free(y);
+  // the same after the heap grew behind a free wilderness
+  x = sf_malloc(PAGE_SZ);
+  memset(x, 0xff, PAGE_SZ);
+  sf_free(x);
+  y = sf_calloc(1, 4 * PAGE_SZ);
+  cr_assert(is_zero(y, 4 * PAGE_SZ), "payload is not zero");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_calloc_suite, clears_after_memalign, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  // memalign grows the heap and splits the new block twice, the tail merges
+  // with the remainder of the first split
+  size_t sizes[] = {568, 24, 1000, 200};
+  for (int i = 0; i < 4; i++) {
+    for (size_t align = 16; align < PAGE_SZ; align *= 2) {
+      cr_assert_not_null(sf_memalign(sizes[i], align), "memalign failed");
+      char *x = sf_calloc(1, 6000);
+      cr_assert_not_null(x, "x is NULL!");
+      cr_assert(is_zero(x, 6000), "payload after memalign(%zu, %zu) is dirty",
+                sizes[i], align);
+    }
+  }
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_calloc_suite, huge_is_zero, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  size_t size = 2 << 20;
+  char *x = sf_calloc(size / 8, 8);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert(is_zero(x, size), "payload is not zero");
+  sf_free(x);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
@@ -0,0 +1,109 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_check_suite, level_from_environment, .timeout = TEST_TIMEOUT) {
+  setenv("SFMM_CHECK", "fast", 1);
+#ifdef SF_CHECK_LEVEL
+  // the build level wins over the environment and cannot be changed
+  int other =
+      (SF_CHECK_LEVEL == SF_CHECK_FAST) ? SF_CHECK_FULL : SF_CHECK_FAST;
+  cr_assert_eq(check_level(), SF_CHECK_LEVEL, "SFMM_CHECK was read");
+  sf_errno = 0;
+  cr_assert_eq(sf_set_check_level(other), -1, "level was set");
+  cr_assert_eq(EINVAL, sf_errno, "sf_errno is not EINVAL");
+  cr_assert_eq(check_level(), SF_CHECK_LEVEL, "level changed");
+#else
+  cr_assert_eq(check_level(), SF_CHECK_FAST, "SFMM_CHECK was not read");
+  cr_assert_eq(sf_set_check_level(SF_CHECK_PARANOID), 0, "level was not set");
+  cr_assert_eq(check_level(), SF_CHECK_PARANOID, "level was not set");
+#endif
+}
+
+Test(sfmm_check_suite, unknown_level, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  int level = check_level();
+  cr_assert_eq(sf_set_check_level((sf_check_level)7), -1,
+               "unknown level was accepted");
+  cr_assert_eq(EINVAL, sf_errno, "sf_errno is not EINVAL");
+  cr_assert_eq(check_level(), level, "level changed");
+}
+
+Test(sfmm_check_suite, fast_skips_footer, .timeout = TEST_TIMEOUT) {
+  use_check_level(SF_CHECK_FAST);
+  sf_errno = 0;
+  sf_malloc(400);
+  void *x = sf_malloc(400);
+  sf_malloc(8);
+  // the previous block claims to be free, only the full checks read it
+  BLOCK_HEADER(get_block(x)) &= ~PREV_BLOCK_ALLOCATED;
+  sf_free(x);
+  assert_free_block_count(408, 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_check_suite, fast_catches_double_free, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  sf_set_check_level(SF_CHECK_FAST);
+  skip_below_check_level(SF_CHECK_FAST);
+  void *x = sf_malloc(8);
+  sf_free(x);
+  sf_free(x);
+}
+
+Test(sfmm_check_suite, full_skips_neighbours, .timeout = TEST_TIMEOUT) {
+  use_check_level(SF_CHECK_FULL);
+  sf_errno = 0;
+  void *x = sf_malloc(400);
+  void *y = sf_malloc(400);
+  sf_malloc(8);
+  BLOCK_HEADER(get_block(y)) &= ~PREV_BLOCK_ALLOCATED;
+  sf_free(x);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_check_suite, paranoid_prev_alloc, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  use_check_level(SF_CHECK_PARANOID);
+  void *x = sf_malloc(400);
+  void *y = sf_malloc(400);
+  sf_malloc(8);
+  // y no longer knows that x is allocated
+  BLOCK_HEADER(get_block(y)) &= ~PREV_BLOCK_ALLOCATED;
+  sf_free(x);
+}
+
+Test(sfmm_check_suite, paranoid_unlinked_neighbour, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  use_check_level(SF_CHECK_PARANOID);
+  void *x = sf_malloc(400);
+  void *y = sf_malloc(400);
+  sf_malloc(8);
+  sf_free(y);
+  // y is free but was dropped from its free list
+  set_block_next(get_block(y), NULL);
+  sf_free(x);
+}
+
+Test(sfmm_check_suite, paranoid_passes_valid_frees,
+     .timeout = TEST_TIMEOUT) {
+  use_check_level(SF_CHECK_PARANOID);
+  sf_errno = 0;
+  void *x = sf_malloc(400);
+  void *y = sf_malloc(400);
+  void *z = sf_malloc(400);
+  sf_malloc(8);
+  sf_free(x);
+  sf_free(z);
+  sf_free(y);
+  assert_free_block_count(3 * 408, 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
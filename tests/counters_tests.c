@@ -0,0 +1,112 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "counters.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+#ifdef SF_COUNTERS
+/*
+ * @return The count of an event in the class of a block of size bytes.
+ */
+static uint64_t count(sf_event event, size_t size) {
+  sf_event_counters counters;
+  cr_assert_eq(sf_get_counters(&counters), 0, "no counters");
+  return counters.counts[event][get_free_list_index(size)];
+}
+
+Test(sfmm_counters_suite, quick_hit, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(100);
+  uint64_t misses = count(SF_EV_QUICK_MISS, 112);
+  sf_free(x);
+  sf_malloc(100);
+  cr_assert_eq(count(SF_EV_QUICK_HIT, 112), 1, "quick list hit not counted");
+  cr_assert_eq(count(SF_EV_QUICK_MISS, 112), misses, "miss counted");
+}
+
+Test(sfmm_counters_suite, exact_fit_and_split, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(1000);
+  sf_malloc(8);
+  uint64_t splits = count(SF_EV_SPLIT, 1008);
+  sf_free(x);
+  sf_malloc(1000);
+  cr_assert_eq(count(SF_EV_EXACT_FIT, 1008), 1, "exact fit not counted");
+  cr_assert_eq(count(SF_EV_WALK, 1008), splits + 1,
+               "walk steps are %lu",
+               (unsigned long)count(SF_EV_WALK, 1008));
+  sf_malloc(1000);
+  cr_assert_eq(count(SF_EV_SPLIT, 1008), splits + 1, "split not counted");
+}
+
+Test(sfmm_counters_suite, tlsf_fits, .timeout = TEST_TIMEOUT) {
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), 0, "engine not set");
+  void *x = sf_malloc(1000);
+  sf_malloc(8);
+  sf_free(x);
+  uint64_t splits = count(SF_EV_SPLIT, 1008);
+  // good fit lists hold larger blocks than the one freed, the next block
+  // comes from the wilderness
+  sf_malloc(1000);
+  cr_assert_eq(count(SF_EV_SPLIT, 1008), splits + 1, "split not counted");
+  cr_assert_eq(count(SF_EV_EXACT_FIT, 1008), 0, "exact fit counted");
+}
+
+Test(sfmm_counters_suite, grow_and_miss, .timeout = TEST_TIMEOUT) {
+  sf_malloc(100);
+  sf_malloc(5000);
+  cr_assert_eq(count(SF_EV_MISS, 5008), 1, "miss not counted");
+  cr_assert_eq(count(SF_EV_GROW, 5008), 1, "grow not counted");
+}
+
+Test(sfmm_counters_suite, coalesce_and_flush, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(1000);
+  void *y = sf_malloc(1000);
+  sf_malloc(8);
+  sf_free(x);
+  sf_free(y);
+  // y merges with x before it and the wilderness is not next to it
+  cr_assert_eq(count(SF_EV_COALESCE, 2016), 1, "coalesce not counted");
+  void *p[QUICK_LIST_MAX_DEPTH + 1];
+  for (int i = 0; i <= QUICK_LIST_MAX_DEPTH; i++) {
+    p[i] = sf_malloc(40);
+  }
+  for (int i = 0; i <= QUICK_LIST_MAX_DEPTH; i++) {
+    sf_free(p[i]);
+  }
+  cr_assert(count(SF_EV_FLUSH, 48) > 0, "flush not counted");
+  cr_assert(count(SF_EV_FLUSHED, 48) >= count(SF_EV_FLUSH, 48),
+            "flushed blocks not counted");
+}
+
+Test(sfmm_counters_suite, dump, .timeout = TEST_TIMEOUT) {
+  sf_malloc(100);
+  int fds[2];
+  cr_assert_eq(pipe(fds), 0, "no pipe");
+  cr_assert_eq(sf_dump_counters(fds[1]), 0, "dump failed");
+  close(fds[1]);
+  char buf[4096];
+  ssize_t len = read(fds[0], buf, sizeof(buf) - 1);
+  close(fds[0]);
+  cr_assert(len > 0, "nothing dumped");
+  buf[len] = '\0';
+  cr_assert_not_null(strstr(buf, "quick_hit"), "no header in %s", buf);
+  cr_assert_not_null(strstr(buf, "\n       128 "), "no class 128 in %s", buf);
+}
+#else
+Test(sfmm_counters_suite, not_built, .timeout = TEST_TIMEOUT) {
+  sf_event_counters counters;
+  sf_errno = 0;
+  cr_assert_eq(sf_get_counters(&counters), -1, "counters without SF_COUNTERS");
+  cr_assert_eq(sf_errno, ENOTSUP, "sf_errno is not ENOTSUP");
+  sf_errno = 0;
+  cr_assert_eq(sf_dump_counters(STDOUT_FILENO), -1, "dumped");
+  cr_assert_eq(sf_errno, ENOTSUP, "sf_errno is not ENOTSUP");
+}
+#endif
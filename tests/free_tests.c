@@ -2,7 +2,10 @@
 #include <errno.h>
 #include <signal.h>
 
+#include "check.h"
 #include "debug.h"
+#include "huge.h"
+#include "mem_library.h"
 #include "sfmm.h"
 #include "tests.h"
 #define TEST_TIMEOUT 15
@@ -35,6 +38,7 @@ Test(sfmm_free_suite, free_invalid_pntr_NULL, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_random_num, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = (void*)12;
   // should abort program if pntr invalid
@@ -43,6 +47,7 @@ Test(sfmm_free_suite, free_invalid_pntr_random_num, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_not_8_aligned, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   invalid_pntr += 13;
@@ -52,6 +57,7 @@ Test(sfmm_free_suite, free_invalid_pntr_not_8_aligned, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_b4_heap_start, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_mem_start() - 128;
   // should abort program if pntr invalid
@@ -60,6 +66,7 @@ Test(sfmm_free_suite, free_invalid_pntr_b4_heap_start, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_after_heap_end, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_mem_end() + 128;
   // should abort program if pntr invalid
@@ -68,6 +75,7 @@ Test(sfmm_free_suite, free_invalid_pntr_after_heap_end, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_not_alloc, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   sf_free(invalid_pntr);
@@ -77,42 +85,46 @@ Test(sfmm_free_suite, free_invalid_pntr_not_alloc, .timeout = TEST_TIMEOUT,
 
 Test(sfmm_free_suite, free_invalid_pntr_bad_alignment, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header = 33 & ~0x7;
+  BLOCK_HEADER(get_block(invalid_pntr)) = 33 & ~0x7;
   ;
   sf_free(invalid_pntr);
 }
 
 Test(sfmm_free_suite, free_invalid_pntr_set_qcklst, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header |= 0x4;
+  BLOCK_HEADER(get_block(invalid_pntr)) |= 0x4;
   sf_free(invalid_pntr);
 }
 
 Test(sfmm_free_suite, free_invalid_pntr_set_alloc_0, .timeout = TEST_TIMEOUT,
      .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header &= ~0x1;
+  BLOCK_HEADER(get_block(invalid_pntr)) &= ~0x1;
   sf_free(invalid_pntr);
 }
 
 Test(sfmm_free_suite, free_invalid_pntr_prev_alloc_1_but_not_past_block,
      .timeout = TEST_TIMEOUT, .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* valid = sf_malloc(20);
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header &= ~0x1;
+  BLOCK_HEADER(get_block(invalid_pntr)) &= ~0x1;
   // write footer for valid block
-  sf_footer* footer = (sf_footer*)((void*)valid + 32 - sizeof(sf_footer));
-  *footer = (sf_footer)get_block(invalid_pntr)->header;
+  sf_word* footer = (sf_word*)((void*)valid + MIN_BLOCK_SIZE - FOOTER_SIZE);
+  *footer = BLOCK_HEADER(get_block(invalid_pntr));
   sf_free(invalid_pntr);
 }
 
@@ -121,11 +133,11 @@ Test(sfmm_free_suite, free_invalid_pntr_prev_alloc_1_but_not_past_block,
 Test(sfmm_free_suite, free_valid_pntr, .timeout = TEST_TIMEOUT) {
   // free valid pointer
   double* ptr = sf_malloc(sizeof(double));
-  assert_block_size(ptr, 32);
-  assert_free_block_count(4024, 1);
+  assert_block_size(ptr, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
   // should not abort program if pntr valid
   sf_free(ptr);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(0, 1);
   assert_free_block_count(0, 1);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
@@ -135,50 +147,50 @@ Test(sfmm_free_suite, free_valid_pntr_2, .timeout = TEST_TIMEOUT) {
   // free valid pointer
   double* ptr = sf_malloc(sizeof(double));
   double* ptr2 = sf_malloc(sizeof(double));
-  assert_block_size(ptr, 32);
-  assert_block_size(ptr2, 32);
-  assert_free_block_count(3992, 1);
+  assert_block_size(ptr, MIN_BLOCK_SIZE);
+  assert_block_size(ptr2, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE, 1);
   // should not abort program if pntr valid
   sf_free(ptr);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(0, 1);
   assert_free_block_count(0, 1);
-  assert_free_block_count(3992, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE, 1);
   sf_free(ptr2);
-  assert_quick_list_block_count(32, 2);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
   assert_quick_list_block_count(0, 2);
   assert_free_block_count(0, 1);
-  assert_free_block_count(3992, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE, 1);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
 Test(sfmm_free_suite, free_valid_pntr_3, .timeout = TEST_TIMEOUT) {
   // free valid pointer
   double* ptr = sf_malloc(sizeof(double));
-  assert_block_size(ptr, 32);
+  assert_block_size(ptr, MIN_BLOCK_SIZE);
   double* ptr2 = sf_malloc(56);
   assert_block_size(ptr2, 64);
   double* ptr3 = sf_malloc(sizeof(double));
-  assert_block_size(ptr3, 32);
-  assert_free_block_count(3928, 1);
+  assert_block_size(ptr3, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 64, 1);
   // should not abort program if pntr valid
   sf_free(ptr);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(0, 1);
   assert_free_block_count(0, 1);
-  assert_free_block_count(3928, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 64, 1);
   sf_free(ptr2);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(64, 1);
   assert_quick_list_block_count(0, 2);
   assert_free_block_count(0, 1);
-  assert_free_block_count(3928, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 64, 1);
   sf_free(ptr3);
-  assert_quick_list_block_count(32, 2);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
   assert_quick_list_block_count(0, 3);
   assert_quick_list_block_count(64, 1);
   assert_free_block_count(0, 1);
-  assert_free_block_count(3928, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 64, 1);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
@@ -187,29 +199,29 @@ Test(sfmm_free_suite, free_valid_pntr_4, .timeout = TEST_TIMEOUT) {
   double* ptr = sf_malloc(sizeof(double));
   double* ptr2 = sf_malloc(1016);
   double* ptr3 = sf_malloc(sizeof(double));
-  assert_block_size(ptr, 32);
+  assert_block_size(ptr, MIN_BLOCK_SIZE);
   assert_block_size(ptr2, 1024);
-  assert_block_size(ptr3, 32);
-  assert_free_block_count(2968, 1);
+  assert_block_size(ptr3, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 1024, 1);
   // should not abort program if pntr valid
   sf_free(ptr);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(0, 1);
   assert_free_block_count(0, 1);
-  assert_free_block_count(2968, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 1024, 1);
   sf_free(ptr2);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_quick_list_block_count(0, 1);
   assert_free_block_count(1024, 1);
   assert_free_block_count(0, 2);
   assert_free_block_count(1024, 1);
-  assert_free_block_count(2968, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 1024, 1);
   sf_free(ptr3);
-  assert_quick_list_block_count(32, 2);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
   assert_quick_list_block_count(0, 2);
   assert_free_block_count(0, 2);
   assert_free_block_count(1024, 1);
-  assert_free_block_count(2968, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE - 1024, 1);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
@@ -229,21 +241,60 @@ Test(sfmm_free_suite, free_coalesce_quicklist, .timeout = TEST_TIMEOUT) {
   /*void *j =  */ sf_malloc(sizeof(double));
   assert_free_block_count(0, 1);
   sf_free(a);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   sf_free(c);
-  assert_quick_list_block_count(32, 2);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
   sf_free(b);
-  assert_quick_list_block_count(32, 3);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 3);
   sf_free(e);
-  assert_quick_list_block_count(32, 4);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 4);
   sf_free(f);
-  assert_quick_list_block_count(32, 5);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 5);
   sf_free(d);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_free_block_count(0, 3);
-  assert_free_block_count(32*3, 1);
-  assert_free_block_count(32*2, 1);
+  assert_free_block_count(MIN_BLOCK_SIZE * 3, 1);
+  assert_free_block_count(MIN_BLOCK_SIZE * 2, 1);
   sf_malloc(sizeof(double));
-  assert_quick_list_block_count(32, 0);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 0);
   assert_free_block_count(0, 3);
-}
\ No newline at end of file
+}
+
+Test(sfmm_free_suite, free_sized_quick_list, .timeout = TEST_TIMEOUT) {
+  double* ptr = sf_malloc(sizeof(double));
+  sf_free_sized(ptr, sizeof(double));
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
+  assert_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_free_suite, free_sized_coalesces, .timeout = TEST_TIMEOUT) {
+  void* a = sf_malloc(400);
+  void* b = sf_malloc(400);
+  sf_malloc(sizeof(double));
+  sf_free_sized(a, 400);
+  sf_free_sized(b, 400);
+  assert_free_block_count(2 * 408, 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_free_suite, free_sized_huge, .timeout = TEST_TIMEOUT) {
+  size_t size = 2 << 20;
+  void* x = sf_malloc(size);
+  void* y = sf_memalign(100, 4096);
+  cr_assert(is_huge_pointer(x) && is_huge_pointer(y), "blocks are not mapped");
+  sf_free_sized(x, size);
+  sf_free_sized(y, 100);
+  cr_assert(!is_huge_pointer(x) && !is_huge_pointer(y),
+            "blocks were not unmapped");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_free_suite, block_of_size, .timeout = TEST_TIMEOUT) {
+  void* x = sf_malloc(100);
+  cr_assert(is_block_of_size(get_sf_block(x), 100), "size does not match");
+  cr_assert(is_block_of_size(get_sf_block(x), 90), "size does not match");
+  cr_assert(!is_block_of_size(get_sf_block(x), 200), "size matches");
+  sf_free(x);
+  cr_assert(!is_block_of_size(get_sf_block(x), 100), "free block matches");
+}
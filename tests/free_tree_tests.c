@@ -0,0 +1,114 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "debug.h"
+#include "free_tree.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+#define NODE_STRIDE 128
+#define NUM_NODES 2000
+
+/*
+ * Check the red-black and ordering properties of a subtree.
+ * Returns the black height of the subtree.
+ */
+static int check_subtree(sf_tree_node *node, int *count) {
+  if (node == NULL) return 1;
+  (*count)++;
+  if (node->left != NULL) {
+    cr_assert(node->left->parent == node, "left child has wrong parent");
+    cr_assert(get_block_size((sf_block *)node->left) <=
+                  get_block_size((sf_block *)node),
+              "tree is not ordered by size");
+  }
+  if (node->right != NULL) {
+    cr_assert(node->right->parent == node, "right child has wrong parent");
+    cr_assert(get_block_size((sf_block *)node->right) >=
+                  get_block_size((sf_block *)node),
+              "tree is not ordered by size");
+  }
+  if (node->red) {
+    cr_assert(node->left == NULL || !node->left->red, "red node has red child");
+    cr_assert(node->right == NULL || !node->right->red,
+              "red node has red child");
+  }
+  int left = check_subtree(node->left, count);
+  int right = check_subtree(node->right, count);
+  cr_assert_eq(left, right, "black heights differ");
+  return left + (node->red ? 0 : 1);
+}
+
+static void assert_tree_valid(int index, int expected_count) {
+  int count = 0;
+  sf_tree_node *root = sf_free_tree_roots[index];
+  cr_assert(root == NULL || !root->red, "root is red");
+  check_subtree(root, &count);
+  cr_assert_eq(count, expected_count, "tree holds %d nodes, expected %d",
+               count, expected_count);
+}
+
+Test(sfmm_free_tree_suite, free_tree_insert_remove, .timeout = TEST_TIMEOUT) {
+  char *arena = calloc(NUM_NODES, NODE_STRIDE);
+  init_free_trees();
+  unsigned int seed = 3;
+  for (int i = 0; i < NUM_NODES; i++) {
+    sf_block *block = (sf_block *)(arena + i * NODE_STRIDE);
+    seed = seed * 1103515245 + 12345;
+    // only the header is used for ordering, the size need not be real
+    BLOCK_HEADER(block) = (8200 + ((seed >> 16) % 64) * 8) | THIS_BLOCK_ALLOCATED;
+    free_tree_insert(NUM_FREE_LISTS - 1, block);
+  }
+  assert_tree_valid(NUM_FREE_LISTS - 1, NUM_NODES);
+  // in-order walk visits blocks by size, then address
+  sf_block *prev = free_tree_lower_bound(NUM_FREE_LISTS - 1, 0);
+  for (sf_block *cur = free_tree_next(prev); cur != NULL;
+       cur = free_tree_next(cur)) {
+    cr_assert(get_block_size(prev) < get_block_size(cur) ||
+                  (get_block_size(prev) == get_block_size(cur) && prev < cur),
+              "in-order walk is out of order");
+    prev = cur;
+  }
+  for (int i = 0; i < NUM_NODES; i += 2) {
+    free_tree_remove(NUM_FREE_LISTS - 1, (sf_block *)(arena + i * NODE_STRIDE));
+  }
+  assert_tree_valid(NUM_FREE_LISTS - 1, NUM_NODES / 2);
+  sf_block *fit = free_tree_lower_bound(NUM_FREE_LISTS - 1, 8201);
+  cr_assert_not_null(fit, "no best fit found");
+  cr_assert(get_block_size(fit) >= 8201, "best fit is too small");
+  for (int i = 1; i < NUM_NODES; i += 2) {
+    free_tree_remove(NUM_FREE_LISTS - 1, (sf_block *)(arena + i * NODE_STRIDE));
+  }
+  assert_tree_valid(NUM_FREE_LISTS - 1, 0);
+  free(arena);
+}
+
+Test(sfmm_free_tree_suite, free_tree_best_fit_large, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  // carve the heap into alternating large free and small allocated blocks
+  void *large[4];
+  size_t sizes[4] = {12000, 9000, 16000, 10000};
+  for (int i = 0; i < 4; i++) {
+    large[i] = sf_malloc(sizes[i]);
+    cr_assert_not_null(large[i], "large[%d] is NULL", i);
+    sf_malloc(200);
+  }
+  for (int i = 0; i < 4; i++) sf_free(large[i]);
+  assert_tree_valid(NUM_FREE_LISTS - 1, 4);
+  assert_free_list_size(NUM_FREE_LISTS - 1, 4);
+  // the free list stays sorted by size
+  sf_block *head = &sf_free_list_heads[NUM_FREE_LISTS - 1];
+  for (sf_block *bp = block_next(head); block_next(bp) != head;
+       bp = block_next(bp)) {
+    cr_assert(get_block_size(bp) <= get_block_size(block_next(bp)),
+              "free list is not sorted by size");
+  }
+  // the smallest block that fits is chosen and split
+  void *x = sf_malloc(9500);
+  assert_pntr_equal(x, large[3]);
+  assert_tree_valid(NUM_FREE_LISTS - 1, 3);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
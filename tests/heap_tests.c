@@ -0,0 +1,69 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "debug.h"
+#include "heap.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_heap_suite, grow_multiple_pages_at_once, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = sf_malloc(8);
+  // needs the rest of the first page plus two more pages
+  void *y = sf_malloc(3 * PAGE_SZ);
+  cr_assert_not_null(y, "y is NULL!");
+  assert_allocated_block(y, 3 * PAGE_SZ + 8);
+  assert_pntr_equal((char *)x + MIN_BLOCK_SIZE, y);
+  cr_assert(sf_mem_end() - sf_mem_start() == 4 * PAGE_SZ,
+            "heap is not 4 pages");
+  assert_free_block_count(0, 1);
+  assert_free_block_count(4 * PAGE_SZ - HEAP_PAD - 2 * MIN_BLOCK_SIZE -
+                              (3 * PAGE_SZ + 8) - HEADER_SIZE, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_heap_suite, grow_failure_keeps_pages, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = sf_malloc(86100);
+  cr_assert_null(x, "x is not NULL!");
+  cr_assert(sf_errno == ENOMEM, "sf_errno is not ENOMEM!");
+  // the pages that could be grown are usable afterwards
+  sf_errno = 0;
+  x = sf_malloc(80000);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_heap_suite, grow_chunk_policy, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_growth_policy(SF_GROW_CHUNK, 8 * PAGE_SZ), 0,
+               "could not set growth policy");
+  sf_malloc(8);
+  sf_malloc(5000);
+  cr_assert(sf_mem_end() - sf_mem_start() == 9 * PAGE_SZ,
+            "heap is not 9 pages");
+  assert_free_block_count(0, 1);
+}
+
+Test(sfmm_heap_suite, grow_geometric_policy, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_growth_policy(SF_GROW_GEOMETRIC, 0);
+  sf_malloc(4000);
+  sf_malloc(100);
+  cr_assert(sf_mem_end() - sf_mem_start() == 2 * PAGE_SZ,
+            "heap is not 2 pages");
+  sf_malloc(4000);
+  sf_malloc(4000);
+  cr_assert(sf_mem_end() - sf_mem_start() == 4 * PAGE_SZ,
+            "heap is not 4 pages");
+}
+
+Test(sfmm_heap_suite, grow_policy_invalid, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_growth_policy(SF_GROW_CHUNK, 0), -1,
+               "chunk policy without a chunk size accepted");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
@@ -8,20 +8,32 @@
 #include "mem_library.h"
 #define TEST_TIMEOUT 15
 
+/* Blocks of 33 and 25 byte requests, whose header size depends on the layout. */
+#ifdef SF_COMPACT_HEADERS
+#define BLOCK_OF_33 40
+#define BLOCK_OF_25 32
+#else
+#define BLOCK_OF_33 48
+#define BLOCK_OF_25 40
+#endif
+
 Test(sfmm_helper_suite, calculate_malloc_block_size_1, .timeout = TEST_TIMEOUT) {
   // feed input smaller than minimum block size:
   int size = calc_malloc_block_size(5);
-  cr_assert_eq(size, 32, "Expected size to be 32, but got %d", size);
+  cr_assert_eq(size, MIN_BLOCK_SIZE, "Expected size to be %d, but got %d",
+               MIN_BLOCK_SIZE, size);
 }
 
 Test(sfmm_helper_suite, calculate_malloc_block_size_2, .timeout = TEST_TIMEOUT) {
   // feed input not a multiple of 8:
   int size = calc_malloc_block_size(33);
-  cr_assert_eq(size, 48, "Expected size to be 48, but got %d", size);
+  cr_assert_eq(size, BLOCK_OF_33, "Expected size to be %d, but got %d",
+               BLOCK_OF_33, size);
 }
 
 Test(sfmm_helper_suite, calculate_malloc_block_size_3, .timeout = TEST_TIMEOUT) {
   // feed stark example input:
   int size = calc_malloc_block_size(25);
-  cr_assert_eq(size, 40, "Expected size to be 40, but got %d", size);
+  cr_assert_eq(size, BLOCK_OF_25, "Expected size to be %d, but got %d",
+               BLOCK_OF_25, size);
 }
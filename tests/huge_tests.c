@@ -0,0 +1,140 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "check.h"
+#include "debug.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_huge_suite, huge_malloc_free, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_malloc(8);
+  void *x = sf_malloc(4 << 20);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert(x < sf_mem_start() || x >= sf_mem_end(), "x is in the heap");
+  assert_pntr_aligned(x, 16);
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  cr_assert_geq(huge_usable_size(x), (size_t)4 << 20, "x is too small");
+  memset(x, 0x5a, 4 << 20);
+  // the heap did not grow for x
+  cr_assert(sf_mem_end() - sf_mem_start() == PAGE_SZ, "heap grew");
+  sf_free(x);
+  cr_assert(!is_huge_pointer(x), "x is still huge after free");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_huge_suite, huge_threshold, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_huge_threshold(2 * PAGE_SZ);
+  void *x = sf_malloc(PAGE_SZ);
+  void *y = sf_malloc(2 * PAGE_SZ);
+  cr_assert(!is_huge_pointer(x), "x is huge");
+  cr_assert(is_huge_pointer(y), "y is not huge");
+  sf_free(y);
+  sf_free(x);
+  assert_free_block_count(0, 1);
+}
+
+Test(sfmm_huge_suite, huge_realloc, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_huge_threshold(4 * PAGE_SZ);
+  char *x = sf_malloc(100);
+  strcpy(x, "huge");
+  // heap block grows into a huge block
+  x = sf_realloc(x, 8 * PAGE_SZ);
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  cr_assert(strcmp(x, "huge") == 0, "contents were not copied");
+  x[8 * PAGE_SZ - 1] = 'x';
+  // huge block shrinks back into the heap
+  x = sf_realloc(x, 200);
+  cr_assert(!is_huge_pointer(x), "x is still huge");
+  cr_assert(strcmp(x, "huge") == 0, "contents were not copied");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_huge_suite, huge_realloc_remaps, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  char *x = sf_malloc(4 << 20);
+  x[0] = 'a';
+  x[(4 << 20) - 1] = 'z';
+  // grown by remapping, the payload comes along without a copy
+  x = sf_realloc(x, 64 << 20);
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  assert_pntr_aligned(x, 16);
+  cr_assert(x[0] == 'a' && x[(4 << 20) - 1] == 'z', "contents were lost");
+  cr_assert_geq(huge_usable_size(x), (size_t)64 << 20, "x is too small");
+  x[(64 << 20) - 1] = 'y';
+  // shrinking releases the tail pages and never moves the block
+  char *y = sf_realloc(x, 2 << 20);
+  assert_pntr_equal(x, y);
+  cr_assert_lt(huge_usable_size(y), ((size_t)2 << 20) + PAGE_SZ,
+               "tail pages were not released");
+  cr_assert(y[0] == 'a', "contents were lost");
+  sf_free(y);
+  cr_assert(!is_huge_pointer(y), "y is still huge after free");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_huge_suite, huge_realloc_moves_often, .timeout = TEST_TIMEOUT) {
+  static void *guards[8000];
+  int moves = 0;
+  int i;
+  char *x = sf_malloc(2 << 20);
+  x[0] = 'a';
+  // every move leaves a tombstone in the table of huge blocks
+  for (i = 0; moves < 4000; i++) {
+    cr_assert_lt(i, 8000, "only %d moves", moves);
+    // block the page after the mapping so that growing has to move it,
+    // unless something else is mapped there already
+    char *end = x + huge_usable_size(x);
+    guards[i] = mmap(end, PAGE_SZ, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    cr_assert(guards[i] != MAP_FAILED, "no guard page");
+    char *y = sf_realloc(x, huge_usable_size(x) + PAGE_SZ);
+    cr_assert_not_null(y, "realloc %d failed", i);
+    moves += (y != x);
+    x = y;
+  }
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  cr_assert(x[0] == 'a', "contents were lost");
+  sf_free(x);
+  while (i-- > 0) {
+    munmap(guards[i], PAGE_SZ);
+  }
+}
+
+Test(sfmm_huge_suite, huge_realloc_keeps_alignment, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  char *x = sf_memalign(2 << 20, 1 << 16);
+  x[0] = 'a';
+  x = sf_realloc(x, 32 << 20);
+  cr_assert_not_null(x, "x is NULL!");
+  assert_pntr_aligned(x, 1 << 16);
+  cr_assert(x[0] == 'a', "contents were lost");
+  sf_free(x);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_huge_suite, huge_memalign, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = sf_memalign(2 << 20, 1 << 16);
+  cr_assert_not_null(x, "x is NULL!");
+  assert_pntr_aligned(x, 1 << 16);
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  sf_free(x);
+}
+
+Test(sfmm_huge_suite, huge_free_twice, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FULL);
+  void *x = sf_malloc(2 << 20);
+  sf_free(x);
+  sf_free(x);
+}
@@ -0,0 +1,118 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <string.h>
+
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+/*
+ * These tests only go through the block layout accessors, so they pass
+ * with the default layout and with SF_COMPACT_HEADERS (make compact).
+ */
+
+// payloads too large for the quick lists
+#define LARGE_PAYLOAD 400
+
+Test(sfmm_layout_suite, smallest_blocks_are_packed, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  char *x = sf_malloc(1);
+  char *y = sf_malloc(MIN_PAYLOAD_SIZE);
+  char *z = sf_malloc(MIN_PAYLOAD_SIZE + 1);
+  cr_assert_not_null(z, "sf_malloc failed");
+  cr_assert_eq((uintptr_t)x % 8, 0, "payload is not aligned");
+  cr_assert_eq(get_block_size(get_sf_block(x)), MIN_BLOCK_SIZE,
+               "block of 1 byte is not of minimum size");
+  cr_assert_eq(y - x, MIN_BLOCK_SIZE, "blocks are not adjacent");
+  cr_assert_eq(z - y, MIN_BLOCK_SIZE, "block of MIN_PAYLOAD_SIZE is too big");
+  cr_assert_eq(get_block_size(get_sf_block(z)), MIN_BLOCK_SIZE + 8,
+               "block of MIN_PAYLOAD_SIZE + 1 bytes has the wrong size");
+  cr_assert_eq((char *)get_sf_block(x) + HEADER_SIZE, x,
+               "header does not precede the payload");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_layout_suite, free_links_round_trip, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *a = sf_malloc(LARGE_PAYLOAD);
+  sf_malloc(1);
+  void *b = sf_malloc(LARGE_PAYLOAD);
+  sf_malloc(1);
+  sf_free(a);
+  sf_free(b);
+  sf_block *block_a = get_sf_block(a);
+  sf_block *block_b = get_sf_block(b);
+  cr_assert_eq(get_alloc_bit(block_a), 0, "block a is not free");
+  // both blocks are linked into the same list, with consistent links
+  sf_block *head = get_free_list_head(get_block_size(block_a));
+  int found = 0;
+  for (sf_block *cur = block_next(head); cur != head; cur = block_next(cur)) {
+    cr_assert_eq(block_prev(block_next(cur)), cur, "links are inconsistent");
+    found += (cur == block_a) + (cur == block_b);
+  }
+  cr_assert_eq(found, 2, "freed blocks are not in their free list");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_layout_suite, footers_coalesce, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *a = sf_malloc(LARGE_PAYLOAD);
+  void *b = sf_malloc(LARGE_PAYLOAD);
+  sf_malloc(1);
+  size_t size = get_block_size(get_sf_block(a));
+  sf_free(a);
+  // b finds a through its footer
+  sf_free(b);
+  sf_block *block = get_sf_block(a);
+  cr_assert_eq(get_alloc_bit(block), 0, "block is not free");
+  cr_assert_eq(get_block_size(block), 2 * size, "blocks were not coalesced");
+  cr_assert_eq(get_prev_alloc_bit(get_block_end(block)), 0,
+               "next block does not see a free block before it");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_layout_suite, tlsf_links_round_trip, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), 0, "engine not set");
+  void *a = sf_malloc(LARGE_PAYLOAD);
+  sf_malloc(1);
+  sf_free(a);
+  // the freed block is the only one in its TLSF list
+  sf_block *block = get_sf_block(a);
+  int fl, sl;
+  tlsf_mapping(get_block_size(block), &fl, &sl);
+  sf_block *head = &sf_tlsf_heads[fl][sl];
+  cr_assert_eq(block_next(head), block, "block is not at the head");
+  cr_assert_eq(block_prev(head), block, "block is not at the tail");
+  cr_assert_eq(block_next(block), head, "block does not link to the head");
+  cr_assert_eq(block_prev(block), head, "block does not link to the head");
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_layout_suite, payloads_survive_metadata, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  char *pntrs[64];
+  size_t sizes[64];
+  for (int i = 0; i < 64; i++) {
+    sizes[i] = 1 + (i * 37) % 300;
+    pntrs[i] = sf_malloc(sizes[i]);
+    cr_assert_not_null(pntrs[i], "sf_malloc failed");
+    memset(pntrs[i], i, sizes[i]);
+  }
+  // freeing every other block writes links and footers next to the others
+  for (int i = 0; i < 64; i += 2) {
+    sf_free(pntrs[i]);
+  }
+  for (int i = 1; i < 64; i += 2) {
+    for (size_t j = 0; j < sizes[i]; j++) {
+      cr_assert_eq(pntrs[i][j], (char)i, "payload %d was overwritten", i);
+    }
+    pntrs[i] = sf_realloc(pntrs[i], sizes[i] + 100);
+    cr_assert_eq(pntrs[i][0], (char)i, "realloc lost payload %d", i);
+  }
+  for (int i = 1; i < 64; i += 2) {
+    sf_free(pntrs[i]);
+  }
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
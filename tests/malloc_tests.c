@@ -3,6 +3,7 @@
 #include <signal.h>
 
 #include "debug.h"
+#include "mem_library.h"
 #include "sfmm.h"
 #include "tests.h"
 #define TEST_TIMEOUT 15
@@ -32,11 +33,11 @@ Test(sfmm_malloc_suite, malloc_4096_bytes, .timeout = TEST_TIMEOUT) {
 
 Test(sfmm_malloc_suite, malloc_avoid_potential_splinter,
      .timeout = TEST_TIMEOUT) {
-  // available space will be 4056
+  // available space will be FIRST_FREE_SIZE
   sf_errno = 0;
-  void *x = sf_malloc(
-      4040);  // can technically fit 4040, but we want to avoid splinter
-  int expected_size = 4056;
+  // can technically fit, but we want to avoid a splinter
+  void *x = sf_malloc(FIRST_FREE_SIZE - HEADER_SIZE - 8);
+  int expected_size = FIRST_FREE_SIZE;
   cr_assert(sf_errno == 0, "sf_errno is not 0");
   assert_allocated_block(x, expected_size);
   // (malloc should prefer to use bigger block, instead of double heapsize)
@@ -62,31 +63,31 @@ Test(sfmm_malloc_suite, malloc_64_bytes, .timeout = TEST_TIMEOUT) {
 
 Test(sfmm_malloc_suite, malloc_from_quicklist_32, .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
-  sf_block *y = get_block(sf_malloc(23));  // create mem_grow block
+  sf_block *y = get_block(sf_malloc(MIN_BLOCK_SIZE - HEADER_SIZE - 1));  // create mem_grow block
   // change y to quicklist block without using sf_free
-  y->header |= 0x4;  // set quicklist bit to 1
-  y->header |= 0x1;  // set alloc bit to 1
+  BLOCK_HEADER(y) |= 0x4;  // set quicklist bit to 1
+  BLOCK_HEADER(y) |= 0x1;  // set alloc bit to 1
   // clear payload
-  y->body.links.next = NULL;
-  y->body.links.prev = NULL;
+  set_block_next(y, NULL);
+  set_block_prev(y, NULL);
   // add block to quicklist
   sf_quick_lists[0].first = y;
   sf_quick_lists[0].length++;
   // quicklist now has one block
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   // needs to malloc from quicklist
-  sf_block *x = get_block(sf_malloc(23));
+  sf_block *x = get_block(sf_malloc(MIN_BLOCK_SIZE - HEADER_SIZE - 1));
   cr_assert(x == y, "did not allocate block to quicklist");
   cr_assert(sf_quick_lists[0].length == 0, "quicklist length is not 0");
   cr_assert(sf_quick_lists[0].first == NULL, "quicklist first is not NULL");
-  int expected_size = 32;
+  int expected_size = MIN_BLOCK_SIZE;
   cr_assert(sf_errno == 0, "sf_errno is not 0");
-  cr_assert((x->header & ~0x7) == expected_size, "block size is not 4104");
-  cr_assert((x->header & 0x1) == 1, "alloc bit is not 1");
-  cr_assert((x->header & 0x2) == 2, "prev alloc bit is not 1");
-  cr_assert((x->header & 0x4) == 0, "quicklist bit is not 0");
+  cr_assert((BLOCK_HEADER(x) & ~0x7) == expected_size, "block size is not 4104");
+  cr_assert((BLOCK_HEADER(x) & 0x1) == 1, "alloc bit is not 1");
+  cr_assert((BLOCK_HEADER(x) & 0x2) == 2, "prev alloc bit is not 1");
+  cr_assert((BLOCK_HEADER(x) & 0x4) == 0, "quicklist bit is not 0");
   sf_block *next = (void *)x + expected_size;
-  cr_assert((next->header & 0x2) != 0, "prev alloc bit of next block is 0");
+  cr_assert((BLOCK_HEADER(next) & 0x2) != 0, "prev alloc bit of next block is 0");
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
@@ -127,19 +128,19 @@ Test(sfmm_malloc_suite, malloc_quicklist_flush_test, .timeout = TEST_TIMEOUT) {
   /*void *l =  */ sf_malloc(sizeof(double));
   assert_free_block_count(0, 1);
   sf_free(a);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   sf_free(c);
-  assert_quick_list_block_count(32, 2);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
   sf_free(e);
-  assert_quick_list_block_count(32, 3);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 3);
   sf_free(g);
-  assert_quick_list_block_count(32, 4);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 4);
   sf_free(i);
-  assert_quick_list_block_count(32, 5);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 5);
   sf_free(k);
-  assert_quick_list_block_count(32, 1);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
   assert_free_block_count(0, 6);
   sf_malloc(sizeof(double));
-  assert_quick_list_block_count(32, 0);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 0);
   assert_free_block_count(0, 6);
 }
\ No newline at end of file
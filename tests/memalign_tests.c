@@ -1,6 +1,7 @@
 #include <criterion/criterion.h>
 #include <errno.h>
 #include <signal.h>
+#include <string.h>
 
 #include "debug.h"
 #include "sfmm.h"
@@ -46,6 +47,11 @@ Test(sfmm_memalign_suite, align_24, .timeout = TEST_TIMEOUT) {
                sf_errno);
 }
 
+/*
+ * The size_* tests check the block sizes of the default layout,
+ * any_layout checks the same requests in either layout.
+ */
+#ifndef SF_COMPACT_HEADERS
 Test(sfmm_memalign_suite, size_4_align_16, .timeout = TEST_TIMEOUT) {
   // if align is not a power of two or is less than the minimum block size,
   // then NULL is returned and sf_errno is set to EINVAL.
@@ -137,11 +143,10 @@ Test(sfmm_memalign_suite, size_16_align_16, .timeout = TEST_TIMEOUT) {
     int free_block_size = 40;
     assert_free_block_count(free_block_size, 1);
     int available_size = 4056 - free_block_size;
-    assert_allocated_block(pntr, 40);
+    assert_allocated_block(pntr, 32);
     assert_free_block_count(0, 2);
-    int allocated_size = 2*sizeof(sf_header) + requested_size + 32 + alignment;
-    allocated_size -= free_block_size;
-    assert_free_block_count(available_size-allocated_size, 1);
+    // the block is not padded out for the alignment
+    assert_free_block_count(available_size - 32, 1);
   }
 }
 
@@ -170,11 +175,10 @@ Test(sfmm_memalign_suite, size_24_align_16, .timeout = TEST_TIMEOUT) {
     int free_block_size = 40;
     assert_free_block_count(free_block_size, 1);
     int available_size = 4056 - free_block_size;
-    assert_allocated_block(pntr, 48);
+    assert_allocated_block(pntr, 32);
     assert_free_block_count(0, 2);
-    int allocated_size = 2*sizeof(sf_header) + requested_size + 32 + alignment;
-    allocated_size -= free_block_size;
-    assert_free_block_count(available_size-allocated_size, 1);
+    // the block is not padded out for the alignment
+    assert_free_block_count(available_size - 32, 1);
   }
 }
 
@@ -312,11 +316,10 @@ Test(sfmm_memalign_suite, size_16_align_32, .timeout = TEST_TIMEOUT) {
     int free_block_size = 56;
     assert_free_block_count(free_block_size, 1);
     int available_size = 4056 - free_block_size;
-    assert_allocated_block(pntr, 40);
+    assert_allocated_block(pntr, 32);
     assert_free_block_count(0, 2);
-    int allocated_size = 2*sizeof(sf_header) + requested_size + 32 + alignment;
-    allocated_size -= free_block_size;
-    assert_free_block_count(available_size-allocated_size, 1);
+    // the block is not padded out for the alignment
+    assert_free_block_count(available_size - 32, 1);
   }
 }
 
@@ -345,10 +348,68 @@ Test(sfmm_memalign_suite, size_24_align_32, .timeout = TEST_TIMEOUT) {
     int free_block_size = 56;
     assert_free_block_count(free_block_size, 1);
     int available_size = 4056 - free_block_size;
-    assert_allocated_block(pntr, 48);
+    assert_allocated_block(pntr, 32);
     assert_free_block_count(0, 2);
-    int allocated_size = 2*sizeof(sf_header) + requested_size + 32 + alignment;
-    allocated_size -= free_block_size;
-    assert_free_block_count(available_size-allocated_size, 1);
+    // the block is not padded out for the alignment
+    assert_free_block_count(available_size - 32, 1);
+  }
+}
+#endif
+
+Test(sfmm_memalign_suite, any_layout, .timeout = TEST_TIMEOUT) {
+  size_t sizes[] = {4, 8, 16, 24, 100, 1000};
+  int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+  void* pntrs[5 * 6];
+  int n = 0;
+  sf_errno = 0;
+  for (size_t alignment = 16; alignment <= 256; alignment *= 2) {
+    for (int i = 0; i < nsizes; i++) {
+      char* pntr = sf_memalign(sizes[i], alignment);
+      cr_assert_eq(0, sf_errno, "sf_errno is not 0, it is %d", sf_errno);
+      assert_pntr_aligned(pntr, alignment);
+      // the padding is given back, short of a splinter after the payload
+      sf_block* bp = get_block(pntr);
+      size_t block_size = calc_malloc_block_size(sizes[i]);
+      cr_assert(get_alloc_bit(bp), "block is not allocated");
+      cr_assert(get_block_size(bp) >= block_size &&
+                    get_block_size(bp) < block_size + MIN_BLOCK_SIZE,
+                "block of %zu bytes aligned to %zu is %zu bytes", sizes[i],
+                alignment, get_block_size(bp));
+      memset(pntr, 0xff, sizes[i]);
+      pntrs[n++] = pntr;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    sf_free(pntrs[i]);
   }
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) flush_quicklist(i);
+  assert_quick_list_block_count(0, 0);
+  assert_free_block_count(0, 1);
+}
+
+Test(sfmm_memalign_suite, aligned_fit_reuses_free_block, .timeout = TEST_TIMEOUT) {
+  size_t alignment = 64;
+  char* x = sf_malloc(400);
+  sf_malloc(1);
+  void* end = sf_mem_end();
+  sf_free(x);
+  // the freed block is big enough for an aligned payload wherever it starts
+  char* pntr = sf_memalign(100, alignment);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0, it is %d", sf_errno);
+  assert_pntr_aligned(pntr, alignment);
+  cr_assert(pntr >= x && pntr + 100 <= x + 400,
+            "aligned block was not carved from the free block");
+  assert_allocated_block(pntr, calc_malloc_block_size(100));
+  cr_assert_eq(end, sf_mem_end(), "heap grew");
+}
+
+Test(sfmm_memalign_suite, page_alignment_is_mapped, .timeout = TEST_TIMEOUT) {
+  size_t alignment = 4096;
+  char* pntr = sf_memalign(100, alignment);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0, it is %d", sf_errno);
+  assert_pntr_aligned(pntr, alignment);
+  cr_assert_eq(sf_mem_start(), sf_mem_end(), "heap was used");
+  memset(pntr, 0xff, 100);
+  sf_free(pntr);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0, it is %d", sf_errno);
 }
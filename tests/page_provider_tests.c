@@ -0,0 +1,76 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+
+#include "debug.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_page_provider_suite, mmap_provider_large_heap,
+     .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_use_mmap_provider(0), 0, "could not use mmap provider");
+  // keep large requests in the heap
+  sf_set_huge_threshold(0);
+  // more than the 21 pages sfutil can provide
+  void *x = sf_malloc(4096 * 100);
+  cr_assert_not_null(x, "x is NULL!");
+  memset(x, 0xab, 4096 * 100);
+  void *y = sf_malloc(64 << 20);
+  cr_assert_not_null(y, "y is NULL!");
+  cr_assert(heap_end() - heap_start() >= (64 << 20) + 4096 * 100,
+            "heap did not grow");
+  cr_assert(sf_mem_start() == sf_mem_end(), "sfutil region was used");
+  sf_free(x);
+  sf_free(y);
+  assert_free_block_count(0, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_page_provider_suite, mmap_provider_limit, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(16 * PAGE_SZ);
+  void *x = sf_malloc(17 * PAGE_SZ);
+  cr_assert_null(x, "x is not NULL!");
+  cr_assert(sf_errno == ENOMEM, "sf_errno is not ENOMEM!");
+  cr_assert(heap_end() - heap_start() == 16 * PAGE_SZ,
+            "heap is not 16 pages");
+}
+
+Test(sfmm_page_provider_suite, static_provider, .timeout = TEST_TIMEOUT) {
+  static char buffer[8 * 4096 + 100];
+  sf_errno = 0;
+  cr_assert_eq(sf_use_static_provider(buffer, sizeof(buffer)), 0,
+               "could not use static provider");
+  void *x = sf_malloc(100);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert((char *)x > buffer && (char *)x < buffer + sizeof(buffer),
+            "x is not in the buffer");
+  cr_assert_eq((uintptr_t)heap_start() % PAGE_SZ, 0, "heap is not aligned");
+  void *y = sf_malloc(6 * PAGE_SZ);
+  cr_assert_not_null(y, "y is NULL!");
+  void *z = sf_malloc(2 * PAGE_SZ);
+  cr_assert_null(z, "z is not NULL!");
+  cr_assert(sf_errno == ENOMEM, "sf_errno is not ENOMEM!");
+}
+
+Test(sfmm_page_provider_suite, provider_after_init, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_malloc(8);
+  cr_assert_eq(sf_use_mmap_provider(0), -1, "provider changed after init");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
+
+Test(sfmm_page_provider_suite, static_provider_too_small,
+     .timeout = TEST_TIMEOUT) {
+  static char buffer[100];
+  sf_errno = 0;
+  cr_assert_eq(sf_use_static_provider(buffer, sizeof(buffer)), -1,
+               "buffer without a full page accepted");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
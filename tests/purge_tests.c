@@ -0,0 +1,112 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "purge.h"
+#include "sfmm.h"
+#include "tests.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_purge_suite, trim_shrinks_heap, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  sf_set_trim_threshold(0);
+  void *x = sf_malloc(8);
+  void *y = sf_malloc(64 * PAGE_SZ);
+  size_t heap_size = heap_end() - heap_start();
+  cr_assert_gt(heap_size, 64 * PAGE_SZ, "heap did not grow");
+  sf_free(y);
+  cr_assert(heap_end() - heap_start() == heap_size, "heap shrank");
+  cr_assert_eq(sf_trim(0), 1, "nothing was trimmed");
+  cr_assert(heap_end() - heap_start() == PAGE_SZ, "heap is not 1 page");
+  assert_free_block_count(0, 1);
+  cr_assert_eq(sf_purge_counters.trims, 1, "trim was not counted");
+  // the trimmed heap can grow again
+  y = sf_malloc(8 * PAGE_SZ);
+  cr_assert_not_null(y, "y is NULL!");
+  memset(y, 1, 8 * PAGE_SZ);
+  sf_free(x);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_purge_suite, trim_automatically, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_use_mmap_provider(0);
+  sf_set_trim_threshold(32 * PAGE_SZ);
+  sf_malloc(8);
+  void *y = sf_malloc(64 * PAGE_SZ);
+  sf_free(y);
+  // the wilderness is trimmed down to half the threshold
+  cr_assert(heap_end() - heap_start() <= 18 * PAGE_SZ,
+            "heap was not trimmed");
+}
+
+Test(sfmm_purge_suite, purge_zeroes_pages, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_purge_decay(-1);
+  char *x = sf_malloc(4 * PAGE_SZ);
+  /* void *guard = */ sf_malloc(8);
+  memset(x, 0xff, 4 * PAGE_SZ);
+  sf_free(x);
+  size_t dirty = sf_purge_counters.dirty_bytes;
+  cr_assert_geq(dirty, 4 * PAGE_SZ, "freed block is not dirty");
+  cr_assert_eq(sf_trim(0), 1, "nothing was purged");
+  cr_assert(is_block_purged(get_block(x)), "block was not purged");
+  cr_assert_gt(sf_purge_counters.purged_bytes, 0, "purged bytes not counted");
+  cr_assert_lt(sf_purge_counters.dirty_bytes, dirty, "dirty bytes not reduced");
+  // whole pages inside the block read back as zero, metadata is intact
+  char *page = (char *)(((uintptr_t)x + PAGE_SZ) & ~(PAGE_SZ - 1));
+  cr_assert_eq(page[0], 0, "purged page is not zero");
+  assert_free_block(x, 4 * PAGE_SZ + 8);
+}
+
+Test(sfmm_purge_suite, purged_blocks_reused_last, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_purge_decay(-1);
+  void *x = sf_malloc(3 * PAGE_SZ);
+  sf_malloc(8);
+  void *y = sf_malloc(3 * PAGE_SZ);
+  sf_malloc(8);
+  sf_free(x);
+  sf_trim(0);
+  sf_free(y);
+  cr_assert(is_block_purged(get_block(x)), "x was not purged");
+  cr_assert(!is_block_purged(get_block(y)), "y was purged");
+  // the dirty block is handed out first
+  assert_pntr_equal(sf_malloc(3 * PAGE_SZ), y);
+  assert_pntr_equal(sf_malloc(3 * PAGE_SZ), x);
+}
+
+Test(sfmm_purge_suite, purge_decay_zero, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_purge_decay(0);
+  void *x = sf_malloc(3 * PAGE_SZ);
+  sf_malloc(8);
+  sf_free(x);
+  cr_assert(is_block_purged(get_block(x)), "x was not purged on free");
+  // a purged block that is reallocated counts as dirty again
+  sf_malloc(3 * PAGE_SZ);
+  cr_assert_eq(sf_purge_counters.purged_bytes, 0, "purged bytes not released");
+}
+
+Test(sfmm_purge_suite, purge_tlsf, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_free_list_engine(SF_TLSF);
+  sf_set_purge_decay(-1);
+  void *x = sf_malloc(3 * PAGE_SZ);
+  sf_malloc(8);
+  void *y = sf_malloc(3 * PAGE_SZ);
+  sf_malloc(8);
+  sf_free(x);
+  cr_assert_eq(sf_trim(0), 1, "nothing was purged");
+  sf_free(y);
+  cr_assert(is_block_purged(get_block(x)), "x was not purged");
+  assert_pntr_equal(sf_malloc(3 * PAGE_SZ), y);
+  assert_pntr_equal(sf_malloc(3 * PAGE_SZ), x);
+  cr_assert_eq(sf_purge_counters.purged_bytes, 0, "purged bytes not released");
+}
@@ -0,0 +1,97 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_quicklist_suite, quicklist_is_lifo, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = sf_malloc(sizeof(double));
+  void *y = sf_malloc(sizeof(double));
+  /* void *z = */ sf_malloc(sizeof(double));
+  sf_free(x);
+  sf_free(y);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
+  // most recently freed block is handed out first
+  cr_assert(sf_quick_lists[0].first == get_block(y),
+            "y is not at the head of the quick list");
+  assert_pntr_equal(sf_malloc(sizeof(double)), y);
+  assert_pntr_equal(sf_malloc(sizeof(double)), x);
+  assert_quick_list_block_count(0, 0);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_quicklist_suite, quicklist_hot_class_grows, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *pntrs[2 * QUICK_LIST_MAX];
+  for (int i = 0; i < 2 * QUICK_LIST_MAX; i++) {
+    pntrs[i] = sf_malloc(sizeof(double));
+  }
+  // fill the list, then drain it completely so the class looks hot
+  for (int i = 0; i < QUICK_LIST_MAX; i++) sf_free(pntrs[2 * i]);
+  for (int i = 0; i < QUICK_LIST_MAX; i++) pntrs[2 * i] = sf_malloc(sizeof(double));
+  for (int i = 0; i < QUICK_LIST_MAX; i++) sf_free(pntrs[2 * i]);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, QUICK_LIST_MAX);
+  // overflowing a hot list deepens it instead of flushing it
+  sf_free(pntrs[1]);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, QUICK_LIST_MAX + 1);
+  cr_assert_eq(get_quick_list_depth(0), 2 * QUICK_LIST_MAX,
+               "quick list depth is %d", get_quick_list_depth(0));
+  assert_free_block_count(0, 1);
+}
+
+Test(sfmm_quicklist_suite, quicklist_cold_class_shrinks,
+     .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *pntrs[2 * QUICK_LIST_MAX + 2];
+  for (int i = 0; i < 2 * QUICK_LIST_MAX + 2; i++) {
+    pntrs[i] = sf_malloc(sizeof(double));
+  }
+  // free every other block so nothing coalesces, without any mallocs between
+  for (int i = 0; i <= QUICK_LIST_MAX; i++) sf_free(pntrs[2 * i]);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 1);
+  assert_free_block_count(MIN_BLOCK_SIZE, QUICK_LIST_MAX);
+  cr_assert_eq(get_quick_list_depth(0), QUICK_LIST_MIN_DEPTH,
+               "quick list depth is %d", get_quick_list_depth(0));
+}
+
+Test(sfmm_quicklist_suite, quicklist_flush_merges_runs, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *pntrs[6];
+  for (int i = 0; i < 6; i++) {
+    pntrs[i] = sf_malloc(sizeof(double));
+  }
+  // freed out of address order, blocks 0-2 and 4 end up on the quick list
+  sf_free(pntrs[2]);
+  sf_free(pntrs[0]);
+  sf_free(pntrs[4]);
+  sf_free(pntrs[1]);
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 4);
+  cr_assert_eq(flush_quicklist_batch(0, 4), 4, "did not flush 4 blocks");
+  assert_quick_list_block_count(0, 0);
+  assert_free_block_count(0, 3);
+  assert_free_block_count(3 * MIN_BLOCK_SIZE, 1);
+  assert_free_block_count(MIN_BLOCK_SIZE, 1);
+  assert_free_block(pntrs[0], 3 * MIN_BLOCK_SIZE);
+}
+
+Test(sfmm_quicklist_suite, quicklist_partial_flush, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *pntrs[8];
+  for (int i = 0; i < 8; i++) {
+    pntrs[i] = sf_malloc(sizeof(double));
+  }
+  for (int i = 0; i < 4; i++) sf_free(pntrs[2 * i]);
+  // flush the two oldest blocks, keep the two most recently freed
+  cr_assert_eq(flush_quicklist_batch(0, 2), 2, "did not flush 2 blocks");
+  assert_quick_list_block_count(MIN_BLOCK_SIZE, 2);
+  assert_free_block_count(MIN_BLOCK_SIZE, 2);
+  assert_quicklist_block(pntrs[6], MIN_BLOCK_SIZE);
+  assert_quicklist_block(pntrs[4], MIN_BLOCK_SIZE);
+  assert_free_block(pntrs[0], MIN_BLOCK_SIZE);
+  assert_free_block(pntrs[2], MIN_BLOCK_SIZE);
+}
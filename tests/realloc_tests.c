@@ -2,7 +2,9 @@
 #include <errno.h>
 #include <signal.h>
 
+#include "check.h"
 #include "debug.h"
+#include "mem_library.h"
 #include "sfmm.h"
 #include "tests.h"
 #define TEST_TIMEOUT 15
@@ -38,6 +40,7 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_NULL, .timeout = TEST_TIMEOUT) {
 }
 
 Test(sfmm_realloc_suite, invalid_pntr_error, .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // realloc invalid pointer
   // create an invalid pointer
   void* invalid_pntr = (void*)12;
@@ -49,6 +52,7 @@ Test(sfmm_realloc_suite, invalid_pntr_error, .timeout = TEST_TIMEOUT) {
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_not_8_aligned,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   invalid_pntr += 13;
@@ -61,6 +65,7 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_not_8_aligned,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_b4_heap_start,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_mem_start() - 128;
   // should abort program if pntr invalid
@@ -72,6 +77,7 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_b4_heap_start,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_after_heap_end,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FULL);
   // free invalid pointer
   void* invalid_pntr = sf_mem_end() + 128;
   // should abort program if pntr invalid
@@ -83,6 +89,7 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_after_heap_end,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_not_alloc,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   sf_free(invalid_pntr);
@@ -95,10 +102,11 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_not_alloc,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_bad_alignment,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header = 33 & ~0x7;
+  BLOCK_HEADER(get_block(invalid_pntr)) = 33 & ~0x7;
   void* x = sf_realloc(invalid_pntr, 32);
   int expected_errno = EINVAL;
   cr_assert_null(x, "x is not NULL!");
@@ -107,10 +115,11 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_bad_alignment,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_set_qcklst,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header |= 0x4;
+  BLOCK_HEADER(get_block(invalid_pntr)) |= 0x4;
   void* x = sf_realloc(invalid_pntr, 32);
   int expected_errno = EINVAL;
   cr_assert_null(x, "x is not NULL!");
@@ -119,10 +128,11 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_set_qcklst,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_set_alloc_0,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header &= ~0x1;
+  BLOCK_HEADER(get_block(invalid_pntr)) &= ~0x1;
   void* x = sf_realloc(invalid_pntr, 32);
   int expected_errno = EINVAL;
   cr_assert_null(x, "x is not NULL!");
@@ -131,14 +141,15 @@ Test(sfmm_realloc_suite, realloc_invalid_pntr_set_alloc_0,
 
 Test(sfmm_realloc_suite, realloc_invalid_pntr_prev_alloc_1_but_not_past_block,
      .timeout = TEST_TIMEOUT) {
+  skip_below_check_level(SF_CHECK_FAST);
   // free invalid pointer
   void* valid = sf_malloc(20);
   void* invalid_pntr = sf_malloc(20);
   // change block size
-  get_block(invalid_pntr)->header &= ~0x1;
+  BLOCK_HEADER(get_block(invalid_pntr)) &= ~0x1;
   // write footer for valid block
-  sf_footer* footer = (sf_footer*)((void*)valid + 32 - sizeof(sf_footer));
-  *footer = (sf_footer)get_block(invalid_pntr)->header;
+  sf_word* footer = (sf_word*)((void*)valid + MIN_BLOCK_SIZE - FOOTER_SIZE);
+  *footer = BLOCK_HEADER(get_block(invalid_pntr));
   void* x = sf_realloc(invalid_pntr, 32);
   int expected_errno = EINVAL;
   cr_assert_null(x, "x is not NULL!");
@@ -151,10 +162,10 @@ Test(sfmm_realloc_suite, realloc_same_size, .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
   double* ptr = sf_malloc(sizeof(double));
   *ptr = 43567890.987654;
-  assert_allocated_block(ptr, 32);
+  assert_allocated_block(ptr, MIN_BLOCK_SIZE);
   double* ptr2 = sf_realloc(ptr, sizeof(double));
   cr_assert(*ptr2 == 43567890.987654, "ptr2 is not 43567890.987654");
-  assert_allocated_block(ptr, 32);
+  assert_allocated_block(ptr, MIN_BLOCK_SIZE);
   assert_pntr_equal(ptr, ptr2);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
@@ -163,14 +174,14 @@ Test(sfmm_realloc_suite, realloc_greater_size, .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
   double* ptr = sf_malloc(sizeof(double));
   *ptr = 43567890.987654;
-  assert_allocated_block(ptr, 32);
-  assert_free_block_count((4056 - 32), 1);
+  assert_allocated_block(ptr, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
   double* ptr2 = sf_realloc(ptr, 56);
   cr_assert(*ptr2 == 43567890.987654, "ptr2 is not 43567890.987654");
+  // the block grows into the wilderness after it
   assert_allocated_block(ptr2, 64);
-  assert_quicklist_block(ptr, 32);
-  assert_free_block_count((4056 - (64 + 32)), 1);
-  assert_pntr_not_equal(ptr, ptr2);
+  assert_free_block_count(FIRST_FREE_SIZE - 64, 1);
+  assert_pntr_equal(ptr, ptr2);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
@@ -178,27 +189,60 @@ Test(sfmm_realloc_suite, realloc_next_page, .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
   double* ptr = sf_malloc(sizeof(double));
   *ptr = 5667655.3;
-  assert_allocated_block(ptr, 32);
-  assert_free_block_count((4056 - 32), 1);
+  assert_allocated_block(ptr, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
   double* ptr2 = sf_realloc(ptr, 4096);
   cr_assert(*ptr2 == 5667655.3, "ptr2 is not 5667655.3");
+  // the heap grows behind the block
   assert_allocated_block(ptr2, 4104);
-  assert_quicklist_block(ptr, 32);
-  assert_free_block_count(((4056 + 4096) - (4104 + 32)), 1);
+  assert_free_block_count(FIRST_FREE_SIZE + 4096 - 4104, 1);
+  assert_pntr_equal(ptr, ptr2);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_realloc_suite, realloc_absorbs_next_free_block,
+     .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  double* ptr = sf_malloc(sizeof(double));
+  *ptr = 3.5;
+  void* y = sf_malloc(200);
+  sf_malloc(sizeof(double));
+  sf_free(y);
+  assert_free_block(y, 208);
+  double* ptr2 = sf_realloc(ptr, 100);
+  cr_assert(*ptr2 == 3.5, "ptr2 is not 3.5");
+  assert_pntr_equal(ptr, ptr2);
+  assert_allocated_block(ptr2, calc_malloc_block_size(100));
+  assert_free_block_count(MIN_BLOCK_SIZE + 208 - calc_malloc_block_size(100), 1);
+  cr_assert_eq(0, sf_errno, "sf_errno is not 0");
+}
+
+Test(sfmm_realloc_suite, realloc_copies_when_boxed_in,
+     .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  double* ptr = sf_malloc(sizeof(double));
+  *ptr = 7.25;
+  sf_malloc(sizeof(double));
+  double* ptr2 = sf_realloc(ptr, 100);
+  cr_assert(*ptr2 == 7.25, "ptr2 is not 7.25");
   assert_pntr_not_equal(ptr, ptr2);
+  assert_allocated_block(ptr2, calc_malloc_block_size(100));
+  assert_quicklist_block(ptr, MIN_BLOCK_SIZE);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
 
 Test(sfmm_realloc_suite, realloc_smaller_size_no_splinter,
      .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
-  double* ptr = sf_malloc(48);
+  // shrinking to the minimum would leave less than a block behind
+  size_t size = 2 * MIN_BLOCK_SIZE - 8;
+  double* ptr = sf_malloc(size - HEADER_SIZE);
   *ptr = 1024325.3;
-  assert_allocated_block(ptr, 56);
+  assert_allocated_block(ptr, size);
   double* ptr2 = sf_realloc(ptr, sizeof(double));
   cr_assert(*ptr2 == 1024325.3, "ptr2 is not 1024325.3");
-  assert_allocated_block(ptr2, 56);
-  assert_free_block_count(4000, 1);
+  assert_allocated_block(ptr2, size);
+  assert_free_block_count(FIRST_FREE_SIZE - size, 1);
   assert_pntr_equal(ptr, ptr2);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
@@ -211,8 +255,8 @@ Test(sfmm_realloc_suite, realloc_smaller_size_split_block,
   assert_allocated_block(ptr, 64);
   double* ptr2 = sf_realloc(ptr, sizeof(double));
   cr_assert(*ptr2 == 1.0, "ptr2 is not 1.0");
-  assert_allocated_block(ptr2, 32);
-  assert_free_block_count((4056 - 32), 1);
+  assert_allocated_block(ptr2, MIN_BLOCK_SIZE);
+  assert_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
   assert_pntr_equal(ptr, ptr2);
   cr_assert_eq(0, sf_errno, "sf_errno is not 0");
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "arena.h"
+#include "check.h"
+#include "debug.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "remote_free.h"
+#include "sfmm.h"
+#include "tcache.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+static void *malloc_in_thread(void *arg) { return sf_malloc((uintptr_t)arg); }
+
+static void *malloc_in_arena_1() {
+  sf_set_arena_count(2);
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  sf_malloc(8);
+  pthread_t thread;
+  void *x;
+  pthread_create(&thread, NULL, malloc_in_thread, (void *)(uintptr_t)100);
+  pthread_join(thread, &x);
+  cr_assert_eq(arena_of(x)->index, 1, "block is not in arena 1");
+  return x;
+}
+
+Test(sfmm_remote_free_suite, free_is_queued, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *x = malloc_in_arena_1();
+  sf_arena *owner = arena_of(x);
+  sf_free(x);
+  // the block is queued, not freed
+  assert_allocated_block(x, block);
+  cr_assert_neq(owner->remote_frees & REMOTE_PTR_MASK, 0, "stack is empty");
+  sf_arena *prev = arena_enter(owner);
+  cr_assert_eq(remote_drain(), 1, "stack did not hold one block");
+  cr_assert_eq(sf_quick_lists[get_quick_list_head(block)].length, 1,
+               "block was not freed");
+  cr_assert_eq(remote_drain(), 0, "stack was not emptied");
+  arena_leave(prev);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_remote_free_suite, free_is_queued_with_huge_blocks,
+     .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = malloc_in_arena_1();
+  // a live huge block does not make the free look the block up
+  void *huge = sf_malloc(SF_HUGE_THRESHOLD_DEFAULT);
+  cr_assert(is_huge_pointer(huge), "huge block was not found");
+  cr_assert(!is_huge_pointer(x), "block of arena 1 is huge");
+  sf_arena *owner = arena_of(x);
+  sf_free(x);
+  assert_allocated_block(x, calc_malloc_block_size(100));
+  cr_assert_neq(owner->remote_frees & REMOTE_PTR_MASK, 0, "stack is empty");
+  sf_free(huge);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_remote_free_suite, tag_changes, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *x = malloc_in_arena_1();
+  sf_arena *owner = arena_of(x);
+  uint64_t before = owner->remote_frees;
+  sf_free(x);
+  uint64_t pushed = owner->remote_frees;
+  cr_assert_eq(pushed & REMOTE_PTR_MASK, (uintptr_t)get_block(x),
+               "block is not on top");
+  cr_assert_neq(pushed >> REMOTE_TAG_SHIFT, before >> REMOTE_TAG_SHIFT,
+                "push did not change the tag");
+  sf_arena *prev = arena_enter(owner);
+  remote_drain();
+  arena_leave(prev);
+  cr_assert_eq(owner->remote_frees & REMOTE_PTR_MASK, 0, "stack is not empty");
+  cr_assert_neq(owner->remote_frees >> REMOTE_TAG_SHIFT,
+                pushed >> REMOTE_TAG_SHIFT, "drain did not change the tag");
+}
+
+Test(sfmm_remote_free_suite, double_free_aborts, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  skip_below_check_level(SF_CHECK_FAST);
+  sf_errno = 0;
+  void *x = malloc_in_arena_1();
+  sf_free(x);
+  sf_free(x);
+}
+
+static pthread_barrier_t barrier;
+static void *shared;
+
+static void *reuse_after_miss(void *arg) {
+  shared = sf_malloc(100);
+  pthread_barrier_wait(&barrier);
+  // the initial thread frees the block here
+  pthread_barrier_wait(&barrier);
+  void *y = sf_malloc(100);
+  return (y == shared) ? arg : NULL;
+}
+
+Test(sfmm_remote_free_suite, owner_drains_on_miss, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(2);
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  pthread_barrier_init(&barrier, NULL, 2);
+  pthread_t thread;
+  void *result;
+  int token;
+  pthread_create(&thread, NULL, reuse_after_miss, &token);
+  pthread_barrier_wait(&barrier);
+  sf_free(shared);
+  pthread_barrier_wait(&barrier);
+  pthread_join(thread, &result);
+  cr_assert_eq(result, &token, "freed block was not reused by its owner");
+}
+
+#define PIPE_SLOTS 64
+#define PIPE_MESSAGES 20000
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  unsigned char *slots[PIPE_SLOTS];
+  int head;
+  int tail;
+} pipe_state = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static void *producer(void *arg) {
+  for (int i = 0; i < PIPE_MESSAGES; i++) {
+    size_t size = 16 + i % 500;
+    unsigned char *msg = sf_malloc(size);
+    if (msg == NULL) {
+      return NULL;
+    }
+    msg[0] = (unsigned char)(size >> 8);
+    msg[1] = (unsigned char)size;
+    memset(msg + 2, (unsigned char)i, size - 2);
+    pthread_mutex_lock(&pipe_state.lock);
+    while (pipe_state.tail - pipe_state.head == PIPE_SLOTS) {
+      pthread_cond_wait(&pipe_state.changed, &pipe_state.lock);
+    }
+    pipe_state.slots[pipe_state.tail++ % PIPE_SLOTS] = msg;
+    pthread_cond_broadcast(&pipe_state.changed);
+    pthread_mutex_unlock(&pipe_state.lock);
+  }
+  return arg;
+}
+
+static void *consumer(void *arg) {
+  for (int i = 0; i < PIPE_MESSAGES; i++) {
+    pthread_mutex_lock(&pipe_state.lock);
+    while (pipe_state.tail == pipe_state.head) {
+      pthread_cond_wait(&pipe_state.changed, &pipe_state.lock);
+    }
+    unsigned char *msg = pipe_state.slots[pipe_state.head++ % PIPE_SLOTS];
+    pthread_cond_broadcast(&pipe_state.changed);
+    pthread_mutex_unlock(&pipe_state.lock);
+    size_t size = ((size_t)msg[0] << 8) | msg[1];
+    for (size_t j = 2; j < size; j++) {
+      if (msg[j] != (unsigned char)i) {
+        return NULL;
+      }
+    }
+    sf_free(msg);
+  }
+  return arg;
+}
+
+Test(sfmm_remote_free_suite, producer_consumer, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_arena_count(4);
+  pthread_t threads[2];
+  void *results[2];
+  int token;
+  pthread_create(&threads[0], NULL, producer, &token);
+  pthread_create(&threads[1], NULL, consumer, &token);
+  pthread_join(threads[0], &results[0]);
+  pthread_join(threads[1], &results[1]);
+  cr_assert_eq(results[0], &token, "producer failed");
+  cr_assert_eq(results[1], &token, "consumer failed");
+}
@@ -3,6 +3,7 @@
 #include <signal.h>
 
 #include "debug.h"
+#include "mem_library.h"
 #include "sfmm.h"
 #include "tests.h"
 #define TEST_TIMEOUT 15
@@ -14,10 +15,10 @@
 void assert_free_block_count(size_t size, int count) {
   int cnt = 0;
   for (int i = 0; i < NUM_FREE_LISTS; i++) {
-    sf_block *bp = sf_free_list_heads[i].body.links.next;
+    sf_block *bp = block_next(&sf_free_list_heads[i]);
     while (bp != &sf_free_list_heads[i]) {
-      if (size == 0 || size == (bp->header & ~0x7)) cnt++;
-      bp = bp->body.links.next;
+      if (size == 0 || size == get_block_size(bp)) cnt++;
+      bp = block_next(bp);
     }
   }
   if (size == 0) {
@@ -36,10 +37,10 @@ void assert_free_block_count(size_t size, int count) {
  */
 void assert_free_list_size(int index, int size) {
   int cnt = 0;
-  sf_block *bp = sf_free_list_heads[index].body.links.next;
+  sf_block *bp = block_next(&sf_free_list_heads[index]);
   while (bp != &sf_free_list_heads[index]) {
     cnt++;
-    bp = bp->body.links.next;
+    bp = block_next(bp);
   }
   cr_assert_eq(
       cnt, size,
@@ -56,8 +57,8 @@ void assert_quick_list_block_count(size_t size, int count) {
   for (int i = 0; i < NUM_QUICK_LISTS; i++) {
     sf_block *bp = sf_quick_lists[i].first;
     while (bp != NULL) {
-      if (size == 0 || size == (bp->header & ~0x7)) cnt++;
-      bp = bp->body.links.next;
+      if (size == 0 || size == get_block_size(bp)) cnt++;
+      bp = block_next(bp);
     }
   }
   if (size == 0) {
@@ -72,6 +73,10 @@ void assert_quick_list_block_count(size_t size, int count) {
   }
 }
 
+/*
+ * The basecode tests check the block sizes of the default layout.
+ */
+#ifndef SF_COMPACT_HEADERS
 Test(sfmm_basecode_suite, malloc_an_int, .timeout = TEST_TIMEOUT) {
   sf_errno = 0;
   size_t sz = sizeof(int);
@@ -196,9 +201,9 @@ Test(sfmm_basecode_suite, realloc_larger_block, .timeout = TEST_TIMEOUT) {
   x = sf_realloc(x, sz_x1);
 
   cr_assert_not_null(x, "x is NULL!");
-  sf_block *bp = (sf_block *)((char *)x - sizeof(sf_header));
-  cr_assert(bp->header & THIS_BLOCK_ALLOCATED, "Allocated bit is not set!");
-  cr_assert((bp->header & ~0x7) == 88,
+  sf_block *bp = get_block(x);
+  cr_assert(get_alloc_bit(bp), "Allocated bit is not set!");
+  cr_assert(get_block_size(bp) == 88,
             "Realloc'ed block size not what was expected!");
 
   assert_quick_list_block_count(0, 1);
@@ -216,9 +221,9 @@ Test(sfmm_basecode_suite, realloc_smaller_block_splinter,
   cr_assert_not_null(y, "y is NULL!");
   cr_assert(x == y, "Payload addresses are different!");
 
-  sf_block *bp = (sf_block *)((char *)y - sizeof(sf_header));
-  cr_assert(bp->header & THIS_BLOCK_ALLOCATED, "Allocated bit is not set!");
-  cr_assert((bp->header & ~0x7) == 88,
+  sf_block *bp = get_block(y);
+  cr_assert(get_alloc_bit(bp), "Allocated bit is not set!");
+  cr_assert(get_block_size(bp) == 88,
             "Realloc'ed block size not what was expected!");
 
   // There should be only one free block.
@@ -235,9 +240,9 @@ Test(sfmm_basecode_suite, realloc_smaller_block_free_block,
 
   cr_assert_not_null(y, "y is NULL!");
 
-  sf_block *bp = (sf_block *)((char *)y - sizeof(sf_header));
-  cr_assert(bp->header & THIS_BLOCK_ALLOCATED, "Allocated bit is not set!");
-  cr_assert((bp->header & ~0x7) == 32,
+  sf_block *bp = get_block(y);
+  cr_assert(get_alloc_bit(bp), "Allocated bit is not set!");
+  cr_assert(get_block_size(bp) == 32,
             "Realloc'ed block size not what was expected!");
 
   // After realloc'ing x, we can return a block of size
@@ -249,4 +254,5 @@ Test(sfmm_basecode_suite, realloc_smaller_block_free_block,
   assert_quick_list_block_count(0, 0);
   assert_free_block_count(0, 1);
   assert_free_block_count(4024, 1);
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,168 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+#include "slab.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+Test(sfmm_slab_suite, off_by_default, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  int *x = sf_malloc(sizeof(int));
+  cr_assert(!is_slab_pointer(x), "int was served from a slab");
+  assert_allocated_block(x, MIN_BLOCK_SIZE);
+}
+
+Test(sfmm_slab_suite, tiny_objects_have_no_header, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(16);
+  char *x = sf_malloc(sizeof(int));
+  char *y = sf_malloc(sizeof(int));
+  cr_assert(is_slab_pointer(x), "x is not a slab pointer");
+  cr_assert_eq(y - x, 8, "slots are not packed");
+  assert_pntr_aligned(x, 8);
+  cr_assert_eq(slab_usable_size(x), 8, "wrong slot size");
+  char *z = sf_malloc(16);
+  assert_pntr_aligned(z, 16);
+  cr_assert_eq(slab_usable_size(z), 16, "wrong slot size");
+  // larger requests still come from the heap, which is untouched so far
+  cr_assert(heap_start() == heap_end(), "heap was initialized");
+  void *w = sf_malloc(17);
+  cr_assert(!is_slab_pointer(w), "w was served from a slab");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_slab_suite, one_page_per_slab, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(8);
+  char *first = sf_malloc(8);
+  char *last = first;
+  for (int i = 1; i < 1000; i++) {
+    char *x = sf_malloc(8);
+    cr_assert_not_null(x, "malloc %d failed", i);
+    memset(x, i, 8);
+    if (x > last) last = x;
+  }
+  // 1000 8-byte objects fit in three pages
+  cr_assert_lt(last - first, 3 * PAGE_SZ, "slabs use too many pages");
+  cr_assert_eq(get_slab(first)->used, get_slab(first)->slots,
+               "first slab is not full");
+}
+
+Test(sfmm_slab_suite, free_and_reuse, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(64);
+  void *x = sf_malloc(40);
+  void *y = sf_malloc(40);
+  cr_assert_eq(slab_usable_size(x), 48, "wrong slot size");
+  sf_free(x);
+  cr_assert_eq(get_slab(y)->used, 1, "slot was not freed");
+  void *z = sf_malloc(33);
+  assert_pntr_equal(x, z);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_slab_suite, empty_slabs_are_released, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(32);
+  void *a = sf_malloc(32);
+  void *b = sf_malloc(16);
+  sf_slab *slab_a = get_slab(a);
+  sf_slab *slab_b = get_slab(b);
+  // the first empty slab is kept as the spare, the second one is purged
+  sf_free(a);
+  sf_free(b);
+  cr_assert_eq(slab_a->slot_size, 32, "spare slab was released");
+  cr_assert_eq(slab_b->slot_size, 0, "empty slab was not released");
+  // both pages are reused
+  void *c = sf_malloc(8);
+  void *d = sf_malloc(24);
+  cr_assert(get_slab(c) == slab_a, "spare slab was not reused");
+  cr_assert(get_slab(d) == slab_b, "released slab was not reused");
+}
+
+Test(sfmm_slab_suite, double_free, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  sf_errno = 0;
+  sf_set_slab_max(16);
+  void *x = sf_malloc(16);
+  sf_malloc(16);
+  sf_free(x);
+  sf_free(x);
+}
+
+Test(sfmm_slab_suite, free_inside_slot, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  sf_errno = 0;
+  sf_set_slab_max(16);
+  char *x = sf_malloc(16);
+  sf_free(x + 8);
+}
+
+Test(sfmm_slab_suite, realloc_to_heap, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(16);
+  char *x = sf_malloc(12);
+  memcpy(x, "hello world", 12);
+  char *y = sf_realloc(x, 14);
+  assert_pntr_equal(x, y);
+  y = sf_realloc(x, 100);
+  cr_assert(!is_slab_pointer(y), "y is a slab pointer");
+  cr_assert_str_eq(y, "hello world", "contents were not copied");
+  cr_assert_eq(get_slab(x)->used, 0, "old slot was not freed");
+  char *z = sf_realloc(y, 8);
+  cr_assert(!is_slab_pointer(z), "heap block moved to a slab");
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+#define STRESS_THREADS 4
+#define STRESS_LIVE 256
+#define STRESS_ROUNDS 50000
+
+static void *stress(void *arg) {
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  unsigned char *live[STRESS_LIVE] = {NULL};
+  size_t sizes[STRESS_LIVE] = {0};
+  for (int round = 0; round < STRESS_ROUNDS; round++) {
+    int i = rand_r(&seed) % STRESS_LIVE;
+    if (live[i] != NULL) {
+      for (size_t j = 0; j < sizes[i]; j++) {
+        if (live[i][j] != (unsigned char)(i + (uintptr_t)arg)) {
+          return NULL;
+        }
+      }
+      sf_free(live[i]);
+    }
+    sizes[i] = 1 + rand_r(&seed) % 64;
+    live[i] = sf_malloc(sizes[i]);
+    if (live[i] == NULL) {
+      return NULL;
+    }
+    memset(live[i], (unsigned char)(i + (uintptr_t)arg), sizes[i]);
+  }
+  for (int i = 0; i < STRESS_LIVE; i++) {
+    sf_free(live[i]);
+  }
+  return arg;
+}
+
+Test(sfmm_slab_suite, concurrent_slabs, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_slab_max(64);
+  pthread_t threads[STRESS_THREADS];
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    pthread_create(&threads[t], NULL, stress, (void *)(t + 1));
+  }
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    void *result;
+    pthread_join(threads[t], &result);
+    cr_assert_eq(result, (void *)(t + 1), "thread %ld failed", (long)t);
+  }
+}
@@ -0,0 +1,188 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "block_layout.h"
+#include "huge.h"
+#include "mem_library.h"
+#include "page_provider.h"
+#include "sfmm.h"
+#include "stats.h"
+#include "tests.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+static size_t block_size_of(void *pp) {
+  return get_block_size(get_sf_block(pp));
+}
+
+static void assert_ratio(double ratio, double expected, const char *name) {
+  cr_assert(ratio > expected - 1e-9 && ratio < expected + 1e-9,
+            "%s is %f, not %f", name, ratio, expected);
+}
+
+/*
+ * Walk the heap of the current arena and assert that it agrees with the
+ * statistics.
+ */
+static void assert_stats_match_heap() {
+  sf_stats stats = sf_get_stats();
+  size_t live_blocks = 0;
+  size_t live_bytes = 0;
+  size_t free_blocks[NUM_FREE_LISTS] = {0};
+  size_t free_bytes[NUM_FREE_LISTS] = {0};
+  size_t quick_blocks[NUM_QUICK_LISTS] = {0};
+  char *epilogue = (char *)heap_end() - HEADER_SIZE;
+  char *cur = (char *)heap_start() + HEAP_PAD;
+  cur += get_block_size((sf_block *)cur);  // past the prologue
+  while (cur < epilogue) {
+    sf_block *block = (sf_block *)cur;
+    size_t size = get_block_size(block);
+    if (get_quick_list_bit(block)) {
+      quick_blocks[(size - MIN_BLOCK_SIZE) / 8]++;
+    } else if (get_alloc_bit(block)) {
+      live_blocks++;
+      live_bytes += size;
+    } else {
+      free_blocks[get_free_list_index(size)]++;
+      free_bytes[get_free_list_index(size)] += size;
+    }
+    cur += size;
+  }
+  cr_assert_eq(stats.live_blocks, live_blocks, "live_blocks is %zu, not %zu",
+               stats.live_blocks, live_blocks);
+  cr_assert_eq(stats.live_bytes, live_bytes, "live_bytes is %zu, not %zu",
+               stats.live_bytes, live_bytes);
+  for (int i = 0; i < NUM_FREE_LISTS; i++) {
+    cr_assert_eq(stats.free_blocks[i], free_blocks[i],
+                 "class %d has %zu free blocks, not %zu", i,
+                 stats.free_blocks[i], free_blocks[i]);
+    cr_assert_eq(stats.free_bytes[i], free_bytes[i],
+                 "class %d has %zu free bytes, not %zu", i,
+                 stats.free_bytes[i], free_bytes[i]);
+  }
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+    cr_assert_eq(stats.quick_blocks[i], quick_blocks[i],
+                 "quick list %d has %zu blocks, not %zu", i,
+                 stats.quick_blocks[i], quick_blocks[i]);
+  }
+}
+
+/*
+ * Run a random mix of allocation calls, keeping about half the blocks.
+ */
+static void random_ops() {
+  void *live[256] = {NULL};
+  srand(7);
+  for (int i = 0; i < 4000; i++) {
+    int slot = rand() % 256;
+    size_t size = 1 + rand() % 3000;
+    if (live[slot] != NULL) {
+      if (rand() % 3 == 0) {
+        void *pp = sf_realloc(live[slot], size);
+        if (pp != NULL) live[slot] = pp;
+      } else {
+        sf_free(live[slot]);
+        live[slot] = NULL;
+      }
+    } else if (rand() % 8 == 0) {
+      live[slot] = sf_memalign(size, 64);
+    } else {
+      live[slot] = sf_malloc(size);
+    }
+  }
+  void *batch[16];
+  size_t count = sf_malloc_batch(200, 16, batch);
+  sf_free_batch(batch, count / 2);
+}
+
+Test(sfmm_stats_suite, counts_live_blocks, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(100);
+  void *y = sf_malloc(40);
+  void *z = sf_malloc(300);
+  size_t allocated = block_size_of(x) + block_size_of(y) + block_size_of(z);
+  sf_free(y);
+  sf_stats stats = sf_get_stats();
+  cr_assert_eq(stats.live_blocks, 2, "live_blocks is %zu", stats.live_blocks);
+  cr_assert_eq(stats.live_bytes, block_size_of(x) + block_size_of(z),
+               "live_bytes is %zu", stats.live_bytes);
+  cr_assert_eq(stats.requested_bytes, 440, "requested_bytes is %zu",
+               stats.requested_bytes);
+  cr_assert_eq(stats.allocated_bytes, allocated, "allocated_bytes is %zu",
+               stats.allocated_bytes);
+  assert_ratio(stats.internal_fragmentation, 1.0 - 440.0 / allocated,
+               "internal_fragmentation");
+  // the freed block went to a quick list
+  cr_assert_eq(stats.quick_blocks[(48 - MIN_BLOCK_SIZE) / 8], 1,
+               "freed block is not in the quick lists");
+  cr_assert_eq(stats.quick_bytes, 48, "quick_bytes is %zu", stats.quick_bytes);
+  cr_assert_eq(stats.heap_size, PAGE_SZ, "heap_size is %zu", stats.heap_size);
+  cr_assert_eq(stats.grows, 1, "grows is %zu", stats.grows);
+  cr_assert_eq(stats.grown_bytes, PAGE_SZ, "grown_bytes is %zu",
+               stats.grown_bytes);
+}
+
+Test(sfmm_stats_suite, counts_free_lists, .timeout = TEST_TIMEOUT) {
+  sf_malloc(sizeof(int));
+  size_t size = FIRST_FREE_SIZE - MIN_BLOCK_SIZE;
+  int class = get_free_list_index(size);
+  sf_stats stats = sf_get_stats();
+  assert_free_list_size(class, 1);
+  cr_assert_eq(stats.free_blocks[class], 1, "class %d has %zu blocks", class,
+               stats.free_blocks[class]);
+  cr_assert_eq(stats.free_bytes[class], size, "class %d has %zu bytes", class,
+               stats.free_bytes[class]);
+  cr_assert_eq(stats.free_total, size, "free_total is %zu", stats.free_total);
+  cr_assert_eq(stats.largest_free, size, "largest_free is %zu",
+               stats.largest_free);
+  assert_ratio(stats.external_fragmentation, 0.0, "external_fragmentation");
+}
+
+Test(sfmm_stats_suite, external_fragmentation, .timeout = TEST_TIMEOUT) {
+  void *a = sf_malloc(1000);
+  sf_malloc(1000);
+  void *c = sf_malloc(1000);
+  sf_malloc(8);
+  sf_free(a);
+  sf_free(c);
+  assert_free_block_count(0, 3);
+  sf_stats stats = sf_get_stats();
+  // the two freed blocks and what the wilderness has left
+  size_t block = calc_malloc_block_size(1000);
+  size_t total = FIRST_FREE_SIZE - block - MIN_BLOCK_SIZE;
+  size_t wilderness = total - 2 * block;
+  size_t largest = wilderness > block ? wilderness : block;
+  cr_assert_eq(stats.free_total, total, "free_total is %zu", stats.free_total);
+  cr_assert_eq(stats.largest_free, largest, "largest_free is %zu",
+               stats.largest_free);
+  assert_ratio(stats.external_fragmentation, 1.0 - (double)largest / total,
+               "external_fragmentation");
+}
+
+Test(sfmm_stats_suite, counts_huge_blocks, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(SF_HUGE_THRESHOLD_DEFAULT);
+  sf_stats stats = sf_get_stats();
+  cr_assert_eq(stats.huge_blocks, 1, "huge_blocks is %zu", stats.huge_blocks);
+  cr_assert(stats.huge_bytes > SF_HUGE_THRESHOLD_DEFAULT,
+            "huge_bytes is %zu", stats.huge_bytes);
+  x = sf_realloc(x, 4 * SF_HUGE_THRESHOLD_DEFAULT);
+  stats = sf_get_stats();
+  cr_assert(stats.huge_bytes > 4 * SF_HUGE_THRESHOLD_DEFAULT,
+            "huge_bytes is %zu after realloc", stats.huge_bytes);
+  sf_free(x);
+  stats = sf_get_stats();
+  cr_assert_eq(stats.huge_blocks, 0, "huge_blocks is %zu", stats.huge_blocks);
+  cr_assert_eq(stats.huge_bytes, 0, "huge_bytes is %zu", stats.huge_bytes);
+}
+
+Test(sfmm_stats_suite, match_heap, .timeout = TEST_TIMEOUT) {
+  random_ops();
+  assert_stats_match_heap();
+}
+
+Test(sfmm_stats_suite, match_heap_tlsf, .timeout = TEST_TIMEOUT) {
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), 0, "engine not set");
+  random_ops();
+  assert_stats_match_heap();
+}
@@ -0,0 +1,154 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <string.h>
+
+#include "huge.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "slab.h"
+#include "std_api.h"
+#include "tests.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+#define SIZES 600
+
+/*
+ * Allocate every size up to SIZES, free every other block to leave holes
+ * and fill them again, asserting that every payload is STD_ALIGN aligned.
+ */
+static void assert_malloc_sizes_aligned() {
+  void *p[SIZES];
+  for (int i = 0; i < SIZES; i++) {
+    p[i] = std_malloc(i);
+    cr_assert_not_null(p[i], "malloc(%d) failed", i);
+    assert_pntr_aligned(p[i], STD_ALIGN);
+    cr_assert_geq(std_malloc_usable_size(p[i]), (size_t)i,
+                  "malloc(%d) is too small", i);
+    memset(p[i], 0xa5, i);
+  }
+  for (int i = 0; i < SIZES; i += 2) {
+    std_free(p[i]);
+  }
+  for (int i = 0; i < SIZES; i += 2) {
+    p[i] = std_malloc(SIZES - i);
+    assert_pntr_aligned(p[i], STD_ALIGN);
+  }
+  for (int i = 0; i < SIZES; i++) {
+    std_free(p[i]);
+  }
+}
+
+Test(sfmm_std_api_suite, malloc_aligned, .timeout = TEST_TIMEOUT) {
+  assert_malloc_sizes_aligned();
+}
+
+Test(sfmm_std_api_suite, malloc_aligned_tlsf, .timeout = TEST_TIMEOUT) {
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), 0, "engine not set");
+  assert_malloc_sizes_aligned();
+}
+
+Test(sfmm_std_api_suite, malloc_aligned_slabs, .timeout = TEST_TIMEOUT) {
+  cr_assert_eq(sf_set_slab_max(SLAB_MAX_SIZE), 0, "slabs not enabled");
+  void *p[SLAB_MAX_SIZE + 1];
+  for (int i = 1; i <= SLAB_MAX_SIZE; i++) {
+    p[i] = std_malloc(i);
+    cr_assert(is_slab_pointer(p[i]), "malloc(%d) is not in a slab", i);
+    assert_pntr_aligned(p[i], STD_ALIGN);
+    p[i] = std_realloc(p[i], i + 1);
+    assert_pntr_aligned(p[i], STD_ALIGN);
+  }
+  for (int i = 1; i <= SLAB_MAX_SIZE; i++) {
+    std_free(p[i]);
+  }
+}
+
+Test(sfmm_std_api_suite, malloc_aligned_huge, .timeout = TEST_TIMEOUT) {
+  cr_assert_eq(sf_set_huge_threshold(2 * PAGE_SZ), 0, "threshold not set");
+  void *x = std_malloc(3 * PAGE_SZ + 8);
+  cr_assert(is_huge_pointer(x), "x is not huge");
+  assert_pntr_aligned(x, STD_ALIGN);
+  x = std_realloc(x, 9 * PAGE_SZ + 24);
+  assert_pntr_aligned(x, STD_ALIGN);
+  std_free(x);
+}
+
+Test(sfmm_std_api_suite, calloc_aligned, .timeout = TEST_TIMEOUT) {
+  for (int i = 0; i < SIZES; i += 7) {
+    char *pp = std_calloc(i, 3);
+    cr_assert_not_null(pp, "calloc(%d, 3) failed", i);
+    assert_pntr_aligned(pp, STD_ALIGN);
+    for (int j = 0; j < 3 * i; j++) {
+      cr_assert_eq(pp[j], 0, "byte %d of calloc(%d, 3) is not 0", j, i);
+    }
+    memset(pp, 0xa5, 3 * i);
+  }
+}
+
+Test(sfmm_std_api_suite, realloc_aligned, .timeout = TEST_TIMEOUT) {
+  char *x = std_realloc(NULL, 24);
+  assert_pntr_aligned(x, STD_ALIGN);
+  memset(x, 'x', 24);
+  // a neighbour keeps x from growing in place
+  void *y = std_malloc(40);
+  for (size_t size = 40; size < 4 * PAGE_SZ; size = size * 3 / 2 + 8) {
+    char *moved = std_realloc(x, size);
+    cr_assert_not_null(moved, "realloc(%lu) failed", (unsigned long)size);
+    assert_pntr_aligned(moved, STD_ALIGN);
+    cr_assert_eq(moved[23], 'x', "contents lost");
+    x = moved;
+  }
+  for (size_t size = 4 * PAGE_SZ; size > 8; size /= 3) {
+    x = std_realloc(x, size);
+    assert_pntr_aligned(x, STD_ALIGN);
+  }
+  cr_assert_eq(x[0], 'x', "contents lost");
+  x = std_reallocarray(x, 100, 24);
+  assert_pntr_aligned(x, STD_ALIGN);
+  errno = 0;
+  cr_assert_null(std_reallocarray(x, SIZE_MAX, 2), "overflow not caught");
+  cr_assert_eq(errno, ENOMEM, "errno is not ENOMEM");
+  std_free(x);
+  std_free(y);
+}
+
+Test(sfmm_std_api_suite, memalign_aligned, .timeout = TEST_TIMEOUT) {
+  void *pp = NULL;
+  cr_assert_eq(std_posix_memalign(&pp, sizeof(void *), 40), 0,
+               "posix_memalign failed");
+  assert_pntr_aligned(pp, STD_ALIGN);
+  cr_assert_eq(std_posix_memalign(&pp, 256, 40), 0, "posix_memalign failed");
+  assert_pntr_aligned(pp, 256);
+  pp = std_aligned_alloc(1, 40);
+  assert_pntr_aligned(pp, STD_ALIGN);
+  pp = std_aligned_alloc(64, 100);
+  assert_pntr_aligned(pp, 64);
+  pp = std_memalign(2, 10);
+  assert_pntr_aligned(pp, STD_ALIGN);
+  pp = std_valloc(100);
+  assert_pntr_aligned(pp, PAGE_SZ);
+  pp = std_pvalloc(100);
+  assert_pntr_aligned(pp, PAGE_SZ);
+  cr_assert_geq(std_malloc_usable_size(pp), PAGE_SZ, "pvalloc is too small");
+  // blocks carved around aligned ones stay aligned
+  pp = std_malloc(8);
+  assert_pntr_aligned(pp, STD_ALIGN);
+  std_free_sized(pp, 8);
+}
+
+Test(sfmm_std_api_suite, min_alignment, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_min_alignment(32), -1, "32 accepted");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+  cr_assert_eq(sf_set_min_alignment(16), 0, "16 refused");
+  for (int i = 1; i < 200; i++) {
+    void *pp = sf_malloc(i);
+    assert_pntr_aligned(pp, 16);
+    cr_assert_eq(get_block_size(get_sf_block(pp)) % 16, 0,
+                 "block of malloc(%d) is not a multiple of 16", i);
+  }
+  sf_errno = 0;
+  cr_assert_eq(sf_set_min_alignment(8), -1, "changed with the heap in use");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
@@ -0,0 +1,160 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "sf_thread.h"
+#include "sfmm.h"
+#include "tcache.h"
+#include "tests.h"
+#define TEST_TIMEOUT 15
+
+static void *fail_malloc(void *arg) {
+  void *x = sf_malloc(PAGE_SZ * 100);
+  return (x == NULL && sf_errno == ENOMEM) ? arg : NULL;
+}
+
+Test(sfmm_tcache_suite, errno_is_thread_local, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  pthread_t thread;
+  void *result;
+  int token;
+  pthread_create(&thread, NULL, fail_malloc, &token);
+  pthread_join(thread, &result);
+  cr_assert_eq(result, &token, "thread did not see ENOMEM");
+  cr_assert(sf_errno == 0, "sf_errno of the initial thread changed");
+}
+
+Test(sfmm_tcache_suite, single_thread_does_not_cache, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  void *x = sf_malloc(100);
+  sf_malloc(8);
+  sf_free(x);
+  cr_assert_eq(tcache_count(block), 0, "block was cached");
+  assert_quick_list_block_count(block, 1);
+}
+
+Test(sfmm_tcache_suite, refill_and_reuse, .timeout = TEST_TIMEOUT) {
+  size_t block = calc_malloc_block_size(100);
+  sf_errno = 0;
+  sf_set_thread_cache(SF_TCACHE_ON);
+  void *x = sf_malloc(100);
+  cr_assert_not_null(x, "x is NULL!");
+  cr_assert_eq(tcache_count(block), TCACHE_BATCH - 1, "bin was not refilled");
+  sf_free(x);
+  cr_assert_eq(tcache_count(block), TCACHE_BATCH, "block was not cached");
+  assert_quick_list_block_count(0, 0);
+  // cached blocks still look allocated to the heap
+  assert_allocated_block(x, block);
+  void *y = sf_malloc(100);
+  assert_pntr_equal(x, y);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_tcache_suite, drain_full_bin, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_thread_cache(SF_TCACHE_ON);
+  void *blocks[TCACHE_MAX + TCACHE_BATCH];
+  int n = TCACHE_MAX + TCACHE_BATCH;
+  for (int i = 0; i < n; i++) {
+    blocks[i] = sf_malloc(32);
+    cr_assert_not_null(blocks[i], "malloc failed");
+  }
+  for (int i = 0; i < n; i++) {
+    sf_free(blocks[i]);
+  }
+  cr_assert_leq(tcache_count(40), TCACHE_MAX, "bin overflowed");
+  cr_assert_gt(tcache_count(40), TCACHE_MAX - TCACHE_BATCH, "bin was emptied");
+  sf_set_thread_cache(SF_TCACHE_OFF);
+  cr_assert_eq(tcache_count(40), 0, "bin was not flushed");
+  assert_free_block_count(0, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_tcache_suite, double_free_into_cache, .timeout = TEST_TIMEOUT,
+     .signal = SIGABRT) {
+  sf_errno = 0;
+  sf_set_thread_cache(SF_TCACHE_ON);
+  void *x = sf_malloc(64);
+  sf_free(x);
+  sf_free(x);
+}
+
+static void *cache_and_exit(void *arg) {
+  void **blocks = arg;
+  for (int i = 0; i < 4; i++) {
+    blocks[i] = sf_malloc(100);
+  }
+  for (int i = 0; i < 4; i++) {
+    sf_free(blocks[i]);
+  }
+  return tcache_count(calc_malloc_block_size(100)) > 0 ? arg : NULL;
+}
+
+Test(sfmm_tcache_suite, thread_exit_returns_blocks, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  void *guard = sf_malloc(8);
+  void *blocks[4];
+  pthread_t thread;
+  void *result;
+  pthread_create(&thread, NULL, cache_and_exit, blocks);
+  pthread_join(thread, &result);
+  cr_assert_eq(result, blocks, "thread did not cache its blocks");
+  for (int i = 0; i < 4; i++) {
+    sf_block *bp = get_block(blocks[i]);
+    cr_assert(get_quick_list_bit(bp) || !get_alloc_bit(bp),
+              "block %d was not returned to the heap", i);
+  }
+  sf_free(guard);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+#define STRESS_THREADS 4
+#define STRESS_LIVE 16
+#define STRESS_ROUNDS 20000
+
+static void *stress(void *arg) {
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  unsigned char *live[STRESS_LIVE] = {NULL};
+  size_t sizes[STRESS_LIVE] = {0};
+  for (int round = 0; round < STRESS_ROUNDS; round++) {
+    int i = rand_r(&seed) % STRESS_LIVE;
+    if (live[i] != NULL) {
+      for (size_t j = 0; j < sizes[i]; j++) {
+        if (live[i][j] != (unsigned char)(i + (uintptr_t)arg)) {
+          return NULL;
+        }
+      }
+      sf_free(live[i]);
+    }
+    sizes[i] = 1 + rand_r(&seed) % 300;
+    live[i] = sf_malloc(sizes[i]);
+    if (live[i] == NULL) {
+      return NULL;
+    }
+    memset(live[i], (unsigned char)(i + (uintptr_t)arg), sizes[i]);
+  }
+  for (int i = 0; i < STRESS_LIVE; i++) {
+    sf_free(live[i]);
+  }
+  return arg;
+}
+
+Test(sfmm_tcache_suite, concurrent_malloc_free, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  pthread_t threads[STRESS_THREADS];
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    pthread_create(&threads[t], NULL, stress, (void *)(t + 1));
+  }
+  for (uintptr_t t = 0; t < STRESS_THREADS; t++) {
+    void *result;
+    pthread_join(threads[t], &result);
+    cr_assert_eq(result, (void *)(t + 1), "thread %ld failed", (long)t);
+  }
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
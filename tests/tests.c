@@ -3,20 +3,23 @@
 #include <criterion/criterion.h>
 #include <stdio.h>
 
+#include "block_layout.h"
+#include "check.h"
+#include "mem_library.h"
 #include "sfmm.h"
 
 // helper functions
 sf_block* get_block(void* pntr) {
-  return (sf_block*)((char*)pntr - sizeof(sf_header));
+  return (sf_block*)((char*)pntr - HEADER_SIZE);
 }
-void* get_pp(void* block) { return (void*)((char*)block + sizeof(sf_header)); }
+void* get_pp(void* block) { return (void*)((char*)block + HEADER_SIZE); }
 
 sf_block* get_freelist_index(size_t size) {
   // get the index of the free list
   int power_of_2 = 1;  // i^th power of 2
   // debug("array: %p", &sf_free_list_heads[6] );
   for (int i = 0; i < NUM_FREE_LISTS; i++) {
-    if (size <= (32 * power_of_2)) {
+    if (size <= (MIN_BLOCK_SIZE * power_of_2)) {
       // debug("returned list: %d", i);
       return &sf_free_list_heads[i];
     }
@@ -32,24 +35,24 @@ int block_in_freelist(sf_block* block, size_t size) {
     return 0;
   }
   // get the first block in the free list
-  sf_block* next = dummy_pointer->body.links.next;
+  sf_block* next = block_next(dummy_pointer);
   // iterate through the free list
   while (next != dummy_pointer) {
     if (next == block) {
       // block is in free list
       return 1;
     }
-    next = next->body.links.next;
+    next = block_next(next);
   }
   return 0;
 }
 
 int block_in_quicklist(sf_block* block, size_t size) {
   // get the index of the quick list
-  if (size > 32 + (NUM_QUICK_LISTS - 1) * 8) {
+  if (size > MIN_BLOCK_SIZE + (NUM_QUICK_LISTS - 1) * 8) {
     return 0;
   }
-  size -= 32;
+  size -= MIN_BLOCK_SIZE;
   size /= 8;
   int quick_index = size;
   // get the index of the quick list
@@ -73,48 +76,48 @@ int block_in_quicklist(sf_block* block, size_t size) {
       // block is in the quick list
       return 1;
     }
-    next = next->body.links.next;
+    next = block_next(next);
   }
   return 0;
 }
 
 // assert functions
 void assert_header_equals_footer(sf_block* block) {
-  sf_footer* footer =
-      (sf_footer*)((char*)block + (block->header & ~0x7) - sizeof(sf_footer));
+  sf_word* footer =
+      (sf_word*)((char*)block + get_block_size(block) - FOOTER_SIZE);
   int footer_value = *footer;
-  int header_value = block->header;
+  int header_value = BLOCK_HEADER(block);
   cr_assert(header_value == footer_value, "Header and footer do not match");
 }
 
 void assert_block_size(void* pp, size_t size) {
   sf_block* bp = get_block(pp);
-  cr_assert_eq((bp->header & ~0x7), size,
+  cr_assert_eq((BLOCK_HEADER(bp) & ~0x7), size,
                "Block size is wrong (exp=%ld, found=%ld)", size,
-               (bp->header & ~0x7));
+               (BLOCK_HEADER(bp) & ~0x7));
 }
 
 void assert_block_alloc(void* pp, int alloc) {
   sf_block* bp = get_block(pp);
-  cr_assert_eq((bp->header & 0x1), alloc,
+  cr_assert_eq((BLOCK_HEADER(bp) & 0x1), alloc,
                "Alloc bit is wrong (exp=%d, found=%d)", alloc,
-               (bp->header & 0x1));
+               (BLOCK_HEADER(bp) & 0x1));
 }
 
 void assert_block_prev_alloc(void* pp, int prev_alloc) {
   sf_block* bp = get_block(pp);
   if (prev_alloc != 0) prev_alloc = 0x2;
-  cr_assert_eq((bp->header & 0x2), prev_alloc,
+  cr_assert_eq((BLOCK_HEADER(bp) & 0x2), prev_alloc,
                "Block prev_alloc is wrong (exp=%d, found=%d)", prev_alloc,
-               (bp->header & 0x2));
+               (BLOCK_HEADER(bp) & 0x2));
 }
 
 void assert_block_quicklist(void* pp, int quicklist) {
   if (quicklist != 0) quicklist = 0x4;
   sf_block* bp = get_block(pp);
-  cr_assert_eq((bp->header & 0x4), quicklist,
+  cr_assert_eq((BLOCK_HEADER(bp) & 0x4), quicklist,
                "Block quicklist is wrong (exp=%d, found=%d)", quicklist,
-               (bp->header & 0x4));
+               (BLOCK_HEADER(bp) & 0x4));
 }
 
 void assert_allocated_block(void* pp, size_t size) {
@@ -164,6 +167,25 @@ void assert_pntr_aligned(void* p, size_t alignment) {
   cr_assert_eq((size_t)p % alignment, 0, "Pointer is not aligned (p=%p)", p);
 }
 
+/*
+ * Skip the test if pointers are checked below level, as in a build with a
+ * lower SF_CHECK_LEVEL.
+ */
+void skip_below_check_level(int level) {
+  if (check_level() < level) {
+    cr_skip_test("pointers are not checked at this level");
+  }
+}
+
+/*
+ * Check pointers at level, or skip the test if the build fixed another one.
+ */
+void use_check_level(int level) {
+  if (sf_set_check_level(level) != 0) {
+    cr_skip_test("the check level is fixed at build time");
+  }
+}
+
 // void assert_alignment_location(size_t alignment, size_t blocksize, size_t offset) {
 //   // first possible pp_pointer
 //   size_t start = (size_t)sf_mem_start() + 32 + 8;
@@ -1,6 +1,11 @@
 #include "sfmm.h"
 #include <criterion/criterion.h>
 
+#include "mem_library.h"
+
+/* The size of the free block of a new heap, one page long. */
+#define FIRST_FREE_SIZE (PAGE_SZ - HEAP_PAD - MIN_BLOCK_SIZE - HEADER_SIZE)
+
 extern void assert_quick_list_block_count(size_t size, int count);
 extern void assert_free_block_count(size_t size, int count);
 extern void assert_free_list_size(int index, int size);
@@ -12,4 +17,6 @@ extern void assert_block_prev_alloc(void* pp, int alloc);
 extern sf_block* get_block(void* pntr);
 extern void assert_pntr_equal(void* p1, void* p2);
 extern void assert_pntr_not_equal(void* p1, void* p2);
-extern void assert_pntr_aligned(void* p, size_t alignment);
\ No newline at end of file
+extern void assert_pntr_aligned(void* p, size_t alignment);
+extern void skip_below_check_level(int level);
+extern void use_check_level(int level);
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "debug.h"
+#include "mem_library.h"
+#include "sfmm.h"
+#include "tests.h"
+#include "tlsf.h"
+#define TEST_TIMEOUT 15
+
+/*
+ * Assert the total number of free blocks of a specified size in the TLSF
+ * lists, and that the bitmaps agree with the contents of every list.
+ * If size == 0, then assert the total number of all free blocks.
+ */
+static void assert_tlsf_free_block_count(size_t size, int count) {
+  int cnt = 0;
+  for (int fl = 0; fl < TLSF_FL_COUNT; fl++) {
+    for (int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+      sf_block *head = &sf_tlsf_heads[fl][sl];
+      int bit = (sf_tlsf_sl_bitmap[fl] >> sl) & 1;
+      cr_assert_eq(bit, block_next(head) != head,
+                   "Bitmap of list (%d, %d) is wrong", fl, sl);
+      for (sf_block *bp = block_next(head); bp != head;
+           bp = block_next(bp)) {
+        if (size == 0 || size == get_block_size(bp)) cnt++;
+      }
+    }
+    cr_assert_eq((int)((sf_tlsf_fl_bitmap >> fl) & 1),
+                 sf_tlsf_sl_bitmap[fl] != 0,
+                 "First level bitmap of list %d is wrong", fl);
+  }
+  cr_assert_eq(cnt, count,
+               "Wrong number of free blocks of size %ld (exp=%d, found=%d)",
+               size, count, cnt);
+}
+
+Test(sfmm_tlsf_suite, tlsf_mapping, .timeout = TEST_TIMEOUT) {
+  int fl, sl;
+  tlsf_mapping(32, &fl, &sl);
+  cr_assert(fl == 0 && sl == 4, "32 mapped to (%d, %d)", fl, sl);
+  tlsf_mapping(120, &fl, &sl);
+  cr_assert(fl == 0 && sl == 15, "120 mapped to (%d, %d)", fl, sl);
+  tlsf_mapping(128, &fl, &sl);
+  cr_assert(fl == 1 && sl == 0, "128 mapped to (%d, %d)", fl, sl);
+  tlsf_mapping(200, &fl, &sl);
+  cr_assert(fl == 1 && sl == 9, "200 mapped to (%d, %d)", fl, sl);
+  tlsf_mapping(4024, &fl, &sl);
+  cr_assert(fl == 5 && sl == 15, "4024 mapped to (%d, %d)", fl, sl);
+}
+
+Test(sfmm_tlsf_suite, tlsf_malloc_an_int, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), 0, "could not select TLSF");
+  int *x = sf_malloc(sizeof(int));
+  cr_assert_not_null(x, "x is NULL!");
+  *x = 4;
+  assert_allocated_block(x, MIN_BLOCK_SIZE);
+  assert_free_block_count(0, 0);
+  assert_tlsf_free_block_count(0, 1);
+  assert_tlsf_free_block_count(FIRST_FREE_SIZE - MIN_BLOCK_SIZE, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_tlsf_suite, tlsf_free_coalesce, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_free_list_engine(SF_TLSF);
+  /* void *w = */ sf_malloc(8);
+  void *x = sf_malloc(200);
+  void *y = sf_malloc(300);
+  /* void *z = */ sf_malloc(4);
+  sf_free(y);
+  sf_free(x);
+  assert_quick_list_block_count(0, 0);
+  assert_tlsf_free_block_count(0, 2);
+  assert_tlsf_free_block_count(calc_malloc_block_size(200) +
+                                   calc_malloc_block_size(300),
+                               1);
+  assert_tlsf_free_block_count(FIRST_FREE_SIZE - 2 * MIN_BLOCK_SIZE -
+                                   calc_malloc_block_size(200) -
+                                   calc_malloc_block_size(300),
+                               1);
+  // the coalesced block is reused for a request that fits in it
+  void *v = sf_malloc(500);
+  assert_pntr_equal(v, x);
+  assert_tlsf_free_block_count(0, 1);
+}
+
+Test(sfmm_tlsf_suite, tlsf_grow_heap, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_free_list_engine(SF_TLSF);
+  void *x = sf_malloc(FIRST_FREE_SIZE + 3 * PAGE_SZ - HEADER_SIZE);
+  cr_assert_not_null(x, "x is NULL!");
+  assert_tlsf_free_block_count(0, 0);
+  sf_free(x);
+  assert_tlsf_free_block_count(0, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_tlsf_suite, tlsf_random_churn, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_set_free_list_engine(SF_TLSF);
+  void *pntrs[64] = {0};
+  unsigned int seed = 7;
+  for (int i = 0; i < 2000; i++) {
+    seed = seed * 1103515245 + 12345;
+    int slot = (seed >> 8) % 64;
+    if (pntrs[slot] == NULL) {
+      pntrs[slot] = sf_malloc(((seed >> 16) % 600) + 1);
+      cr_assert_not_null(pntrs[slot], "malloc failed at iteration %d", i);
+    } else {
+      sf_free(pntrs[slot]);
+      pntrs[slot] = NULL;
+    }
+  }
+  for (int i = 0; i < 64; i++) {
+    if (pntrs[i] != NULL) sf_free(pntrs[i]);
+  }
+  for (int i = 0; i < NUM_QUICK_LISTS; i++) flush_quicklist(i);
+  // everything coalesces back into the single wilderness block
+  assert_tlsf_free_block_count(0, 1);
+  cr_assert(sf_errno == 0, "sf_errno is not 0!");
+}
+
+Test(sfmm_tlsf_suite, tlsf_select_after_init, .timeout = TEST_TIMEOUT) {
+  sf_errno = 0;
+  sf_malloc(8);
+  cr_assert_eq(sf_set_free_list_engine(SF_TLSF), -1,
+               "engine changed after the heap was initialized");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}
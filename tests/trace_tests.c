@@ -0,0 +1,115 @@
+#define _DEFAULT_SOURCE
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "sfmm.h"
+#include "tests.h"
+#include "trace.h"
+#include "zero.h"
+#define TEST_TIMEOUT 15
+
+static char trace_path[64];
+
+static void start_trace() {
+  snprintf(trace_path, sizeof(trace_path), "/tmp/sfmm_trace_%d.bin",
+           (int)getpid());
+  cr_assert_eq(sf_trace_start(trace_path), 0, "trace did not start");
+}
+
+/*
+ * Stop the trace and read its events into events.
+ * @return The number of events read.
+ */
+static size_t stop_trace(sf_trace_event *events, size_t max) {
+  cr_assert_eq(sf_trace_stop(), 0, "trace did not stop");
+  FILE *file = fopen(trace_path, "rb");
+  cr_assert_not_null(file, "no trace file");
+  sf_trace_header header;
+  cr_assert_eq(fread(&header, sizeof(header), 1, file), 1, "no header");
+  cr_assert_eq(header.magic, SF_TRACE_MAGIC, "bad magic");
+  cr_assert_eq(header.version, SF_TRACE_VERSION, "bad version");
+  size_t count = fread(events, sizeof(sf_trace_event), max, file);
+  fclose(file);
+  unlink(trace_path);
+  return count;
+}
+
+static void assert_event(sf_trace_event *event, int op, uint32_t id,
+                         size_t size) {
+  cr_assert_eq(event->op, op, "op is %c, not %c", event->op, op);
+  cr_assert_eq(event->id, id, "id is %u, not %u", event->id, id);
+  cr_assert_eq(event->size, size, "size is %lu, not %zu",
+               (unsigned long)event->size, size);
+}
+
+Test(sfmm_trace_suite, records_calls_in_order, .timeout = TEST_TIMEOUT) {
+  start_trace();
+  void *x = sf_malloc(100);
+  void *y = sf_calloc(4, 10);
+  x = sf_realloc(x, 3000);
+  void *z = sf_memalign(50, 256);
+  sf_free(y);
+  sf_free(x);
+  sf_free(z);
+  sf_trace_event events[16];
+  size_t count = stop_trace(events, 16);
+  cr_assert_eq(count, 7, "%zu events recorded", count);
+  assert_event(&events[0], SF_TRACE_MALLOC, 0, 100);
+  assert_event(&events[1], SF_TRACE_MALLOC, 1, 40);
+  // the reallocated object keeps its id
+  assert_event(&events[2], SF_TRACE_REALLOC, 0, 3000);
+  assert_event(&events[3], SF_TRACE_MEMALIGN, 2, 50);
+  cr_assert_eq(events[3].align_shift, 8, "align_shift is %d",
+               events[3].align_shift);
+  assert_event(&events[4], SF_TRACE_FREE, 1, 0);
+  assert_event(&events[5], SF_TRACE_FREE, 0, 0);
+  assert_event(&events[6], SF_TRACE_FREE, 2, 0);
+  for (size_t i = 1; i < count; i++) {
+    cr_assert(events[i].time >= events[i - 1].time, "events out of order");
+  }
+  cr_assert_eq(sf_trace_dropped(), 0, "events dropped");
+}
+
+Test(sfmm_trace_suite, skips_blocks_from_before, .timeout = TEST_TIMEOUT) {
+  void *x = sf_malloc(100);
+  void *y = sf_malloc(200);
+  start_trace();
+  sf_free(x);
+  // unknown to the trace, so it becomes an allocation
+  y = sf_realloc(y, 400);
+  sf_free(y);
+  sf_trace_event events[16];
+  size_t count = stop_trace(events, 16);
+  cr_assert_eq(count, 2, "%zu events recorded", count);
+  assert_event(&events[0], SF_TRACE_MALLOC, 0, 400);
+  assert_event(&events[1], SF_TRACE_FREE, 0, 0);
+}
+
+Test(sfmm_trace_suite, records_batches, .timeout = TEST_TIMEOUT) {
+  start_trace();
+  void *out[8];
+  cr_assert_eq(sf_malloc_batch(100, 8, out), 8, "batch is short");
+  sf_free_batch(out, 8);
+  sf_trace_event events[32];
+  size_t count = stop_trace(events, 32);
+  cr_assert_eq(count, 16, "%zu events recorded", count);
+  for (int i = 0; i < 16; i++) {
+    cr_assert_eq(events[i].op, (i < 8) ? SF_TRACE_MALLOC : SF_TRACE_FREE,
+                 "event %d is %c", i, events[i].op);
+  }
+}
+
+Test(sfmm_trace_suite, start_twice, .timeout = TEST_TIMEOUT) {
+  start_trace();
+  sf_errno = 0;
+  cr_assert_eq(sf_trace_start(trace_path), -1, "second start succeeded");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+  sf_trace_event events[1];
+  stop_trace(events, 1);
+  sf_errno = 0;
+  cr_assert_eq(sf_trace_stop(), -1, "second stop succeeded");
+  cr_assert_eq(sf_errno, EINVAL, "sf_errno is not EINVAL");
+}